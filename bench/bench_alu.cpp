@@ -0,0 +1,108 @@
+#include "Clock.hpp"
+#include "ISA.hpp"
+#include "cpu.hpp"
+#include "include_std.hpp"
+#include "memory.hpp"
+#include "units.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+/*
+ *  ALU heavy opcode mix: the flags are written by every instruction but only
+ *  read by the conditional branch closing the loop.
+ */
+namespace {
+using namespace ISA;
+using clock_type = std::chrono::steady_clock;
+
+// LD B..L,imm; then loop on ADD SUB ADC XOR INC DEC AND OR CP INC JR NZ / JR
+const std::vector<std::uint8_t> alu_program{
+    0x06, 0x01, 0x0E, 0x02, 0x16, 0x03, 0x1E, 0x04, 0x26, 0x05, 0x2E, 0x06, 0x80,
+    0x91, 0x8A, 0xAB, 0x04, 0x0D, 0xA4, 0xB5, 0xB8, 0x3C, 0x20, 0xF4, 0x18, 0xF2};
+// loop on INC HL LD B,H LD C,L INC DE LD A,B DEC BC NOP JR, loads and 16 bits
+// increments only
+const std::vector<std::uint8_t> load_program{0x23, 0x44, 0x4D, 0x13, 0x78,
+                                             0x0B, 0x00, 0x18, 0xF7};
+
+auto report(std::string_view name, double count, std::string_view unit,
+            clock_type::duration elapsed) -> void
+{
+	const double sec = std::chrono::duration<double>(elapsed).count();
+	std::cout << std::left << std::setw(28) << name << std::right << std::setw(10)
+	          << std::fixed << std::setprecision(1) << count / sec / 1e6 << ' ' << unit
+	          << '\n';
+}
+
+auto bench_cpu(std::string_view name, const std::vector<std::uint8_t> &program,
+               bool dynarec) -> void
+{
+	constexpr std::uint64_t cycles = 200'000'000;
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	SM83<Simple_MBC> cpu{clock, Execution_mode::Instruction_accurate};
+	cpu.set_dynarec(dynarec);
+
+	const auto begin = clock_type::now();
+	cpu.run_cycles(memory, cycles);
+	const auto elapsed = clock_type::now() - begin;
+	const auto label = std::string{name} + ((dynarec) ? " (dynarec)" : "");
+	report(label, cpu.cycles(), "MHz (M-cycles)", elapsed);
+}
+
+// Cycle_accurate: each instruction waits for its M-cycles on the timeline
+auto bench_coroutine(std::string_view name, const std::vector<std::uint8_t> &program)
+    -> void
+{
+	constexpr std::uint64_t cycles = 20'000'000;
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	SM83<Simple_MBC> cpu{clock};
+	cpu.run(memory);
+
+	const auto begin = clock_type::now();
+	timeline.advance(cycles);
+	const auto elapsed = clock_type::now() - begin;
+	report(std::string{name} + " (coroutine)", cycles, "MHz (M-cycles)", elapsed);
+}
+
+auto bench_isa() -> void
+{
+	constexpr std::size_t count = 100'000'000;
+	Flag_register F = 0;
+	Register8 A = 0, B = 1;
+	std::size_t taken = 0;
+	const auto begin = clock_type::now();
+	for(std::size_t i = 0; i < count; i += 8) {
+		A = ADD(A, B, F);
+		A = SUB(A, static_cast<Register8>(i), F);
+		A = ADC(A, B, F);
+		A = XOR(A, static_cast<Register8>(i >> 3), F);
+		B = INC(B, F);
+		A = AND(A, B, F);
+		A = OR(A, static_cast<Register8>(i >> 5), F);
+		CP(A, B, F);
+		taken += condition<NZ>(F);
+	}
+	report("ISA helpers", count, "Mop/s", clock_type::now() - begin);
+	// keep the loop alive
+	if(taken == count + A) std::cout << '\n';
+}
+} // namespace
+
+auto main() -> int
+{
+	bench_isa();
+	// the dynarec only runs in Instruction_accurate mode
+	for(const auto &[name, program] : {std::pair{"SM83 ALU loop", &alu_program},
+	                                   std::pair{"SM83 load loop", &load_program}}) {
+		bench_coroutine(name, *program);
+		bench_cpu(name, *program, false);
+		if constexpr(Dynarec::supported()) bench_cpu(name, *program, true);
+	}
+	return 0;
+}
@@ -3,20 +3,26 @@
 
 #include "Coroutine.hpp"
 #include "include_std.hpp"
+#include "timeline.hpp"
 #include "trait.hpp"
 
+#include <bit>
 #include <chrono>
 #include <ctime>
 #include <iostream>
 
-#include <sys/epoll.h>
-#include <sys/timerfd.h>
 #include <type_traits>
 #include <unistd.h>
 
 class Clock_domain {
   public:
-	Clock_domain(double sec) : _clock_domain(sec) { _clock_domain.start_timer(); }
+	// one cycle of the domain lasts divider cycles of the timeline, a power of
+	// two: the cycles of the domain start on multiples of it
+	explicit Clock_domain(Timeline &timeline, std::uint32_t divider = 1) noexcept
+	    : _timeline(timeline)
+	{
+		set_divider(divider);
+	}
 	Clock_domain(const Clock_domain &) = delete;
 	Clock_domain(Clock_domain &&) = delete;
 	auto operator=(const Clock_domain &) -> Clock_domain & = delete;
@@ -25,29 +31,26 @@ class Clock_domain {
 	// the resumable class
 	class Awaiter;
 	auto operator co_await() const noexcept -> Awaiter;
-	// use to resume all the registered coroutine
-	auto notify_edge() const -> void;
-	// use to controlle the underlying timer with epoll see Scheduler below
-	auto start_timer() noexcept -> void { _clock_domain.start_timer(); }
-	auto timer_fd() const noexcept -> int { return _clock_domain._clock_fd; }
+	// co_await clock.cycles(n) resumes after n edges, without a coroutine frame
+	auto cycles(int n) const noexcept -> Awaiter;
+	// resumes on the first edge at or after the timeline cycle when, one
+	// cycle at least
+	auto until(Timeline::Cycle when) const noexcept -> Awaiter;
+
+	auto timeline() const noexcept -> Timeline & { return _timeline; }
+	auto divider() const noexcept -> std::uint32_t { return _divider; }
+	// the next waits are counted with the new divider
+	auto set_divider(std::uint32_t divider) noexcept -> void
+	{
+		if(not std::has_single_bit(divider)) {
+			std::terminate();
+		}
+		_divider = divider;
+	}
 
   private:
-	struct Poll_timer {
-		int _clock_fd;
-		struct itimerspec _timerValue;
-		Poll_timer(double usec) noexcept;
-		Poll_timer() noexcept : Poll_timer(1){};
-		~Poll_timer() noexcept { close(_clock_fd); };
-		auto start_timer() const noexcept -> void;
-	};
-	// to store pending awaiter
-	mutable std::vector<Awaiter *> _edge_awaiter;
-	// to store awaiter to be resumed on a notify_edge call
-	// i.e. a std::movee of _edge_awaiter to avoid infinite loop
-	// that are induce by loop on co_await when resuming.
-	mutable std::vector<Awaiter *> _resume_awaiter;
-	// the timer
-	mutable Poll_timer _clock_domain;
+	Timeline &_timeline;
+	std::uint32_t _divider;
 };
 class Clock_domain::Awaiter {
   public:
@@ -55,9 +58,9 @@ class Clock_domain::Awaiter {
 	    : _event(clock), _cycle(cycle), _promise(promise){};
 	Awaiter(const Clock_domain &clock, int cycle) : _event(clock), _cycle(cycle){};
 	Awaiter(const Clock_domain &clock) : Awaiter(clock, 1, {}){};
-	// we always suspend since we stop on a cycle so it returns false
+	// we suspend until the next edge, unless there is no cycle to wait
 	auto await_ready() const noexcept -> bool;
-	// here we register awaiter in Clock::_edge_awaiter
+	// here we register the coroutine on the timeline
 	auto await_suspend(std::coroutine_handle<> coro) noexcept -> bool;
 	// nothing to be done on resume
 	auto await_resume() const noexcept -> std::optional<int> { return _promise; };
@@ -65,68 +68,111 @@ class Clock_domain::Awaiter {
 	auto get_cycle() const noexcept -> int { return _cycle; }
 
   private:
-	friend class Clock_domain;
 	// the event we registered to
 	const Clock_domain &_event;
 	int _cycle;
 	// TODO check the promise type ?
 	std::optional<int> _promise;
-	// the coroutine frame to be called in notify
-	std::coroutine_handle<> coroutineHandle;
+	// linked in the timeline while suspended
+	Timeline::Event _timeline_event{};
 };
 
-class Scheduler {
-	// This class is use to manage the different clock domain One drawback of such a
-	// scheme is that we have one timer by domain On small component it is fine but maybe
-	// we can manage this better
+/*
+ *  The one oscillator of the console. At 2^23 Hz every domain is a power of
+ *  two divider, CGB double speed included. Since they share the timeline
+ *  and wait for multiples of their divider, the domains stay phase-locked.
+ */
+class Master_clock {
   public:
-	~Scheduler() { close(_efd); }
-	Scheduler() = delete;
-	explicit Scheduler(std::initializer_list<Clock_domain *> timers) noexcept
-	    : _timer{timers}
+	static constexpr std::uint64_t Frequency = 8'388'608;
+	// master cycles of a domain cycle in normal speed
+	static constexpr std::uint32_t CPU_divider = 8;       // M-cycles, 1 MHz
+	static constexpr std::uint32_t PPU_divider = 2;       // dots, 4 MHz
+	static constexpr std::uint32_t Timer_divider = 32;    // DIV and TIMA inputs, 256 kHz
+	static constexpr std::uint32_t Serial_divider = 1024; // internal clock, 8 kHz
+	static constexpr std::uint32_t APU_divider = 16384;   // frame sequencer, 512 Hz
+	enum class Speed : std::uint8_t { Normal, Double };
+
+	Master_clock() noexcept
+	    : _cpu(_timeline, CPU_divider), _ppu(_timeline, PPU_divider),
+	      _timer(_timeline, Timer_divider), _serial(_timeline, Serial_divider),
+	      _apu(_timeline, APU_divider)
 	{
-		struct epoll_event ev;
-		_efd = epoll_create1(0);
-		if(_efd < 0) {
-			std::terminate();
-		}
-		for(size_t idx = 0; auto it : _timer) {
-			ev.events = EPOLLIN;
-			ev.data.fd = it->timer_fd();
-			ev.data.ptr = it;
-			auto error_code = epoll_ctl(_efd, EPOLL_CTL_ADD, it->timer_fd(), &ev);
-			if(error_code < 0) {
-				std::terminate();
-			}
-			idx += 1;
-		}
 	}
-	auto operator()() noexcept -> void
+	Master_clock(const Master_clock &) = delete;
+	auto operator=(const Master_clock &) -> Master_clock & = delete;
+
+	auto timeline() noexcept -> Timeline & { return _timeline; }
+	auto timeline() const noexcept -> const Timeline & { return _timeline; }
+	auto cpu() const noexcept -> const Clock_domain & { return _cpu; }
+	auto ppu() const noexcept -> const Clock_domain & { return _ppu; }
+	auto timer() const noexcept -> const Clock_domain & { return _timer; }
+	auto serial() const noexcept -> const Clock_domain & { return _serial; }
+	auto apu() const noexcept -> const Clock_domain & { return _apu; }
+
+	auto speed() const noexcept -> Speed { return _speed; }
+	// the CPU, DIV/TIMA and the serial port run twice as fast in double speed,
+	// the PPU and the frame sequencer keep their pace
+	auto set_speed(Speed speed) noexcept -> void
 	{
+		_speed = speed;
+		const std::uint32_t shift = (speed == Speed::Double) ? 1 : 0;
+		_cpu.set_divider(CPU_divider >> shift);
+		_timer.set_divider(Timer_divider >> shift);
+		_serial.set_divider(Serial_divider >> shift);
+	}
+
+  private:
+	Timeline _timeline;
+	Clock_domain _cpu, _ppu, _timer, _serial, _apu;
+	Speed _speed = Speed::Normal;
+};
 
-		struct epoll_event events;
-		int nr_events = epoll_wait(_efd, &events, 1, -1);
-		int tmp = errno;
-		if(not(nr_events < 0) and not(tmp < 0)) {
-			auto ptimer = static_cast<Clock_domain *>(events.data.ptr);
-			ptimer->start_timer();
-			ptimer->notify_edge();
+/*
+ *  Sleeps until the absolute CLOCK_MONOTONIC deadline of each frame the
+ *  caller emulated: late wake-ups do not accumulate and wall-clock
+ *  adjustments have no effect. When behind, the frames are run back to back
+ *  to catch up, up to Max_catch_up of them; further behind the late frames
+ *  are dropped and the deadlines move forward.
+ */
+class Frame_pacer {
+  public:
+	static constexpr std::uint64_t Max_catch_up = 4;
+	struct Stats {
+		std::uint64_t frames = 0;
+		// frames started after their deadline
+		std::uint64_t late = 0;
+		// frame periods given up when too far behind
+		std::uint64_t dropped = 0;
+		// wake-up time past the deadline
+		std::chrono::nanoseconds jitter_max{0};
+		std::chrono::nanoseconds jitter_total{0};
+		std::uint64_t sleeps = 0;
+		// how far behind its deadline the last frame started, the worst since
+		// the first one
+		std::chrono::nanoseconds lag{0};
+		std::chrono::nanoseconds lag_max{0};
+
+		[[nodiscard]] auto jitter_mean() const noexcept -> std::chrono::nanoseconds
+		{
+			if(sleeps == 0) return std::chrono::nanoseconds{0};
+			return jitter_total / static_cast<std::int64_t>(sleeps);
 		}
-	}
+	};
+
+	explicit Frame_pacer(std::chrono::nanoseconds period) noexcept;
+	// one frame was emulated, wait for its deadline
+	auto wait() noexcept -> void;
+	[[nodiscard]] auto stats() const noexcept -> const Stats & { return _stats; }
 
   private:
-	// the different clock domain handle by our scheduler
-	std::vector<Clock_domain *> _timer;
-	int _efd;
+	std::chrono::nanoseconds _period;
+	// end of the current frame on CLOCK_MONOTONIC
+	std::chrono::nanoseconds _deadline;
+	Stats _stats;
+
+	// the next frame starts that late
+	auto lag(std::chrono::nanoseconds lag) noexcept -> void;
 };
 
-// clang-format off
-template <unsigned cycle, class Fct, class... Args> requires Callable<Fct, Args...>
-auto await(const Clock_domain &clock, Fct&& f, Args &&... arg)
-                -> task<std::invoke_result_t<Fct, Args...>>
-{
-	co_await Clock_domain::Awaiter{clock, cycle};
-	co_return std::invoke(std::forward<Fct>(f),std::forward<Args>(arg)...);
-}
-// clang-format on
 #endif
@@ -1,124 +1,110 @@
 #ifndef __COROUTINE_HPP__
 #define __COROUTINE_HPP__
+#include "frame_pool.hpp"
 #include "include_std.hpp"
 struct Dummy_coro {
-	struct promise_type {
-		Dummy_coro get_return_object() { return {}; }
-		auto initial_suspend() { return std::suspend_never{}; }
-		auto final_suspend() { return std::suspend_never{}; }
-		void return_void() {}
-		void unhandled_exception() {}
+	struct promise_type : Pooled_frame {
+		Dummy_coro get_return_object() noexcept { return {}; }
+		auto initial_suspend() noexcept { return std::suspend_never{}; }
+		auto final_suspend() noexcept { return std::suspend_never{}; }
+		void return_void() noexcept {}
+		// nobody could observe it, do not let the emulation go on silently
+		void unhandled_exception() noexcept { std::terminate(); }
 	};
 };
 
-// https://www.youtube.com/watch?v=8C8NnE1Dg4A&t=45m50s (Gor Nishanov, CppCon 2016)
-
-template <class T> struct task {
-	struct promise_type {
-		// the coroutine which have call co_await
-		std::variant<std::monostate, T, std::exception_ptr> result_;
-		std::coroutine_handle<void> waiter_;
+// what a task does with an exception escaping its body: store it and throw
+// it again from co_await, or terminate for the noexcept paths
+enum class Exceptions : std::uint8_t { Rethrow, Terminate };
 
-		task get_return_object() { return task(this); }
-		// triggered only if co_await is called
-		// see co_await for the call to resume
-		auto initial_suspend() { return std::suspend_always{}; }
-		auto final_suspend()
-		{
-			struct Awaiter {
-				promise_type *me_;
-				bool await_ready() { return false; }
-				void await_suspend([[maybe_unused]] std::coroutine_handle<void> caller)
-				{
-					me_->waiter_.resume();
-				}
-				void await_resume() {}
-			};
-			return Awaiter{this};
-		}
-		template <class U> void return_value(U &&u)
-		{
-			result_.template emplace<1>(static_cast<U &&>(u));
-		}
-		void unhandled_exception()
-		{
-			result_.template emplace<2>(std::current_exception());
-		}
-	};
-
-	// force calling await suspend and then since suspend return void return to caller
-	bool await_ready() { return false; }
-	// Return value
-	// so that auto result = co_await task
-	void await_suspend(std::coroutine_handle<void> caller)
+// the result of a task, with the exception if any
+template <class T, Exceptions E> struct task_result {
+	std::variant<std::monostate, T, std::exception_ptr> result_;
+	template <class U> void return_value(U &&u)
 	{
-		coro_.promise().waiter_ = caller;
-		coro_.resume();
+		result_.template emplace<1>(static_cast<U &&>(u));
 	}
-	T await_resume()
+	void unhandled_exception() { result_.template emplace<2>(std::current_exception()); }
+	T take()
 	{
-		if(coro_.promise().result_.index() == 2) {
-			std::rethrow_exception(std::get<2>(coro_.promise().result_));
-		}
-		return std::get<1>(coro_.promise().result_);
+		if(result_.index() == 2) std::rethrow_exception(std::get<2>(result_));
+		return std::get<1>(std::move(result_));
 	}
+};
+template <> struct task_result<void, Exceptions::Rethrow> {
+	std::exception_ptr result_;
+	void return_void() {}
+	void unhandled_exception() { result_ = std::current_exception(); }
+	void take()
+	{
+		if(result_ != nullptr) std::rethrow_exception(result_);
+	}
+};
+// always set on completion, nothing to check
+template <class T> struct task_result<T, Exceptions::Terminate> {
+	T result_{};
+	template <class U> void return_value(U &&u) noexcept
+	{
+		result_ = static_cast<U &&>(u);
+	}
+	void unhandled_exception() noexcept { std::terminate(); }
+	T take() noexcept { return std::move(result_); }
+};
+template <> struct task_result<void, Exceptions::Terminate> {
+	void return_void() noexcept {}
+	void unhandled_exception() noexcept { std::terminate(); }
+	void take() noexcept {}
+};
 
-	~task() { coro_.destroy(); }
+// https://www.youtube.com/watch?v=8C8NnE1Dg4A&t=45m50s (Gor Nishanov, CppCon 2016)
 
-  private:
-	using handle_t = std::coroutine_handle<promise_type>;
-	task(promise_type *p) : coro_(handle_t::from_promise(*p)) {}
-	// the current coroutine
-	handle_t coro_;
-};
+template <class T, Exceptions E = Exceptions::Rethrow> struct task {
+	static constexpr bool Noexcept = E == Exceptions::Terminate;
 
-template <> struct task<void> {
-	struct promise_type {
+	struct promise_type : Pooled_frame, task_result<T, E> {
 		// the coroutine which have call co_await
-		std::exception_ptr result_;
 		std::coroutine_handle<void> waiter_;
 
-		task get_return_object() { return task(this); }
-		auto initial_suspend() { return std::suspend_always{}; }
-		auto final_suspend()
+		task get_return_object() noexcept { return task(this); }
+		// triggered only if co_await is called
+		// see co_await for the call to resume
+		auto initial_suspend() noexcept { return std::suspend_always{}; }
+		auto final_suspend() noexcept
 		{
 			struct Awaiter {
 				promise_type *me_;
-				bool await_ready() { return false; }
-				void await_suspend([[maybe_unused]] std::coroutine_handle<void> caller)
+				bool await_ready() noexcept { return false; }
+				// symmetric transfer: the waiter is resumed by a tail call
+				std::coroutine_handle<>
+				await_suspend(std::coroutine_handle<void>) noexcept
 				{
-					me_->waiter_.resume();
+					return me_->waiter_;
 				}
-				void await_resume() {}
+				void await_resume() noexcept {}
 			};
 			return Awaiter{this};
 		}
-		void return_void() {}
-		void unhandled_exception() { result_ = std::current_exception(); }
 	};
-	// force calling await suspend and then since suspend return void return to caller
-	bool await_ready() { return false; }
-	// Return value
-	// so that auto result = co_await task
-	void await_suspend(std::coroutine_handle<void> caller)
+
+	// force calling await suspend, the task starts there
+	bool await_ready() noexcept { return false; }
+	// the caller is suspended and the task resumed without growing the stack
+	auto await_suspend(std::coroutine_handle<void> caller) noexcept
+	    -> std::coroutine_handle<>
 	{
 		coro_.promise().waiter_ = caller;
-		coro_.resume();
-	}
-	void await_resume()
-	{
-		if(coro_.promise().result_ != nullptr) {
-			std::rethrow_exception(coro_.promise().result_);
-		}
-		return;
+		return coro_;
 	}
+	T await_resume() noexcept(Noexcept) { return coro_.promise().take(); }
 
+	task(const task &) = delete;
+	auto operator=(const task &) -> task & = delete;
 	~task() { coro_.destroy(); }
 
   private:
 	using handle_t = std::coroutine_handle<promise_type>;
 	task(promise_type *p) : coro_(handle_t::from_promise(*p)) {}
-	// the current coroutine ?
+	// the current coroutine
 	handle_t coro_;
 };
 
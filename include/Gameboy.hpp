@@ -4,33 +4,269 @@
 #include "Clock.hpp"
 #include "MBC.hpp"
 #include "cpu.hpp"
+#include "frame_pool.hpp"
 #include "include_std.hpp"
 #include "memory.hpp"
 
-class Gameboy {
+#include <string_view>
+
+// a run ends on the first condition met
+struct Stop_condition {
+	std::optional<std::uint64_t> cycles{};
+	std::optional<std::uint64_t> frames{};
+	// the PC reaching this address
+	std::optional<std::uint16_t> breakpoint{};
+	// a write to this address, the way test ROMs tell they are done
+	std::optional<std::uint16_t> magic_address{};
+};
+
+struct Run_report {
+	enum class Reason : std::uint8_t { Cycles, Frames, Breakpoint, Magic_write };
+	// M-cycles of a 59.7Hz frame
+	static constexpr std::uint64_t Cycles_per_frame = 17556;
+
+	Reason reason;
+	// emulated M-cycles
+	std::uint64_t cycles;
+	std::chrono::duration<double> elapsed;
+	// coroutine frames which were not recycled during the run
+	std::size_t frame_heap_allocations;
+	// a run in real time
+	std::optional<Frame_pacer::Stats> pacing{};
+
+	[[nodiscard]] auto frames() const noexcept -> std::uint64_t
+	{
+		return cycles / Cycles_per_frame;
+	}
+	[[nodiscard]] auto mhz() const noexcept -> double
+	{
+		return (elapsed.count() > 0) ? cycles / elapsed.count() / 1e6 : 0;
+	}
+	auto dump(std::ostream &cout) const -> void
+	{
+		constexpr std::array<std::string_view, 4> reasons{"cycle count", "frame count",
+		                                                  "breakpoint", "magic write"};
+		cout << "Stopped on " << reasons[static_cast<std::size_t>(reason)] << " after "
+		     << cycles << " M-cycles (" << frames() << " frames)\n";
+		cout << "Emulated " << mhz() << " MHz in " << elapsed.count() << " s\n";
+		cout << "Frame heap allocations: " << frame_heap_allocations << '\n';
+		if(not pacing) return;
+		using ms = std::chrono::duration<double, std::milli>;
+		cout << "Paced " << pacing->frames << " frames, " << pacing->late << " late, "
+		     << pacing->dropped << " dropped\n";
+		cout << "Lag " << ms{pacing->lag}.count() << " ms, max "
+		     << ms{pacing->lag_max}.count() << " ms\n";
+	}
+};
+
+template <typename MBC> class Gameboy {
   public:
-	auto run() -> void
+	static constexpr std::uint64_t Cycles_per_frame = Run_report::Cycles_per_frame;
+	static constexpr std::chrono::nanoseconds Frame_period{16'742'706};
+
+	// run in real time, one frame every Frame_period, until a condition is met
+	auto run(const Stop_condition &stop = {}) -> Run_report
+	{
+		Frame_pacer pacing{Frame_period};
+		return run_until(stop, &pacing);
+	}
+	// run as fast as the host allows until a condition is met
+	auto run_headless(const Stop_condition &stop) -> Run_report
+	{
+		return run_until(stop, nullptr);
+	}
+	// coroutine frames which were not recycled during the last emulated frame
+	[[nodiscard]] auto frame_heap_allocations() const noexcept -> std::size_t
+	{
+		return m_frame_heap_allocations;
+	}
+	// frame-time jitter and late frames of run()
+	[[nodiscard]] auto pacing_stats() const noexcept -> const Frame_pacer::Stats &
+	{
+		return m_pacing;
+	}
+	// how often run() writes the battery backed RAM back to the save file
+	auto set_save_interval(std::chrono::nanoseconds interval) noexcept -> void
+	{
+		m_save_frames = std::max<std::uint64_t>(1, interval / Frame_period);
+	}
+	Gameboy(Rom_image rom, Execution_mode mode = Execution_mode::Cycle_accurate,
+	        size_t ram = 8_kB)
+	    : Gameboy(std::move(rom), mode, Cartridge_ram{ram})
 	{
-		Scheduler clock_domain_handler{&m_clock_cpu};
+	}
+	Gameboy(Rom_image rom, Execution_mode mode, Cartridge_ram ram)
+	    : m_cpu(m_clock.cpu(), mode), m_memory(std::move(rom), std::move(ram))
+	{
+		auto cycles = [](const void *gb) noexcept {
+			return static_cast<const Gameboy *>(gb)->emulated_cycles();
+		};
+		m_memory.set_clock({cycles, this});
+	}
+	// the memory keeps a pointer to the Gameboy for its clock
+	Gameboy(const Gameboy &) = delete;
+	auto operator=(const Gameboy &) -> Gameboy & = delete;
+
+  private:
+	// breakpoints and magic writes are checked after every instruction, the
+	// frames are paced when pacing is given
+	auto run_until(const Stop_condition &stop, Frame_pacer *pacing) -> Run_report
+	{
+		using clock_type = std::chrono::steady_clock;
+		Frame_pool::Scope frames{m_frames};
+		const auto heap_allocations = m_frames.heap_allocations();
+		const auto begin = clock_type::now();
+		const auto first = emulated_cycles();
+		auto limit = Timeline::Never;
+		if(stop.cycles) limit = std::min(limit, first + *stop.cycles);
+		if(stop.frames) limit = std::min(limit, first + *stop.frames * Cycles_per_frame);
+		const bool precise = stop.breakpoint or stop.magic_address;
+		// value_or would narrow No_watch to the type of the address
+		m_memory.watch((stop.magic_address) ? *stop.magic_address
+		                                    : Memory<MBC>::No_watch);
+		start();
 
-		m_cpu.run(m_memory);
+		auto frame_end = first + Cycles_per_frame;
+		std::optional<Run_report::Reason> reason;
+		do {
+			const auto now = emulated_cycles();
+			const auto end = std::min(limit, frame_end);
+			if(m_cpu.mode() == Execution_mode::Instruction_accurate) {
+				if(precise) m_cpu.step(m_memory);
+				else m_cpu.run_cycles(m_memory, end - now);
+			}
+			else {
+				auto &timeline = m_clock.timeline();
+				const auto master_end = end * Master_clock::CPU_divider;
+				timeline.advance_to((precise) ? std::min(timeline.next(), master_end)
+				                              : master_end);
+			}
+			if(emulated_cycles() >= frame_end) {
+				frame_end += Cycles_per_frame;
+				if(pacing) paced_frame(*pacing);
+			}
+			reason = stopped(stop, first);
+		} while(not reason);
 
-		while(1) {
-			clock_domain_handler();
+		m_memory.watch(Memory<MBC>::No_watch);
+		m_memory.flush_ram();
+		Run_report report{*reason, emulated_cycles() - first, clock_type::now() - begin,
+		                  m_frames.heap_allocations() - heap_allocations};
+		if(pacing) report.pacing = pacing->stats();
+		return report;
+	}
+	auto paced_frame(Frame_pacer &pacing) -> void
+	{
+		pacing.wait();
+		saved_frame();
+		m_pacing = pacing.stats();
+		const auto heap_allocations = m_frames.heap_allocations();
+		m_frame_heap_allocations = heap_allocations - m_heap_allocations;
+		m_heap_allocations = heap_allocations;
+	}
+	// the Cycle_accurate CPU is a coroutine started once
+	auto start() -> void
+	{
+		if(m_cpu.mode() == Execution_mode::Cycle_accurate and not m_started) {
+			m_cpu.run(m_memory);
+			m_started = true;
 		}
 	}
-	Gameboy(std::vector<std::uint8_t> program)
-	    : m_clock_cpu{4_Mhz}, m_clock_gpu{4_Mhz}, m_cpu(m_clock_cpu),
-	      m_memory(Simple_MBC_tag{}, program, 4_kB)
+	auto saved_frame() noexcept -> void
+	{
+		if(++m_unsaved_frames < m_save_frames) return;
+		m_memory.flush_ram();
+		m_unsaved_frames = 0;
+	}
+	// M-cycles in normal speed
+	auto emulated_cycles() const noexcept -> std::uint64_t
 	{
+		if(m_cpu.mode() == Execution_mode::Instruction_accurate) return m_cpu.cycles();
+		return m_clock.timeline().now() / Master_clock::CPU_divider;
+	}
+	auto stopped(const Stop_condition &stop, std::uint64_t first) noexcept
+	    -> std::optional<Run_report::Reason>
+	{
+		using enum Run_report::Reason;
+		if(m_memory.watch_hit()) return Magic_write;
+		if(stop.breakpoint and m_cpu.registers().PC == *stop.breakpoint) {
+			return Breakpoint;
+		}
+		const auto cycles = emulated_cycles() - first;
+		if(stop.cycles and cycles >= *stop.cycles) return Cycles;
+		if(stop.frames and cycles >= *stop.frames * Cycles_per_frame) return Frames;
+		return {};
 	}
 
-  private:
-	Clock_domain m_clock_cpu, m_clock_gpu;
-	SM83 m_cpu;
-	Memory m_memory;
+	// first, so that it outlives every coroutine of the emulator
+	Frame_pool m_frames;
+	std::size_t m_heap_allocations = 0;
+	std::size_t m_frame_heap_allocations = 0;
+	Frame_pacer::Stats m_pacing;
+	std::uint64_t m_save_frames = 60;
+	std::uint64_t m_unsaved_frames = 0;
+	Master_clock m_clock;
+	SM83<MBC> m_cpu;
+	Memory<MBC> m_memory;
+	bool m_started = false;
 	// Sound_engine
 	// Graphic engine
 };
 
+/*
+ *  The only runtime switch on the cartridge: its header tells the controller,
+ *  play is called with the core instantiated for it. A program too short to
+ *  have a header is padded with zeros, a plain 32kB ROM. The RAM of a
+ *  cartridge with a battery is mapped from save, when there is one.
+ */
+template <typename Play>
+auto load_cartridge(Rom_image rom, Execution_mode mode, Play &&play,
+                    const std::filesystem::path &save = {}) -> decltype(auto)
+{
+	constexpr std::uint16_t Type_address = 0x0147;
+	constexpr std::uint16_t RAM_size_address = 0x0149;
+	// no RAM at all, no save file; 2kB are mirrored across the RAM bank
+	constexpr std::array<std::size_t, 6> ram_sizes{0,     2_kB,   8_kB,
+	                                               32_kB, 128_kB, 64_kB};
+	const auto ram_code = rom[RAM_size_address];
+	if(ram_code >= ram_sizes.size()) throw std::invalid_argument("invalid RAM size");
+	const auto ram_size = ram_sizes[ram_code];
+	auto ram = [&save, ram_size](bool battery) {
+		if(battery and not save.empty()) return Cartridge_ram::map(save, ram_size);
+		return Cartridge_ram{ram_size};
+	};
+
+	switch(const auto type = rom[Type_address]; type) {
+	case 0x00: {
+		Gameboy<Simple_MBC> gb{std::move(rom), mode, Cartridge_ram{0}};
+		return play(gb);
+	}
+	case 0x01:
+	case 0x02:
+	case 0x03: {
+		Gameboy<MBC1> gb{std::move(rom), mode, ram(type == 0x03)};
+		return play(gb);
+	}
+	case 0x0F:
+	case 0x10:
+	case 0x11:
+	case 0x12:
+	case 0x13: {
+		const bool battery = type == 0x0F or type == 0x10 or type == 0x13;
+		Gameboy<MBC3> gb{std::move(rom), mode, ram(battery)};
+		return play(gb);
+	}
+	case 0x19:
+	case 0x1A:
+	case 0x1B:
+	case 0x1C:
+	case 0x1D:
+	case 0x1E: {
+		Gameboy<MBC5> gb{std::move(rom), mode, ram(type == 0x1B or type == 0x1E)};
+		return play(gb);
+	}
+	}
+	throw std::invalid_argument("unsupported cartridge type");
+}
+
 #endif
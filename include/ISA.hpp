@@ -13,206 +13,329 @@ using Imm16_s = std::int16_t;
 using Imm16 = std::uint16_t;
 using Register8 = std::uint8_t;
 using Register16 = std::uint16_t;
+/*
+ *  Flags are evaluated lazily: the ALU helpers only record the kind of the
+ *  last operation with its operands and its result, Z N and H are computed
+ *  when they are read (mostly by a conditional branch or PUSH AF). The carry
+ *  is read by ADC SBC and the rotations, it is always materialized.
+ */
 struct Flag_register {
+	enum class Op : std::uint8_t { None, Add, Adc, Sub, Cp, Inc, Dec, Logic, And, Shift };
+
   private:
-	Register8 value;
+	// the flags when there is no pending operation, the carry in any case
+	Register8 value = 0;
+	Op op = Op::None;
+	Register8 lhs = 0, rhs = 0, result = 0;
+
+	constexpr auto materialize() noexcept -> void
+	{
+		value = read();
+		op = Op::None;
+	}
 
   public:
 	constexpr Flag_register(std::uint8_t val) noexcept : value(val){};
 	constexpr Flag_register() noexcept = default;
 	constexpr ~Flag_register() noexcept = default;
-	constexpr auto operator=(std::uint8_t val) noexcept { value = val; }
-	constexpr auto read() const noexcept { return value; }
+	constexpr auto operator=(std::uint8_t val) noexcept
+	{
+		value = val;
+		op = Op::None;
+	}
+	constexpr auto read() const noexcept -> Register8
+	{
+		if(op == Op::None) return value;
+		return (zero() << 7) | (substract() << 6) | (half_carry() << 5) | (value & 0x10);
+	}
+	// replace Z N H by the ones of the operation, the carry is left as is
+	constexpr auto record(Op kind, Register8 left, Register8 right,
+	                      Register8 res) noexcept -> void
+	{
+		op = kind;
+		lhs = left;
+		rhs = right;
+		result = res;
+	}
 
-	constexpr auto reset_flag() { value = 0; }
+	constexpr auto reset_flag() noexcept -> void
+	{
+		value = 0;
+		op = Op::None;
+	}
 
-	constexpr auto zero() const noexcept -> std::uint8_t { return get_bit(value, 7); }
+	constexpr auto zero() const noexcept -> std::uint8_t
+	{
+		if(op == Op::None) return get_bit(value, 7);
+		return result == 0;
+	}
 	constexpr auto carry() const noexcept -> std::uint8_t { return get_bit(value, 4); }
 	constexpr auto substract() const noexcept -> std::uint8_t
 	{
-		return get_bit(value, 6);
+		if(op == Op::None) return get_bit(value, 6);
+		return op == Op::Sub or op == Op::Cp or op == Op::Dec;
 	}
 	constexpr auto half_carry() const noexcept -> std::uint8_t
 	{
-		return get_bit(value, 5);
+		switch(op) {
+		case Op::None:
+			return get_bit(value, 5);
+		// bit 4 of the result is the one of the operands flipped by the carry
+		// (or the borrow) out of bit 3, the carry-in of ADC SBC included
+		case Op::Add:
+		case Op::Adc:
+		case Op::Sub:
+		case Op::Cp:
+			return get_bit(static_cast<Register8>(lhs ^ rhs ^ result), 4);
+		case Op::Inc:
+			return (lhs & 0b1111) == 0b1111;
+		case Op::Dec:
+			return (lhs & 0b1111) == 0;
+		case Op::And:
+			return 1;
+		case Op::Logic:
+		case Op::Shift:
+			return 0;
+		}
+		return 0;
+	}
+	constexpr auto clear_zero() noexcept -> void
+	{
+		materialize();
+		clear_bit(value, 7);
 	}
-	constexpr auto clear_zero() noexcept -> void { clear_bit(value, 7); }
 	constexpr auto clear_carry() noexcept -> void { clear_bit(value, 4); }
-	constexpr auto clear_substract() noexcept -> void { clear_bit(value, 6); }
-	constexpr auto clear_half_carry() noexcept -> void { clear_bit(value, 5); }
-	constexpr auto set_zero() noexcept -> void { set_bit(value, 7); }
+	constexpr auto clear_substract() noexcept -> void
+	{
+		materialize();
+		clear_bit(value, 6);
+	}
+	constexpr auto clear_half_carry() noexcept -> void
+	{
+		materialize();
+		clear_bit(value, 5);
+	}
+	constexpr auto set_zero() noexcept -> void
+	{
+		materialize();
+		set_bit(value, 7);
+	}
 	constexpr auto set_carry() noexcept -> void { set_bit(value, 4); }
-	constexpr auto set_substract() noexcept -> void { set_bit(value, 6); }
-	constexpr auto set_half_carry() noexcept -> void { set_bit(value, 5); }
+	constexpr auto set_substract() noexcept -> void
+	{
+		materialize();
+		set_bit(value, 6);
+	}
+	constexpr auto set_half_carry() noexcept -> void
+	{
+		materialize();
+		set_bit(value, 5);
+	}
 	constexpr auto set_carry(std::uint8_t C) noexcept -> void
 	{
 		value = set_bit(value, 4, C);
 	}
 };
 
+/*
+ *  BC DE and HL are stored as 16 bits pairs aliased by their 8 bits halves,
+ *  the order of the halves follows the host byte order. F is lazy (see
+ *  above) therefore AF is only available through AF() and set_AF().
+ */
 struct Register_bank {
-	ISA::Register8 A, B, C, D, E;
+	ISA::Register8 A;
 	ISA::Flag_register F;
-	ISA::Register8 H, L;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	union {
+		ISA::Register16 BC = 0;
+		struct {
+			ISA::Register8 C, B;
+		};
+	};
+	union {
+		ISA::Register16 DE = 0;
+		struct {
+			ISA::Register8 E, D;
+		};
+	};
+	union {
+		ISA::Register16 HL = 0;
+		struct {
+			ISA::Register8 L, H;
+		};
+	};
+#else
+	union {
+		ISA::Register16 BC = 0;
+		struct {
+			ISA::Register8 B, C;
+		};
+	};
+	union {
+		ISA::Register16 DE = 0;
+		struct {
+			ISA::Register8 D, E;
+		};
+	};
+	union {
+		ISA::Register16 HL = 0;
+		struct {
+			ISA::Register8 H, L;
+		};
+	};
+#endif
 	ISA::Register16 SP, PC = 0;
-	bool interupt_enable;
-};
-struct Inc_HL {
-	inline auto operator()(Register_bank &bank) -> void
+
+	constexpr auto AF() const noexcept -> Register16 { return compose(A, F.read()); }
+	// the lower nibble of F does not exist
+	constexpr auto set_AF(Register16 value) noexcept -> void
 	{
-		std::tie(bank.H, bank.L) =
-		    decompose(static_cast<std::uint16_t>(compose(bank.H, bank.L) + 1));
+		A = value >> 8;
+		F = value & 0xF0;
 	}
 };
+struct Inc_HL {
+	inline auto operator()(Register_bank &bank) -> void { ++bank.HL; }
+};
 struct Dec_HL {
-	inline auto operator()(Register_bank &bank) -> void
-	{
-		std::tie(bank.H, bank.L) =
-		    decompose(static_cast<std::uint16_t>(compose(bank.H, bank.L) - 1));
-	}
+	inline auto operator()(Register_bank &bank) -> void { --bank.HL; }
 };
 
 /*************************** Arithmetic *********************************/
 template <Unsigned T, Unsigned U = T>
 constexpr auto ADD(T lhs, U rhs, Flag_register &F) noexcept -> std::uint8_t
 {
-	F.clear_substract();
 	using gtype = std::conditional_t<sizeof(T) >= sizeof(U), T, U>;
 	const Overflow_trait_t<gtype> val = static_cast<gtype>(lhs) + static_cast<gtype>(rhs);
 
-	if(val > 0xFF) F.set_carry();
-	if((val & 0xFF) == 0) F.set_zero();
-	if(((lhs & 0b1111) + (rhs & 0b1111)) > 0b1111) F.set_half_carry();
+	F.record(Flag_register::Op::Add, lhs, rhs, val);
+	F.set_carry(val > 0xFF);
+	return val;
+}
+
+constexpr auto ADD(Register16 lhs, Register16 rhs, Flag_register &F) noexcept
+    -> Register16
+{
+	// Z is left as is
+	F.clear_substract();
+	const std::uint32_t val = lhs + rhs;
+
+	F.set_carry(val > 0xFFFF);
+	if(((lhs & 0xFFF) + (rhs & 0xFFF)) > 0xFFF) F.set_half_carry();
+	else F.clear_half_carry();
 
 	return val;
 }
 
+// SP + e8, flags are computed on the lower byte
+constexpr auto ADD_SP(Register16 SP, Imm8 offset, Flag_register &F) noexcept -> Register16
+{
+	F.reset_flag();
+	if(((SP & 0xFF) + offset) > 0xFF) F.set_carry();
+	if(((SP & 0xF) + (offset & 0xF)) > 0xF) F.set_half_carry();
+
+	return SP + static_cast<Imm8_s>(offset);
+}
+
 constexpr auto SUB(Register8 lhs, Register8 rhs, Flag_register &F) -> std::uint8_t
 {
-	F.set_substract();
-	const auto val = lhs - rhs;
-	if(lhs > rhs) F.set_carry();
-	if(val == 0) F.set_zero();
-	if((lhs & 0b1111) > (rhs & 0b1111)) F.set_half_carry();
+	const std::uint8_t val = lhs - rhs;
+	F.record(Flag_register::Op::Sub, lhs, rhs, val);
+	F.set_carry(lhs < rhs);
 	return val;
 }
 
 template <Unsigned T> constexpr auto ADC(T lhs, T rhs, Flag_register &F) noexcept -> T
 {
-	F.clear_substract();
 	const auto val = lhs + rhs + F.carry();
 
-	if(val > 0xFF) F.set_carry();
-	if((val & 0xFF) == 0) F.set_zero();
-	if(((lhs & 0b111) + (rhs & 0b111)) > 0b111) F.set_half_carry();
-
+	F.record(Flag_register::Op::Adc, lhs, rhs, val);
+	F.set_carry(val > 0xFF);
 	return val;
 }
 
 constexpr auto SBC(Register8 lhs, Register8 rhs, Flag_register &F) noexcept
     -> std::uint8_t
 {
-	F.set_substract();
-	const unsigned val = lhs - rhs - F.carry();
-	if(lhs > rhs) F.set_carry();
-	if(val == 0) F.set_zero();
-	if((lhs & 0b1111) > (rhs & 0b1111)) F.set_half_carry();
-
+	const unsigned borrow = rhs + F.carry();
+	const std::uint8_t val = lhs - borrow;
+	F.record(Flag_register::Op::Sub, lhs, rhs, val);
+	F.set_carry(lhs < borrow);
 	return val;
 }
 
 constexpr auto XOR(Register8 lhs, Register8 rhs, Flag_register &F) noexcept
     -> std::uint8_t
 {
-	F.clear_substract();
+	const std::uint8_t tmp = lhs ^ rhs;
+	F.record(Flag_register::Op::Logic, lhs, rhs, tmp);
 	F.clear_carry();
-	F.clear_half_carry();
-	const auto tmp = lhs ^ rhs;
-	if(tmp == 0) F.set_zero();
-
 	return tmp;
 }
 
 constexpr auto OR(Register8 lhs, Register8 rhs, Flag_register &F) noexcept -> std::uint8_t
 {
-	F.clear_substract();
+	const std::uint8_t tmp = lhs | rhs;
+	F.record(Flag_register::Op::Logic, lhs, rhs, tmp);
 	F.clear_carry();
-	F.clear_half_carry();
-	const auto tmp = lhs | rhs;
-	if(tmp == 0) F.set_zero();
-
 	return tmp;
 }
 
 constexpr auto AND(Register8 lhs, Register8 rhs, Flag_register &F) noexcept
     -> std::uint8_t
 {
-	F.clear_substract();
+	const std::uint8_t tmp = lhs & rhs;
+	F.record(Flag_register::Op::And, lhs, rhs, tmp);
 	F.clear_carry();
-	F.set_half_carry();
-	const auto tmp = lhs & rhs;
-	if(tmp == 0) F.set_zero();
-
 	return tmp;
 }
 
 constexpr auto CP(Register8 lhs, Register8 rhs, Flag_register &F) noexcept -> void
 {
-	if(lhs == rhs) F.set_zero();
-	if(lhs < rhs) F.set_carry();
-	if((lhs & 0b1111) < (rhs & 0b1111)) F.set_half_carry();
-	F.set_substract();
-
+	F.record(Flag_register::Op::Cp, lhs, rhs, lhs - rhs);
+	F.set_carry(lhs < rhs);
 	return;
 }
 
 template <Unsigned T> constexpr auto INC(T source, Flag_register &F) noexcept -> T
 {
-	F.clear_substract();
-	if(((source & 0b1111) + (0b1)) > 0b1111) F.set_half_carry();
-
 	const T tmp = source + 1;
-	if(tmp == 0) F.set_zero();
+	F.record(Flag_register::Op::Inc, source, 1, tmp);
 	return tmp;
 }
-constexpr auto INC(Register16 source, Flag_register &F, const Memory &memory) noexcept
-    -> Register8
+template <typename MBC>
+constexpr auto INC(Register16 source, Flag_register &F,
+                   const Memory<MBC> &memory) noexcept -> Register8
 {
-	F.clear_substract();
-	if(((source & 0b1111) + (0b1)) > 0b1111) F.set_half_carry();
-
-	const Register8 tmp = (memory.read(source)) + 1;
-	if(tmp == 0) F.set_zero();
+	const Register8 value = memory.read(source);
+	const Register8 tmp = value + 1;
+	F.record(Flag_register::Op::Inc, value, 1, tmp);
 	return tmp;
 }
 
-constexpr auto DEC(Register16 source, Flag_register &F, const Memory &memory) noexcept
-    -> Register8
+template <typename MBC>
+constexpr auto DEC(Register16 source, Flag_register &F,
+                   const Memory<MBC> &memory) noexcept -> Register8
 {
-	F.clear_substract();
-	if(((source & 0b1111) + (0b1)) > 0b1111) F.set_half_carry();
-
-	const Register16 tmp = (memory.read(source)) - 1;
-	if(tmp == 0) F.set_zero();
+	const Register8 value = memory.read(source);
+	const Register8 tmp = value - 1;
+	F.record(Flag_register::Op::Dec, value, 1, tmp);
 	return tmp;
 }
 
 template <Unsigned T> constexpr auto DEC(T source, Flag_register &F) noexcept -> T
 {
-	if(((source & 0b1111) - (0b1)) < 0) F.set_half_carry();
-
 	const T tmp = source - 1;
-	if(tmp == 0) F.set_zero();
-	F.set_substract();
+	F.record(Flag_register::Op::Dec, source, 1, tmp);
 	return tmp;
 }
 
 constexpr auto SWAP(Register8 source, Flag_register &F) noexcept -> std::uint8_t
 {
 	const auto [hi, lo] = decompose(source);
-	const auto tmp = ((lo << 4) | hi);
-	if(tmp == 0) F.set_zero();
-
+	const std::uint8_t tmp = ((lo << 4) | hi);
+	F.record(Flag_register::Op::Shift, source, 0, tmp);
+	F.clear_carry();
 	return tmp;
 }
 
@@ -242,8 +365,8 @@ constexpr auto RRC(Register8 source, Flag_register &F) noexcept -> std::uint8_t
 {
 	const std::uint8_t C = (source & 0x1);
 	const auto tmp = set_bit(static_cast<Register8>(source >> 1), 7, C);
+	F.record(Flag_register::Op::Shift, source, 0, tmp);
 	F.set_carry(C);
-	if(tmp == 0) F.set_zero();
 	return tmp;
 }
 
@@ -251,8 +374,8 @@ constexpr auto RLC(Register8 source, Flag_register &F) noexcept -> std::uint8_t
 {
 	const std::uint8_t C = (source & 0x80) >> 7;
 	const auto tmp = set_bit(static_cast<Register8>(source << 1), 0, C);
+	F.record(Flag_register::Op::Shift, source, 0, tmp);
 	F.set_carry(C);
-	if(tmp == 0) F.set_zero();
 	return tmp;
 }
 
@@ -260,8 +383,8 @@ constexpr auto RR(Register8 source, Flag_register &F) noexcept -> std::uint8_t
 {
 	const std::uint8_t C = (source & 0x1);
 	const auto tmp = set_bit(static_cast<Register8>(source >> 1), 7, F.carry());
+	F.record(Flag_register::Op::Shift, source, 0, tmp);
 	F.set_carry(C);
-	if(source == static_cast<uint8_t>(0)) F.set_zero();
 	return tmp;
 }
 
@@ -269,8 +392,34 @@ constexpr auto RL(Register8 source, Flag_register &F) noexcept -> std::uint8_t
 {
 	const std::uint8_t C = (source & 0x80) >> 7;
 	const auto tmp = set_bit(static_cast<Register8>(source << 1), 0, F.carry());
+	F.record(Flag_register::Op::Shift, source, 0, tmp);
 	F.set_carry(C);
-	if(tmp == 0) F.set_zero();
+	return tmp;
+}
+
+// RLCA RRCA RLA RRA: unlike the 0xCB rotations Z is always cleared
+constexpr auto RLCA(Register8 A, Flag_register &F) noexcept -> Register8
+{
+	const auto tmp = RLC(A, F);
+	F = static_cast<Register8>(F.carry() << 4);
+	return tmp;
+}
+constexpr auto RRCA(Register8 A, Flag_register &F) noexcept -> Register8
+{
+	const auto tmp = RRC(A, F);
+	F = static_cast<Register8>(F.carry() << 4);
+	return tmp;
+}
+constexpr auto RLA(Register8 A, Flag_register &F) noexcept -> Register8
+{
+	const auto tmp = RL(A, F);
+	F = static_cast<Register8>(F.carry() << 4);
+	return tmp;
+}
+constexpr auto RRA(Register8 A, Flag_register &F) noexcept -> Register8
+{
+	const auto tmp = RR(A, F);
+	F = static_cast<Register8>(F.carry() << 4);
 	return tmp;
 }
 
@@ -278,11 +427,8 @@ constexpr auto SLA(Register8 source, Flag_register &F) noexcept -> std::uint8_t
 {
 	const std::uint8_t C = (source & 0x80) >> 7;
 	const std::uint8_t result = (source << 1);
+	F.record(Flag_register::Op::Shift, source, 0, result);
 	F.set_carry(C);
-
-	F.clear_substract();
-	F.clear_half_carry();
-	if(result == 0) F.set_zero();
 	return result;
 }
 
@@ -290,11 +436,8 @@ constexpr auto SRL(Register8 source, Flag_register &F) noexcept -> std::uint8_t
 {
 	const std::uint8_t C = (source & 0x1);
 	const std::uint8_t result = (source >> 1);
+	F.record(Flag_register::Op::Shift, source, 0, result);
 	F.set_carry(C);
-
-	F.clear_substract();
-	F.clear_half_carry();
-	if(result == 0) F.set_zero();
 	return result;
 }
 
@@ -303,11 +446,8 @@ constexpr auto SRA(Register8 source, Flag_register &F) noexcept -> std::uint8_t
 	const std::uint8_t C = (source & 0x1);
 	const std::uint8_t MSB = (source & 0x80) >> 7;
 	const std::uint8_t result = set_bit(static_cast<Register8>(source >> 1), 7, MSB);
+	F.record(Flag_register::Op::Shift, source, 0, result);
 	F.set_carry(C);
-
-	F.clear_substract();
-	F.clear_half_carry();
-	if(result == 0) F.set_zero();
 	return result;
 }
 
@@ -321,12 +461,11 @@ constexpr auto SET(size_t idx, Register8 source) noexcept -> std::uint8_t
 	return source | (0x1 << idx);
 }
 
-constexpr auto BIT(size_t idx, Register8 source, Flag_register &F) noexcept
-    -> std::uint8_t
+// Z is set when the bit is clear, same flags as AND with a single bit mask
+constexpr auto BIT(size_t idx, Register8 source, Flag_register &F) noexcept -> void
 {
-	// Flag zero
-	F = F.read() | static_cast<Register8>(get_bit(source, idx) << 7);
-	return 1;
+	const Register8 mask = 0x1 << idx;
+	F.record(Flag_register::Op::And, source, mask, source & mask);
 }
 
 constexpr auto double_dabble(Register8 A) noexcept -> std::pair<uint8_t, bool>
@@ -353,8 +492,8 @@ constexpr auto DAA(Register8 A, Flag_register &F) -> Register8
 }
 /*************************** Memory *********************************/
 constexpr auto LD(Register8 source) noexcept -> Register8 { return source; }
-template <class HL_Policy>
-auto LD(Register16 source, const Memory &memory, Register_bank &reg_bank) noexcept
+template <class HL_Policy, typename MBC>
+auto LD(Register16 source, const Memory<MBC> &memory, Register_bank &reg_bank) noexcept
     -> std::uint8_t
 {
 	HL_Policy{}(reg_bank);
@@ -367,11 +506,13 @@ constexpr auto LD(Register16 source, Register_bank &reg_bank) noexcept
 	HL_Policy{}(reg_bank);
 	return source;
 }
-constexpr auto LD(Register16 source, const Memory &memory) noexcept -> std::uint8_t
+template <typename MBC>
+constexpr auto LD(Register16 source, const Memory<MBC> &memory) noexcept -> std::uint8_t
 {
 	return memory.read(source);
 }
-constexpr auto LDH(Imm8 value, const Memory &memory) noexcept -> std::uint8_t
+template <typename MBC>
+constexpr auto LDH(Imm8 value, const Memory<MBC> &memory) noexcept -> std::uint8_t
 {
 	return memory.read(compose(static_cast<uint8_t>(0xFF), value));
 }
@@ -387,24 +528,28 @@ constexpr auto LD(Register16 source, Imm16 imm) noexcept
 }
 
 /*************************** Control Flow *********************************/
+template <FLAG cc> constexpr auto condition(Flag_register F) noexcept -> bool
+{
+	if constexpr(cc == Z) return F.zero();
+	if constexpr(cc == C) return F.carry();
+	if constexpr(cc == NZ) return not F.zero();
+	if constexpr(cc == NC) return not F.carry();
+}
+
 constexpr auto JP(Register16 &PC, Register16 destination) noexcept -> void
 {
 	PC = destination;
 	return;
 }
 
+// conditional flow control return true when the branch is taken
 template <FLAG cc>
 constexpr auto JP(Register16 &PC, Register16 destination, Flag_register F) noexcept
-    -> void
+    -> bool
 {
-	if constexpr(cc == Z)
-		if(not F.zero()) return JP(PC, destination);
-	if constexpr(cc == C)
-		if(not F.carry()) return JP(PC, destination);
-	if constexpr(cc == NZ)
-		if(F.zero()) return JP(PC, destination);
-	if constexpr(cc == NC)
-		if(F.carry()) return JP(PC, destination);
+	if(not condition<cc>(F)) return false;
+	JP(PC, destination);
+	return true;
 }
 constexpr auto JR(Register16 &PC, Imm8_s add) noexcept -> void
 {
@@ -413,21 +558,18 @@ constexpr auto JR(Register16 &PC, Imm8_s add) noexcept -> void
 }
 
 template <FLAG cc>
-constexpr auto JR(Register16 &PC, Imm8_s add, Flag_register F) noexcept -> void
+constexpr auto JR(Register16 &PC, Imm8_s add, Flag_register F) noexcept -> bool
 {
-	if constexpr(cc == Z)
-		if(not F.zero()) return JR(PC, add);
-	if constexpr(cc == C)
-		if(not F.carry()) return JR(PC, add);
-	if constexpr(cc == NZ)
-		if(F.zero()) return JR(PC, add);
-	if constexpr(cc == NC)
-		if(F.carry()) return JR(PC, add);
+	if(not condition<cc>(F)) return false;
+	JR(PC, add);
+	return true;
 }
 constexpr auto _dec(Register16 &value) noexcept { return --value; }
 constexpr auto _inc(Register16 &value) noexcept { return ++value; }
 
-constexpr auto PUSH(Register16 &SP, Memory &memory, Register16 value) noexcept -> void
+template <typename MBC>
+constexpr auto PUSH(Register16 &SP, Memory<MBC> &memory, Register16 value) noexcept
+    -> void
 {
 	const auto [hi, lo] = decompose(value);
 	memory.write(_dec(SP), hi);
@@ -435,70 +577,67 @@ constexpr auto PUSH(Register16 &SP, Memory &memory, Register16 value) noexcept -
 	return;
 }
 
-constexpr auto POP(Register16 &SP, const Memory &memory) noexcept
+// return {hi, lo} so that the result can be compose()
+template <typename MBC>
+constexpr auto POP(Register16 &SP, const Memory<MBC> &memory) noexcept
     -> std::pair<std::uint8_t, std::uint8_t>
 {
-	const auto val = std::make_pair(memory.read(SP), memory.read(_inc(SP)));
-	++SP;
-	return val;
+	const std::uint8_t lo = memory.read(SP++);
+	const std::uint8_t hi = memory.read(SP++);
+	return std::make_pair(hi, lo);
 }
-constexpr auto CALL(Register16 &PC, Register16 &SP, Imm16 addr, Memory &memory) noexcept
-    -> void
+template <typename MBC>
+constexpr auto CALL(Register16 &PC, Register16 &SP, Imm16 addr,
+                    Memory<MBC> &memory) noexcept -> void
 {
 	PUSH(SP, memory, PC);
 	return JP(PC, addr);
 }
 
-template <FLAG cc>
-auto CALL(Register16 &PC, Register16 &SP, Imm16 addr, Memory &memory,
-          Flag_register F) noexcept -> void
-{
-	if constexpr(cc == NC)
-		if(not F.zero()) CALL(PC, SP, addr, memory);
-	if constexpr(cc == C)
-		if(not F.carry()) CALL(PC, SP, addr, memory);
-	if constexpr(cc == NZ)
-		if(F.zero()) CALL(PC, SP, addr, memory);
-	if constexpr(cc == NC)
-		if(F.carry()) CALL(PC, SP, addr, memory);
-	return;
+template <FLAG cc, typename MBC>
+auto CALL(Register16 &PC, Register16 &SP, Imm16 addr, Memory<MBC> &memory,
+          Flag_register F) noexcept -> bool
+{
+	if(not condition<cc>(F)) return false;
+	CALL(PC, SP, addr, memory);
+	return true;
 }
 
-constexpr auto RST(Register16 &PC, Register16 &SP, Imm8 addr, Memory &memory) noexcept
-    -> void
+template <typename MBC>
+constexpr auto RST(Register16 &PC, Register16 &SP, Imm8 addr,
+                   Memory<MBC> &memory) noexcept -> void
 {
 	PUSH(SP, memory, PC);
 	return JP(PC, addr);
 }
-constexpr auto RET(Register16 &PC, Register16 &SP, Memory &memory) noexcept -> void
+template <typename MBC>
+constexpr auto RET(Register16 &PC, Register16 &SP, Memory<MBC> &memory) noexcept -> void
 {
 	return JP(PC, compose(POP(SP, memory)));
 }
-template <FLAG cc>
-auto RET(Register16 &PC, Register16 &SP, Memory &memory, Flag_register F) noexcept -> void
-{
-	if constexpr(cc == NC)
-		if(not F.zero()) RET(PC, SP, memory);
-	if constexpr(cc == C)
-		if(not F.carry()) RET(PC, SP, memory);
-	if constexpr(cc == NZ)
-		if(F.zero()) RET(PC, SP, memory);
-	if constexpr(cc == NC)
-		if(F.carry()) RET(PC, SP, memory);
-	return;
+template <FLAG cc, typename MBC>
+auto RET(Register16 &PC, Register16 &SP, Memory<MBC> &memory, Flag_register F) noexcept
+    -> bool
+{
+	if(not condition<cc>(F)) return false;
+	RET(PC, SP, memory);
+	return true;
 }
 
-constexpr auto EI(Memory &memory) noexcept -> void
+template <typename MBC>
+constexpr auto EI(Memory<MBC> &memory) noexcept -> void
 {
-	memory.write_IME(0x1F);
+	memory.interrupts().set_master(true);
 	return;
 }
-constexpr auto DI(Memory &memory) noexcept -> void
+template <typename MBC>
+constexpr auto DI(Memory<MBC> &memory) noexcept -> void
 {
-	memory.write_IME(0b0);
+	memory.interrupts().set_master(false);
 	return;
 }
-constexpr auto RETI(Register16 &PC, Register16 &SP, Memory &memory) noexcept -> void
+template <typename MBC>
+constexpr auto RETI(Register16 &PC, Register16 &SP, Memory<MBC> &memory) noexcept -> void
 {
 	JP(PC, compose(POP(SP, memory)));
 	return EI(memory);
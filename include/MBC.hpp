@@ -35,27 +35,62 @@ enum Memory_map : uint16_t {
 	IME_base = IRAM1_ul,
 };
 
+// 256 bytes page of the address space as mapped by a controller, the
+// accesses without a slow flag are a plain load or store through data
+struct Memory_page {
+	enum Flag : std::uint8_t { Slow_read = 0b01, Slow_write = 0b10 };
+	std::uint8_t *data = nullptr;
+	std::uint8_t flags = Slow_read | Slow_write;
+};
+
+// emulated time as the controllers see it, in M-cycles at normal speed;
+// read is called with context, no reader means the time is frozen at 0
+struct Cycle_counter {
+	using Reader = auto (*)(const void *context) noexcept -> std::uint64_t;
+	Reader read = nullptr;
+	const void *context = nullptr;
+
+	auto operator()() const noexcept -> std::uint64_t
+	{
+		return (read) ? read(context) : 0;
+	}
+};
+
 // EMPTY MBC for GameBoy
 class Simple_MBC {
 	// when we have constexpr vector would this class be constexpr-able ?
+	std::span<std::uint8_t> m_rom;
 	std::span<std::uint8_t> m_memory_view;
 
   public:
 	constexpr Simple_MBC() = delete;
-	template <typename Iter>
-	constexpr Simple_MBC(const Iter begin, const Iter end) : m_memory_view(begin, end)
+	// no banking and no external RAM
+	constexpr Simple_MBC(std::span<std::uint8_t> rom, std::span<std::uint8_t> memory,
+	                     std::span<std::uint8_t>)
+	    : m_rom(rom), m_memory_view(memory)
 	{
-		if(std::distance(begin, end) > 64_kB) {
-			throw std::invalid_argument("Either program is too big or ram");
+		if(rom.size() < 32_kB or memory.size() < 64_kB) {
+			throw std::invalid_argument("Either program or ram is too small");
 		}
 	}
 	[[nodiscard]] auto read(std::uint16_t addr) const noexcept -> std::uint8_t
 	{
-		return m_memory_view[addr];
+		return (addr < IROM1_ul) ? m_rom[addr] : m_memory_view[addr];
 	}
 	auto write(std::uint16_t address, std::uint8_t value) noexcept -> void
 	{
-		if(address > IROM1_ul) m_memory_view[address] = value;
+		if(address >= IROM1_ul) m_memory_view[address] = value;
+	}
+	// the ROM is read only
+	[[nodiscard]] auto map(std::uint8_t page) noexcept -> Memory_page
+	{
+		if(page < (IROM1_ul >> 8)) return {&m_rom[page << 8], Memory_page::Slow_write};
+		return {&m_memory_view[page << 8], 0};
+	}
+	// bank mapped at addr, only the ROM is banked
+	[[nodiscard]] auto bank(std::uint16_t addr) const noexcept -> std::uint16_t
+	{
+		return (addr >= IROM1_base and addr < IROM1_ul) ? 1 : 0;
 	}
 };
 
@@ -105,8 +140,10 @@ class Simple_MBC {
 class MBC1 {
 	std::uint8_t m_bank_selector = 0b1;
 	bool m_ramg_enable = 0;
-        // TODO move rom and ram size as template parameter ?
-        size_t m_ram;
+	// every bank of the cartridge
+	std::span<std::uint8_t> m_rom;
+	std::span<std::uint8_t> m_ram;
+	// the address space, its ROM and RAM slots are swapped to the banks
 	std::span<std::uint8_t> m_memory;
 	using MBC1_Partition = Partition<std::uint8_t, 64_kB, 8_kB>;
 	MBC1_Partition m_memory_partition;
@@ -116,25 +153,16 @@ class MBC1 {
 	mutable std::uniform_int_distribution<std::uint8_t> m_distrib;
 
   public:
-	// TODO cleanup, a bit messy
+	// memory is the address space, the RAM banks are used as they are: they may
+	// be a save file
+	MBC1(std::span<std::uint8_t> rom, std::span<std::uint8_t> memory,
+	     std::span<std::uint8_t> ram);
+	// a single buffer: the ROM banks, the address space then the RAM banks
 	template <typename Iter>
 	explicit MBC1(const Iter begin, const Iter end, size_t rom, size_t ram)
-	    : m_ram(ram), m_memory(begin, end),
-	      m_memory_partition(m_memory.begin(), m_memory.end(),
-	                         MBC1_Partition::descriptor{4, rom - 16_kB},
-	                         MBC1_Partition::descriptor{6, ram - 8_kB}),
-	      m_rd(), m_gen(m_rd()), m_distrib(0, 255)
+	    : MBC1(slice({begin, end}, 0, rom), slice({begin, end}, rom, 64_kB),
+	           slice({begin, end}, rom + 64_kB, ram))
 	{
-		if(rom> 2_MB or ram > 32_kB or
-                   (rom<=512_kB and ram > 32_kB) or
-                   (rom>=1_MB and rom <= 2_MB and ram>8_kB))
-                {
-			throw std::invalid_argument("Either program or ram is too big");
-		}
-		// after rom 8kB of Vram follow by swi ram
-		const auto ram_offset = rom + 8_kB;
-		std::generate(&m_memory[ram_offset], &m_memory[ram_offset + ram],
-		              [this] { return this->m_distrib(this->m_gen); });
 	}
 	auto mode() const -> uint8_t { return m_bank_selector >> 7; }
 	auto reg1() const -> uint8_t { return m_bank_selector & 0b1'1111; }
@@ -149,8 +177,142 @@ class MBC1 {
 	// note can also be used for bank in ram :
 	auto bank_reg2(std::uint8_t value) noexcept -> void;
 	auto bank_mode(std::uint8_t value) noexcept -> void;
+	// bank mapped at addr for ROM0, ROM1 and external RAM, 0 elsewhere
+	[[nodiscard]] auto bank(std::uint16_t addr) const noexcept -> std::uint16_t;
 	[[nodiscard]] auto read(std::uint16_t addr) const noexcept -> std::uint8_t;
 	auto write(std::uint16_t addr, std::uint8_t value) noexcept -> void;
+	// writes to the ROM are the registers, the RAM is slow when disabled
+	[[nodiscard]] auto map(std::uint8_t page) noexcept -> Memory_page;
+
+  private:
+	// clamped to the buffer, the sizes are checked by the constructor
+	static auto slice(std::span<std::uint8_t> buffer, size_t offset, size_t size) noexcept
+	    -> std::span<std::uint8_t>
+	{
+		offset = std::min(offset, buffer.size());
+		return buffer.subspan(offset, std::min(size, buffer.size() - offset));
+	}
+};
+
+/*
+ *  Real time clock of the MBC3. Nothing ticks: the time is derived from the
+ *  emulated cycles when the game latches or sets it, so the clock follows the
+ *  emulation (paused, fast forwarded) and the host time is never read.
+ *
+ *  Registers, selected through the RAM bank register:
+ *      0x08 : seconds      0x09 : minutes      0x0A : hours
+ *      0x0B : day counter <7-0>
+ *      0x0C : <0> day counter <8>, <6> halt, <7> day counter carry
+ *  The game reads the registers as they were at the last latch.
+ */
+class Real_time_clock {
+  public:
+	static constexpr std::uint64_t Cycles_per_second = 1'048'576;
+	enum Register : std::uint8_t { Seconds = 0x08, Minutes, Hours, Day_low, Day_high };
+
+	// the time counted so far is kept, it goes on from the current cycle
+	auto set_clock(Cycle_counter clock) noexcept -> void;
+	auto latch() noexcept -> void;
+	[[nodiscard]] auto read(std::uint8_t reg) const noexcept -> std::uint8_t
+	{
+		return m_latched[reg - Seconds];
+	}
+	// each register counts on its own: out of range values count up to the
+	// limit of their bits and wrap to 0 without carrying to the next one
+	auto write(std::uint8_t reg, std::uint8_t value) noexcept -> void;
+
+  private:
+	// count the cycles elapsed since the last sync
+	auto sync() noexcept -> void;
+	auto tick(std::uint64_t seconds) noexcept -> void;
+	auto registers() const noexcept -> std::array<std::uint8_t, 5>;
+
+	Cycle_counter m_clock;
+	// cycles of the current second, counted by the clock up to the emulated
+	// cycle m_synced
+	std::uint64_t m_cycles = 0;
+	std::uint64_t m_synced = 0;
+	std::uint8_t m_seconds = 0;
+	std::uint8_t m_minutes = 0;
+	std::uint8_t m_hours = 0;
+	// 9 bits
+	std::uint16_t m_days = 0;
+	bool m_halted = false;
+	bool m_carry = false;
+	std::array<std::uint8_t, 5> m_latched{};
+};
+
+/*
+ *  MBC3 controller:
+ *      0x0000-0x1FFF : RAM and clock enable, 0x0A in the low nibble
+ *      0x2000-0x3FFF : ROM bank <6-0> of ROM1, 0 selects 1
+ *      0x4000-0x5FFF : RAM bank 0x00-0x03, or a clock register 0x08-0x0C
+ *      0x6000-0x7FFF : writing 0x00 then 0x01 latches the clock
+ *      Up to 2MB of ROM and 32kB of RAM. A bank switch swaps the spans of the
+ *      partition, clock registers are read and written through the slow path.
+ */
+class MBC3 {
+	std::uint8_t m_rom_bank = 0b1;
+	std::uint8_t m_ram_select = 0;
+	std::uint8_t m_latch = 0xFF;
+	bool m_ramg_enable = false;
+	std::span<std::uint8_t> m_rom;
+	std::span<std::uint8_t> m_ram;
+	std::span<std::uint8_t> m_memory;
+	using MBC3_Partition = Partition<std::uint8_t, 64_kB, 8_kB>;
+	MBC3_Partition m_memory_partition;
+	Real_time_clock m_rtc;
+
+  public:
+	MBC3(std::span<std::uint8_t> rom, std::span<std::uint8_t> memory,
+	     std::span<std::uint8_t> ram);
+	auto set_clock(Cycle_counter clock) noexcept -> void { m_rtc.set_clock(clock); }
+	[[nodiscard]] auto bank(std::uint16_t addr) const noexcept -> std::uint16_t;
+	// disabled RAM reads as an open bus
+	[[nodiscard]] auto read(std::uint16_t addr) const noexcept -> std::uint8_t;
+	auto write(std::uint16_t addr, std::uint8_t value) noexcept -> void;
+	[[nodiscard]] auto map(std::uint8_t page) noexcept -> Memory_page;
+
+  private:
+	auto rtc_selected() const noexcept -> bool
+	{
+		return m_ram_select >= Real_time_clock::Seconds and
+		       m_ram_select <= Real_time_clock::Day_high;
+	}
+	auto swap_bank_rom() noexcept -> void;
+	auto swap_bank_ram() noexcept -> void;
+};
+
+/*
+ *  MBC5 controller:
+ *      0x0000-0x1FFF : RAM enable, exactly 0x0A
+ *      0x2000-0x2FFF : ROM bank <7-0> of ROM1, bank 0 can be selected
+ *      0x3000-0x3FFF : ROM bank <8>
+ *      0x4000-0x5FFF : RAM bank 0x0-0xF
+ *      Up to 8MB of ROM and 128kB of RAM.
+ */
+class MBC5 {
+	std::uint16_t m_rom_bank = 0b1;
+	std::uint8_t m_ram_bank = 0;
+	bool m_ramg_enable = false;
+	std::span<std::uint8_t> m_rom;
+	std::span<std::uint8_t> m_ram;
+	std::span<std::uint8_t> m_memory;
+	using MBC5_Partition = Partition<std::uint8_t, 64_kB, 8_kB>;
+	MBC5_Partition m_memory_partition;
+
+  public:
+	MBC5(std::span<std::uint8_t> rom, std::span<std::uint8_t> memory,
+	     std::span<std::uint8_t> ram);
+	[[nodiscard]] auto bank(std::uint16_t addr) const noexcept -> std::uint16_t;
+	// disabled RAM reads as an open bus
+	[[nodiscard]] auto read(std::uint16_t addr) const noexcept -> std::uint8_t;
+	auto write(std::uint16_t addr, std::uint8_t value) noexcept -> void;
+	[[nodiscard]] auto map(std::uint8_t page) noexcept -> Memory_page;
+
+  private:
+	auto swap_bank_rom() noexcept -> void;
+	auto swap_bank_ram() noexcept -> void;
 };
 
 #endif
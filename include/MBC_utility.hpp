@@ -9,6 +9,7 @@
 
 #include <array>
 #include <iterator>
+#include <ranges>
 #include <span>
 
 #include <stdexcept>
@@ -121,6 +122,11 @@ template <typename ValueType, size_t mem_size, size_t bin> class Partition {
 		auto val = lookup[idx >> Pow_2_v<bin>];
 		return val[idx & (bin - 1)];
 	}
+	// valid until its bin is swapped
+	constexpr auto data(size_t idx) const noexcept -> ValueType *
+	{
+		return lookup[idx >> Pow_2_v<bin>].data() + (idx & (bin - 1));
+	}
 	constexpr auto swap(size_t lookup_slot, std::span<ValueType> &&data) noexcept
 	{
 		std::swap(data, lookup[lookup_slot]);
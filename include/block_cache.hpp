@@ -0,0 +1,183 @@
+#ifndef __BLOCK_CACHE_HPP__
+#define __BLOCK_CACHE_HPP__
+#include "dynarec.hpp"
+#include "include_std.hpp"
+#include "memory.hpp"
+#include "opcode_table.hpp"
+
+#include <unordered_map>
+
+// a pre-decoded instruction, its immediate is already resolved
+template <typename Handler> struct Micro_op {
+	Handler handler;
+	std::uint16_t operand;
+	std::uint8_t opcode;
+	std::uint8_t length;
+	std::uint8_t cycles;
+	std::uint8_t cycles_taken;
+	// see ISA::Property
+	std::uint8_t properties;
+};
+
+// straight line code, only the last micro op may change the control flow
+template <typename Handler> struct Basic_block {
+	std::uint16_t begin;
+	std::uint16_t end;
+	std::vector<Micro_op<Handler>> ops;
+	// M-cycles when the last branch is not taken
+	unsigned cycles = 0;
+	// the last instruction may jump back to begin
+	bool self_loop = false;
+	// execution count and translation, see Dynarec
+	std::uint32_t hits = 0;
+	Dynarec::Native native = nullptr;
+	// towards the jump target and the next instruction
+	std::array<Dynarec::Link, 2> links{};
+};
+
+/*
+ *  Decoded blocks are keyed by PC and by the bank mapped at PC, therefore
+ *  a bank switch of the MBC only select other entries and nothing need to
+ *  be flushed. Code outside of the ROM may be rewritten: its pages are marked
+ *  in Memory and any write there drops every block living in RAM. A block
+ *  stays within the 8kB region of its first byte, the rare instruction
+ *  read across two regions depends on two banks and is never cached.
+ */
+template <typename Handler> class Block_cache {
+	static constexpr std::size_t Max_block_size = 64;
+	const std::array<Handler, 256> &m_handlers;
+	const std::array<Handler, 256> &m_extended;
+	std::unordered_map<std::uint32_t, Basic_block<Handler>> m_blocks;
+	// the last instruction across two regions, decoded again on each lookup
+	Basic_block<Handler> m_straddling{};
+	std::uint32_t m_code_version = 0;
+
+	static constexpr auto key(std::uint16_t pc, std::uint16_t bank) noexcept
+	    -> std::uint32_t
+	{
+		return (static_cast<std::uint32_t>(bank) << 16) | pc;
+	}
+	// blocks never cross a 8kB region, bank are at least that big
+	static constexpr auto region(std::uint16_t addr) noexcept -> std::uint16_t
+	{
+		return addr >> 13;
+	}
+	// the instruction at pc is read from two regions, which may be two banks
+	static constexpr auto straddles(std::uint32_t pc, std::uint8_t length) noexcept
+	    -> bool
+	{
+		return ((pc + length - 1) >> 13) != (pc >> 13);
+	}
+
+	// destination of JR and JP a16, next_pc otherwise
+	static constexpr auto target(const Micro_op<Handler> &op,
+	                             std::uint16_t next_pc) noexcept -> std::uint16_t
+	{
+		switch(op.opcode) {
+		case 0x18:
+		case 0x20:
+		case 0x28:
+		case 0x30:
+		case 0x38:
+			return next_pc + static_cast<std::int8_t>(op.operand);
+		case 0xC2:
+		case 0xC3:
+		case 0xCA:
+		case 0xD2:
+		case 0xDA:
+			return op.operand;
+		}
+		return next_pc;
+	}
+
+  public:
+	Block_cache(const std::array<Handler, 256> &handlers,
+	            const std::array<Handler, 256> &extended)
+	    : m_handlers(handlers), m_extended(extended)
+	{
+	}
+
+	// a single instruction, bypass the cache
+	template <typename MBC>
+	[[nodiscard]] auto decode_op(std::uint16_t pc, const Memory<MBC> &memory) const
+	    -> Micro_op<Handler>
+	{
+		const std::uint8_t opcode = memory.read(pc);
+		const auto &info = ISA::Opcode_table[opcode];
+		std::uint16_t operand = 0;
+		if(info.length == 2) operand = memory.read(pc + 1);
+		if(info.length == 3) {
+			operand = compose(memory.read(pc + 2), memory.read(pc + 1));
+		}
+		// the 0xCB prefix is resolved here, with the timing of its operand
+		if(opcode == 0xCB) {
+			const auto &extended = ISA::Extended_table[operand];
+			return {m_extended[operand], operand,
+			        opcode,              extended.length,
+			        extended.cycles,     extended.cycles_taken,
+			        ISA::Extended_properties[operand]};
+		}
+		return {m_handlers[opcode], operand,
+		        opcode,             info.length,
+		        info.cycles,        info.cycles_taken,
+		        ISA::Opcode_properties[opcode]};
+	}
+	template <typename MBC>
+	[[nodiscard]] auto decode(std::uint16_t pc, const Memory<MBC> &memory) const
+	    -> Basic_block<Handler>
+	{
+		Basic_block<Handler> block{pc, pc, {}};
+		while(block.ops.size() < Max_block_size) {
+			const auto op = decode_op(pc, memory);
+			// left to a block of its own, see lookup
+			if(not block.ops.empty() and straddles(pc, op.length)) break;
+			block.ops.push_back(op);
+			block.cycles += op.cycles;
+			pc += op.length;
+			if((op.properties & ISA::Changes_flow) or region(pc) != region(block.begin)) {
+				break;
+			}
+		}
+		block.end = pc;
+		block.self_loop = target(block.ops.back(), block.end) == block.begin;
+		return block;
+	}
+
+	template <typename MBC>
+	auto lookup(std::uint16_t pc, Memory<MBC> &memory) -> Basic_block<Handler> &
+	{
+		if(stale(memory)) [[unlikely]] {
+			invalidate(memory);
+		}
+		const auto id = key(pc, memory.bank(pc));
+		if(auto it = m_blocks.find(id); it != std::end(m_blocks)) {
+			return it->second;
+		}
+		// never cached, the key only tells the bank of the first byte
+		if(straddles(pc, ISA::Opcode_table[memory.read(pc)].length)) [[unlikely]] {
+			m_straddling = decode(pc, memory);
+			return m_straddling;
+		}
+		auto [it, inserted] = m_blocks.emplace(id, decode(pc, memory));
+		if(pc >= IROM1_ul) {
+			memory.mark_code(it->second.begin, it->second.end - 1);
+		}
+		return it->second;
+	}
+	// some code in RAM has been rewritten since the last lookup
+	template <typename MBC>
+	[[nodiscard]] auto stale(const Memory<MBC> &memory) const noexcept -> bool
+	{
+		return memory.code_version() != m_code_version;
+	}
+	template <typename MBC> auto invalidate(Memory<MBC> &memory) -> void
+	{
+		std::erase_if(m_blocks,
+		              [](const auto &elt) { return elt.second.begin >= IROM1_ul; });
+		memory.unmark_code();
+		m_code_version = memory.code_version();
+	}
+	[[nodiscard]] auto size() const noexcept -> std::size_t { return m_blocks.size(); }
+};
+
+#endif
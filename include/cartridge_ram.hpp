@@ -0,0 +1,49 @@
+#ifndef __CARTRIDGE_RAM_HPP__
+#define __CARTRIDGE_RAM_HPP__
+#include "include_std.hpp"
+
+#include <filesystem>
+#include <span>
+
+/*
+ *  External RAM of a cartridge, the banks of the controller point into it.
+ *  Without a battery it is a zeroed vector. With a battery it is a .sav
+ *  file mapped shared: a write of the game is a store in the page cache,
+ *  flush() only asks the kernel to start the write back (MS_ASYNC) and the
+ *  destructor waits for it. Dirty pages reach the file even if the process
+ *  exits without unwinding, only a crash of the host loses them.
+ */
+class Cartridge_ram {
+  public:
+	explicit Cartridge_ram(std::size_t size);
+	// create the file or grow it with zeros up to size, its content is kept;
+	// throw std::system_error when the file cannot be mapped
+	[[nodiscard]] static auto map(const std::filesystem::path &path, std::size_t size)
+	    -> Cartridge_ram;
+
+	Cartridge_ram(const Cartridge_ram &) = delete;
+	auto operator=(const Cartridge_ram &) -> Cartridge_ram & = delete;
+	Cartridge_ram(Cartridge_ram &&other) noexcept;
+	auto operator=(Cartridge_ram &&other) noexcept -> Cartridge_ram &;
+	~Cartridge_ram();
+
+	[[nodiscard]] auto bytes() noexcept -> std::span<std::uint8_t>
+	{
+		return {m_data, m_size};
+	}
+	[[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+	// backed by a save file
+	[[nodiscard]] auto persistent() const noexcept -> bool { return m_mapped; }
+	// schedule the write back of the dirty pages, does not block
+	auto flush() noexcept -> void;
+
+  private:
+	Cartridge_ram() = default;
+
+	std::vector<std::uint8_t> m_copy;
+	std::uint8_t *m_data = nullptr;
+	std::size_t m_size = 0;
+	bool m_mapped = false;
+};
+
+#endif
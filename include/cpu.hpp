@@ -4,34 +4,134 @@
 #include "Coroutine.hpp"
 #include "ISA.hpp"
 #include "bit_manipulation.hpp"
+#include "block_cache.hpp"
 #include "include_std.hpp"
 #include "memory.hpp"
+#include "opcode_table.hpp"
 #include <cstdint>
 #include <utility>
 
-class SM83 {
-	enum IMMEDIATE : uint8_t {
-		NO_IMM = 0,
-		IMM8,
-		IMM16,
-	};
+/*
+ *  Two ways to drive the CPU, chosen at construction:
+ *  - Cycle_accurate: run() is a coroutine, every instruction waits for its
+ *    M-cycles on the clock domain;
+ *  - Instruction_accurate: step() and run_cycles() execute whole instructions
+ *    synchronously and only add their M-cycles to a counter, for runs which
+ *    need a frame level timing.
+ *  Both share the handlers and the block cache.
+ */
+enum class Execution_mode : std::uint8_t { Cycle_accurate, Instruction_accurate };
+
+template <typename MBC> class SM83 {
+	// one handler by opcode, the immediate (if any) is already fetched.
+	// return true when a conditional branch is taken, see ISA::Opcode_info
+	using Handler = auto (SM83::*)(Memory<MBC> &, std::uint16_t) noexcept -> bool;
+	template <std::uint8_t opcode>
+	auto instruction(Memory<MBC> &memory, std::uint16_t imm) noexcept -> bool;
+	template <std::size_t... opcode>
+	static constexpr auto make_handlers(std::index_sequence<opcode...>) noexcept
+	    -> std::array<Handler, sizeof...(opcode)>
+	{
+		return {&SM83::instruction<opcode>...};
+	}
+	static const std::array<Handler, 256> m_handlers;
+	// 0xCB prefixed opcodes, the Handler immediate is unused
+	template <std::uint8_t opcode>
+	auto extended(Memory<MBC> &memory, std::uint16_t) noexcept -> bool;
+	template <std::size_t... opcode>
+	static constexpr auto make_extended_handlers(std::index_sequence<opcode...>) noexcept
+	    -> std::array<Handler, sizeof...(opcode)>
+	{
+		return {&SM83::extended<opcode>...};
+	}
+	static const std::array<Handler, 256> m_extended_handlers;
 
 	const Clock_domain &m_clock;
+	const Execution_mode m_mode;
 	ISA::Register_bank m_regbank;
+	// M-cycles elapsed in Instruction_accurate mode, and skipped in idle loops
+	// or halted
+	std::uint64_t m_cycles = 0;
+	std::uint64_t m_idle_cycles = 0;
+	Block_cache<Handler> m_cache{m_handlers, m_extended_handlers};
+	Dynarec m_dynarec;
+	bool m_dynarec_enabled = false;
+	// where the last native code left, chained to the next block looked up
+	Dynarec::Link *m_exit = nullptr;
+	// HALT executed and no interrupt requested since
+	bool m_halted = false;
+
+	static auto call_handler(void *cpu, void *memory, const void *context) noexcept
+	    -> bool;
+	static auto read_memory(void *memory, std::uint16_t addr) noexcept -> std::uint8_t;
+	static auto write_memory(void *memory, std::uint16_t addr,
+	                         std::uint8_t value) noexcept -> void;
+	auto translate(Basic_block<Handler> &block) -> void;
+	// the native code of the block if any, translate it once hot
+	auto native(Basic_block<Handler> &block) -> Dynarec::Native;
+	auto link(const Basic_block<Handler> &block, const Memory<MBC> &memory) noexcept
+	    -> void;
+	// fetch is done: move the PC and run the instruction
+	auto apply(const Micro_op<Handler> &, Memory<MBC> &) noexcept -> bool;
+	auto dispatch_interrupt(Memory<MBC> &memory) noexcept -> void;
+	// HALT ends once an interrupt is requested, even with IME clear
+	auto halted(const Memory<MBC> &memory) noexcept -> bool
+	{
+		if(m_halted) m_halted = not memory.interrupts().requested();
+		return m_halted;
+	}
+	// Instruction_accurate counterpart of the dispatch in run()
+	auto poll_interrupt(Memory<MBC> &memory) noexcept -> bool;
+	// native code may run the blocks chained to this one until end
+	auto run_block(Basic_block<Handler> &block, Memory<MBC> &memory, std::uint64_t end)
+	    -> void;
+	// what an idle loop must leave untouched
+	// (interrupts included, a loop may wait for one)
+	struct Idle_state {
+		std::uint16_t AF, BC, DE, HL, SP;
+		std::uint32_t writes;
+		std::uint8_t IE, IF;
+		bool IME;
+		auto operator==(const Idle_state &) const -> bool = default;
+	};
+	auto idle_state(const Memory<MBC> &memory) const noexcept -> Idle_state;
 
   public:
-	SM83(Clock_domain &clock) : m_clock(clock){};
+	using Instruction = Micro_op<Handler>;
+	SM83(const Clock_domain &clock, Execution_mode mode = Execution_mode::Cycle_accurate)
+	    : m_clock(clock), m_mode(mode){};
 
 	auto dump(std::ostream &cout) -> void;
-	[[nodiscard]] auto has_imm(std::uint8_t op) noexcept -> IMMEDIATE;
-	[[nodiscard]] auto fetch(const Memory &memory) -> task<uint8_t>;
-	[[nodiscard]] auto fetch_ovelap(const Memory &memory) noexcept -> uint8_t;
-	[[nodiscard]] auto fetch_imm8(const Memory &memory) -> task<uint8_t>;
-	[[nodiscard]] auto fetch_imm16(const Memory &memory) -> task<uint16_t>;
-	auto interrupt_handler(Memory &memory) -> task<void>;
-
-	auto execute(std::uint8_t, Memory &) noexcept -> task<void>;
-	auto extended_set(uint8_t opcode, Memory &memory) noexcept -> void;
-	auto run(Memory &) -> Dummy_coro;
+	// translate hot ROM blocks to host code, only on x86-64. Native code does
+	// not wait on the clock domain, enabling it in Cycle_accurate mode throws
+	auto set_dynarec(bool enabled) -> void
+	{
+		if(enabled and m_mode == Execution_mode::Cycle_accurate) {
+			throw std::logic_error("the dynarec is not cycle accurate");
+		}
+		m_dynarec_enabled = enabled and Dynarec::supported();
+	}
+	[[nodiscard]] auto dynarec() const noexcept -> bool { return m_dynarec_enabled; }
+	auto run(Memory<MBC> &) -> Dummy_coro;
+
+	// Instruction_accurate mode, return the M-cycles consumed
+	auto step(Memory<MBC> &) noexcept -> unsigned;
+	auto run_cycles(Memory<MBC> &, std::uint64_t cycles) -> std::uint64_t;
+
+	[[nodiscard]] auto mode() const noexcept -> Execution_mode { return m_mode; }
+	[[nodiscard]] auto cycles() const noexcept -> std::uint64_t { return m_cycles; }
+	[[nodiscard]] auto idle_cycles() const noexcept -> std::uint64_t
+	{
+		return m_idle_cycles;
+	}
+	[[nodiscard]] auto registers() noexcept -> ISA::Register_bank &
+	{
+		return m_regbank;
+	}
 };
+// instantiated in cpu.cpp for every controller
+extern template class SM83<Simple_MBC>;
+extern template class SM83<MBC1>;
+extern template class SM83<MBC3>;
+extern template class SM83<MBC5>;
 #endif
@@ -0,0 +1,128 @@
+#ifndef __DYNAREC_HPP__
+#define __DYNAREC_HPP__
+#include "ISA.hpp"
+#include "include_std.hpp"
+#include "memory.hpp"
+#include "units.hpp"
+
+/*
+ *  x86-64 translation of hot basic blocks.
+ *
+ *  Translated natively: NOP, the loads between registers and immediates,
+ *  LD rr,d16, INC/DEC rr and r, the 8 bits arithmetic on a register, an
+ *  immediate or (HL), the loads and stores through HL BC DE and a16, SCF CCF
+ *  CPL, JR JP and their conditional forms. During a block A B C D E H L SP,
+ *  F and the M-cycles live in host registers. F is computed eagerly: x86 sets
+ *  its zero, adjust and carry flags like the SM83 does Z H and C for the same
+ *  operations, LAHF and a table give them. Every other instruction calls back
+ *  the interpreter through a thunk, ISA remains the reference for them.
+ *
+ *  The memory accesses take the page table of Memory inline and call back its
+ *  slow path. A slow write may switch a bank, rewrite code or request an
+ *  interrupt, so the native code stops right after it, as after the thunk of
+ *  a store or of EI. The M-cycles are counted per instruction and stored
+ *  before any call back: the interpreter, the controller (its real time clock)
+ *  and the caller see the exact count.
+ *
+ *  A block leaving to a static address is chained to the translation there
+ *  through its Link, without going back to the CPU loop, until the cycle
+ *  budget is spent or a bank is switched. A block looping on itself is only
+ *  chained when it does not read memory: the CPU must see each iteration of a
+ *  polling loop to skip it (see SM83::run_cycles).
+ *
+ *  Measured with make bench (M-cycles emulated per second, the machine is
+ *  noisy): on an ALU loop 35-40 MHz for the coroutine interpreter, 170-270
+ *  for the blocks interpreted and 2650-3150 translated (about 13x); on a loop
+ *  of loads and 16 bits increments 55-65, 240-355 and 8400-14000 MHz.
+ */
+class Dynarec {
+  public:
+	// the native code of a block, entered through run()
+	using Native = const void *;
+	// a block exit towards a static address, chained to the translation there
+	// once the CPU has looked it up
+	struct Link {
+		Native code = nullptr;
+		// Memory::mapping_version() when chained, the bank at target may
+		// have changed since
+		std::uint32_t mapping = 0;
+		std::uint16_t target = 0;
+	};
+	// call the interpreter for the instruction described by context, return
+	// true when it is a taken conditional branch
+	using Thunk = auto (*)(void *cpu, void *memory, const void *context) noexcept -> bool;
+	// the slow paths of Memory
+	using Read = auto (*)(void *memory, std::uint16_t addr) noexcept -> std::uint8_t;
+	using Write = auto (*)(void *memory, std::uint16_t addr, std::uint8_t value) noexcept
+	    -> void;
+	// what the native code runs on, F must be materialized
+	struct State {
+		ISA::Register_bank *bank;
+		std::uint64_t *cycles;
+		// the chained blocks stop once the M-cycles reach end
+		std::uint64_t end;
+		Memory_view view;
+		void *cpu;
+		void *memory;
+		Thunk thunk;
+		Read read;
+		Write write;
+	};
+	struct Op {
+		std::uint8_t opcode;
+		std::uint16_t operand;
+		// PC once the instruction is fetched
+		std::uint16_t next_pc;
+		std::uint8_t cycles;
+		std::uint8_t cycles_taken;
+		// see ISA::Property
+		std::uint8_t properties;
+		const void *context;
+	};
+	// blocks executed that many times get translated
+	static constexpr std::uint32_t Hot_threshold = 16;
+	static constexpr std::size_t Code_size = 1_MB;
+
+	Dynarec() = default;
+	Dynarec(const Dynarec &) = delete;
+	auto operator=(const Dynarec &) -> Dynarec & = delete;
+	~Dynarec();
+
+	// the block starts at begin, its exits are links[0] for the jump and
+	// links[1] for the next instruction; nullptr if the host is not supported
+	// or if the code buffer is full
+	[[nodiscard]] auto compile(std::span<const Op> block, std::uint16_t begin,
+	                           std::span<Link, 2> links) -> Native;
+	// run code and the blocks chained to it, the registers and the M-cycles
+	// are stored back on return. Return the exit to chain, nullptr when the
+	// next PC is not static or must not be chained
+	auto run(State &state, Native code) const noexcept -> Link *;
+	[[nodiscard]] static constexpr auto supported() noexcept -> bool
+	{
+#if defined(__x86_64__)
+		return true;
+#else
+		return false;
+#endif
+	}
+	// does the instruction run natively or through the thunk
+	[[nodiscard]] static auto is_native(std::uint8_t opcode) noexcept -> bool;
+	[[nodiscard]] auto code_used() const noexcept -> std::size_t { return m_used; }
+
+  private:
+	std::uint8_t *m_code = nullptr;
+	std::size_t m_used = 0;
+	// shared by every block: enter from run(), leave to it, and the calls to
+	// the slow paths of the memory
+	const std::uint8_t *m_enter = nullptr;
+	const std::uint8_t *m_leave = nullptr;
+	const std::uint8_t *m_read = nullptr;
+	const std::uint8_t *m_write = nullptr;
+
+	// map the buffer and emit the shared code
+	auto allocate() -> bool;
+	// copy code after the last block, nullptr when the buffer is full
+	auto install(std::span<const std::uint8_t> code) -> const std::uint8_t *;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef __FRAME_POOL_HPP__
+#define __FRAME_POOL_HPP__
+#include "include_std.hpp"
+
+#include <cstddef>
+#include <new>
+
+/*
+ *  Coroutine frames come from size classes of 64 bytes, each with a free
+ *  list refilled by chunks. In steady state a frame is recycled by the next
+ *  coroutine of the same size and nothing reaches the heap.
+ *
+ *  The promises allocate from Frame_pool::current(): each thread has a
+ *  default pool and an emulator installs its own with a Scope. A frame
+ *  remembers its pool so it can be released whatever the current one is.
+ */
+class Frame_pool {
+	static constexpr std::size_t Granularity = 64;
+	static constexpr std::size_t Classes = 16;
+	static constexpr std::size_t Blocks_per_chunk = 32;
+	// keep the frame aligned as operator new would
+	static constexpr std::size_t Header = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+	static_assert(Header >= sizeof(Frame_pool *));
+
+	struct Free_block {
+		Free_block *next;
+	};
+	std::array<Free_block *, Classes> m_free{};
+	std::vector<void *> m_chunks;
+	std::size_t m_heap_allocations = 0;
+
+	inline static thread_local Frame_pool *t_current = nullptr;
+
+	static constexpr auto size_class(std::size_t size) noexcept -> std::size_t
+	{
+		return (size + Header - 1) / Granularity;
+	}
+	auto refill(std::size_t idx) -> void
+	{
+		const std::size_t block = (idx + 1) * Granularity;
+		auto *chunk = static_cast<std::byte *>(::operator new(block * Blocks_per_chunk));
+		++m_heap_allocations;
+		m_chunks.push_back(chunk);
+		for(std::size_t i = 0; i < Blocks_per_chunk; ++i) {
+			auto *free = reinterpret_cast<Free_block *>(chunk + i * block);
+			free->next = m_free[idx];
+			m_free[idx] = free;
+		}
+	}
+
+  public:
+	Frame_pool() = default;
+	Frame_pool(const Frame_pool &) = delete;
+	auto operator=(const Frame_pool &) -> Frame_pool & = delete;
+	~Frame_pool()
+	{
+		for(auto *chunk : m_chunks) {
+			::operator delete(chunk);
+		}
+	}
+
+	[[nodiscard]] static auto current() noexcept -> Frame_pool &
+	{
+		static thread_local Frame_pool fallback;
+		return (t_current != nullptr) ? *t_current : fallback;
+	}
+	// install a pool for the lifetime of the scope
+	class Scope {
+		Frame_pool *m_previous;
+
+	  public:
+		explicit Scope(Frame_pool &pool) noexcept : m_previous(t_current)
+		{
+			t_current = &pool;
+		}
+		Scope(const Scope &) = delete;
+		auto operator=(const Scope &) -> Scope & = delete;
+		~Scope() { t_current = m_previous; }
+	};
+
+	[[nodiscard]] auto allocate(std::size_t size) -> void *
+	{
+		std::byte *block;
+		if(const auto idx = size_class(size); idx >= Classes) [[unlikely]] {
+			block = static_cast<std::byte *>(::operator new(size + Header));
+			++m_heap_allocations;
+		}
+		else {
+			if(m_free[idx] == nullptr) [[unlikely]] {
+				refill(idx);
+			}
+			block = reinterpret_cast<std::byte *>(m_free[idx]);
+			m_free[idx] = m_free[idx]->next;
+		}
+		*reinterpret_cast<Frame_pool **>(block) = this;
+		return block + Header;
+	}
+	static auto deallocate(void *frame, std::size_t size) noexcept -> void
+	{
+		auto *block = static_cast<std::byte *>(frame) - Header;
+		auto &pool = **reinterpret_cast<Frame_pool **>(block);
+		if(const auto idx = size_class(size); idx >= Classes) [[unlikely]] {
+			::operator delete(block);
+		}
+		else {
+			auto *free = reinterpret_cast<Free_block *>(block);
+			free->next = pool.m_free[idx];
+			pool.m_free[idx] = free;
+		}
+	}
+	// number of calls to the global operator new since the creation
+	[[nodiscard]] auto heap_allocations() const noexcept -> std::size_t
+	{
+		return m_heap_allocations;
+	}
+};
+
+// to be inherited by a promise_type
+struct Pooled_frame {
+	static auto operator new(std::size_t size) -> void *
+	{
+		return Frame_pool::current().allocate(size);
+	}
+	static auto operator delete(void *frame, std::size_t size) noexcept -> void
+	{
+		Frame_pool::deallocate(frame, size);
+	}
+};
+
+#endif
@@ -25,5 +25,6 @@
 #include <stdexcept>
 
 #include <memory>
+#include <optional>
 
 #endif
@@ -0,0 +1,78 @@
+#ifndef __INTERRUPT_HPP__
+#define __INTERRUPT_HPP__
+#include "include_std.hpp"
+
+#include <bit>
+
+/*
+ *  IE (0xFFFF), IF (0xFF0F) and IME kept as plain state. Memory forwards the
+ *  writes of the two registers, devices call raise(). The interrupts which
+ *  can be serviced are cached in m_pending so that the CPU only tests it
+ *  once per instruction.
+ */
+class Interrupt_controller {
+	std::uint8_t m_enable = 0;
+	std::uint8_t m_flag = 0;
+	bool m_master = false;
+	std::uint8_t m_pending = 0;
+
+	constexpr auto update() noexcept -> void
+	{
+		m_pending = (m_master) ? (m_enable & m_flag & 0x1F) : 0;
+	}
+
+  public:
+	// by priority, the vector of an interrupt is 0x40 + 8 * line
+	enum Line : std::uint8_t { VBlank, LCD_stat, Timer, Serial, Joypad };
+	static constexpr std::uint16_t IE_address = 0xFFFF;
+	static constexpr std::uint16_t IF_address = 0xFF0F;
+	// two wait states, PUSH PC and the jump
+	static constexpr std::uint8_t Dispatch_cycles = 5;
+
+	constexpr auto write_IE(std::uint8_t value) noexcept -> void
+	{
+		m_enable = value;
+		update();
+	}
+	constexpr auto write_IF(std::uint8_t value) noexcept -> void
+	{
+		m_flag = value & 0x1F;
+		update();
+	}
+	// EI DI RETI
+	constexpr auto set_master(bool enable) noexcept -> void
+	{
+		m_master = enable;
+		update();
+	}
+	constexpr auto raise(Line line) noexcept -> void
+	{
+		m_flag |= 1 << line;
+		update();
+	}
+
+	[[nodiscard]] constexpr auto IE() const noexcept -> std::uint8_t { return m_enable; }
+	[[nodiscard]] constexpr auto IF() const noexcept -> std::uint8_t { return m_flag; }
+	[[nodiscard]] constexpr auto master() const noexcept -> bool { return m_master; }
+	[[nodiscard]] constexpr auto pending() const noexcept -> bool
+	{
+		return m_pending != 0;
+	}
+	// enabled and flagged whatever IME, what ends HALT
+	[[nodiscard]] constexpr auto requested() const noexcept -> bool
+	{
+		return (m_enable & m_flag & 0x1F) != 0;
+	}
+
+	// service the highest priority pending interrupt, return its vector
+	constexpr auto acknowledge() noexcept -> std::uint16_t
+	{
+		const auto line = std::countr_zero(m_pending);
+		m_flag &= ~(1 << line);
+		m_master = false;
+		m_pending = 0;
+		return 0x40 + 8 * line;
+	}
+};
+
+#endif
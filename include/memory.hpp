@@ -3,18 +3,24 @@
 #include "Clock.hpp"
 #include "Coroutine.hpp"
 #include "MBC.hpp"
+#include "cartridge_ram.hpp"
+#include "interrupt.hpp"
+#include "rom.hpp"
 
 #include "include_std.hpp"
 #include <cstdint>
 #include <exception>
 #include <initializer_list>
-#include <random>
-#include <variant>
+#include <concepts>
 
 struct Simple_MBC_tag {
 };
 struct MBC1_tag {
 };
+struct MBC3_tag {
+};
+struct MBC5_tag {
+};
 
 template <typename MBC> struct Tag_to_MBC_convert {
 };
@@ -27,12 +33,52 @@ template <> struct Tag_to_MBC_convert<MBC1_tag> {
 	using type = MBC1;
 };
 
+template <> struct Tag_to_MBC_convert<MBC3_tag> {
+	using type = MBC3;
+};
+
+template <> struct Tag_to_MBC_convert<MBC5_tag> {
+	using type = MBC5;
+};
+
 template <typename MBC>
 using Tag_to_MBC_convert_t = typename Tag_to_MBC_convert<MBC>::type;
 
-class Memory {
+// the fast paths of Memory::read() and write() for the code generated by
+// Dynarec, which takes the page flags into account and counts its writes too
+struct Memory_view {
+	const Memory_page *pages;
+	std::uint32_t *write_count;
+	const std::uint32_t *mapping_version;
+};
+
+/*
+ *  The controller is a template parameter: the cartridge type is known once
+ *  the ROM is loaded and never changes, so the whole core (Memory, SM83,
+ *  Gameboy) is instantiated for it and the slow paths call it directly.
+ */
+template <typename MBC> class Memory {
+	Rom_image m_rom;
+	Cartridge_ram m_ram;
+	// the address space, the controller maps its banks over it
 	std::vector<std::uint8_t> m_memory;
-	std::variant<Simple_MBC, MBC1> m_policy_rw;
+	MBC m_policy_rw;
+	// where each 256 bytes page is, the controller and the cases below take the
+	// slow path
+	std::array<Memory_page, 256> m_pages{};
+	// 256 bytes pages holding decoded code, writing there bump m_code_version
+	// so that decoded blocks can be dropped (see Block_cache)
+	std::array<bool, 256> m_code_page{};
+	std::uint32_t m_code_version = 0;
+	// writes to the controller registers, which may map other banks under the
+	// running code
+	std::uint32_t m_mapping_version = 0;
+	// number of writes, lets the CPU tell a loop only reading the memory
+	std::uint32_t m_write_count = 0;
+	// address watched for writes, out of range when none
+	std::uint32_t m_watch = No_watch;
+	bool m_watch_hit = false;
+	Interrupt_controller m_interrupts;
 
 	inline static constexpr std::array<std::uint8_t, 47> Scrolling_Nintendo_Graphic{
 	    0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00,
@@ -56,39 +102,163 @@ class Memory {
 		Serial_transfer_completion_it = 0x0058,
 		HtoL_P10_P13_it = 0x0060,
 	};
+	static constexpr std::uint32_t No_watch = 0x10000;
 	Memory() = delete;
 
-	template <typename Memory_Policy_tag>
-	Memory(Memory_Policy_tag, std::vector<std::uint8_t> rom, size_t ram)
-	try : m_memory([&rom, ram] {
-		std::vector<std::uint8_t> tmp(64_kB, 0x00);
-		std::move(rom.begin(), rom.end(), tmp.begin());
-		return tmp;
-	}()),
-	      m_policy_rw(Tag_to_MBC_convert_t<Memory_Policy_tag>(m_memory.begin(),
-	                                                          m_memory.end())) {
+	Memory(Rom_image rom, Cartridge_ram ram)
+	try : m_rom(std::move(rom)), m_ram(std::move(ram)), m_memory(64_kB, 0x00),
+	      m_policy_rw(m_rom.bytes(), m_memory, m_ram.bytes()) {
+		update_pages(0x00, 0xFF);
 	}
 	catch(...) {
 	}
+	// without a battery
+	Memory(Rom_image rom, size_t ram) : Memory(std::move(rom), Cartridge_ram{ram}) {}
+	template <typename Memory_Policy_tag>
+	requires std::same_as<Tag_to_MBC_convert_t<Memory_Policy_tag>, MBC>
+	Memory(Memory_Policy_tag, Rom_image rom, size_t ram) : Memory(std::move(rom), ram)
+	{
+	}
+	// the pages point into m_memory
+	Memory(const Memory &) = delete;
+	auto operator=(const Memory &) -> Memory & = delete;
 
 	constexpr auto read(std::uint16_t addr) const noexcept -> std::uint8_t
 	{
-		return std::visit([addr](const auto &visitor) { return visitor.read(addr); },
-		                  m_policy_rw);
+		const auto &page = m_pages[addr >> 8];
+		if(page.flags & Memory_page::Slow_read) [[unlikely]] {
+			return read_slow(addr);
+		}
+		return page.data[addr & 0xFF];
 	}
 
 	constexpr auto write(std::uint16_t addr, std::uint8_t value) noexcept -> void
 	{
-		std::visit([addr, value](auto &visitor) { return visitor.write(addr, value); },
-		           m_policy_rw);
+		++m_write_count;
+		const auto &page = m_pages[addr >> 8];
+		if(page.flags & Memory_page::Slow_write) [[unlikely]] {
+			write_slow(addr, value);
+			return;
+		}
+		page.data[addr & 0xFF] = value;
+	}
+	// bank currently mapped at addr
+	auto bank(std::uint16_t addr) const noexcept -> std::uint16_t
+	{
+		return m_policy_rw.bank(addr);
+	}
+	auto mark_code(std::uint16_t begin, std::uint16_t end) noexcept -> void
+	{
+		for(size_t page = begin >> 8; page <= static_cast<size_t>(end >> 8); ++page) {
+			m_code_page[page] = true;
+			update_page(page);
+		}
+	}
+	auto unmark_code() noexcept -> void
+	{
+		m_code_page.fill(false);
+		update_pages(0x00, 0xFF);
+	}
+	auto code_version() const noexcept -> std::uint32_t { return m_code_version; }
+	auto mapping_version() const noexcept -> std::uint32_t { return m_mapping_version; }
+	auto write_count() const noexcept -> std::uint32_t { return m_write_count; }
+	// remember the next write to address, No_watch to stop
+	auto watch(std::uint32_t address) noexcept -> void
+	{
+		const auto previous = m_watch;
+		m_watch = address;
+		m_watch_hit = false;
+		if(previous != No_watch) update_page(previous >> 8);
+		if(address != No_watch) update_page(address >> 8);
 	}
-	constexpr auto write_IME(std::uint8_t value) -> void
+	// as the CPU sees it
+	auto page(std::uint8_t idx) const noexcept -> Memory_page { return m_pages[idx]; }
+	auto view() noexcept -> Memory_view
 	{
-		write(IME_base, value & 0x1F);
-		return;
+		return {m_pages.data(), &m_write_count, &m_mapping_version};
+	}
+	auto watch_hit() const noexcept -> bool { return m_watch_hit; }
+	// time of the controllers with a real time clock
+	auto set_clock(Cycle_counter clock) noexcept -> void
+	{
+		if constexpr(requires { m_policy_rw.set_clock(clock); }) {
+			m_policy_rw.set_clock(clock);
+		}
+	}
+	// write the battery backed RAM back to its save file, in the background
+	auto flush_ram() noexcept -> void { m_ram.flush(); }
+	constexpr auto interrupts() noexcept -> Interrupt_controller &
+	{
+		return m_interrupts;
+	}
+	constexpr auto interrupts() const noexcept -> const Interrupt_controller &
+	{
+		return m_interrupts;
+	}
+	// for the devices, IF is kept in sync in the memory
+	auto request_interrupt(Interrupt_controller::Line line) noexcept -> void
+	{
+		m_interrupts.raise(line);
+		write(Interrupt_controller::IF_address, m_interrupts.IF());
+	}
+	// for the CPU, the serviced line is cleared from IF in the memory too: the
+	// page of IF is read without the slow path
+	auto acknowledge_interrupt() noexcept -> std::uint16_t
+	{
+		const auto vector = m_interrupts.acknowledge();
+		m_policy_rw.write(Interrupt_controller::IF_address, m_interrupts.IF());
+		return vector;
+	}
+
+  private:
+	[[gnu::noinline]] auto read_slow(std::uint16_t addr) const noexcept -> std::uint8_t
+	{
+		return m_policy_rw.read(addr);
+	}
+	[[gnu::noinline]] auto write_slow(std::uint16_t addr, std::uint8_t value) noexcept
+	    -> void
+	{
+		if(m_code_page[addr >> 8]) [[unlikely]] {
+			++m_code_version;
+		}
+		if(addr == Interrupt_controller::IE_address) [[unlikely]] {
+			m_interrupts.write_IE(value);
+		}
+		if(addr == Interrupt_controller::IF_address) [[unlikely]] {
+			m_interrupts.write_IF(value);
+			// the unused bits are not stored
+			value = m_interrupts.IF();
+		}
+		if(addr == m_watch) [[unlikely]] {
+			m_watch_hit = true;
+		}
+		m_policy_rw.write(addr, value);
+		// the controller registers may have switched banks or the RAM gate
+		if(addr < IROM1_ul) {
+			++m_mapping_version;
+			update_pages(IROM0_base >> 8, (IROM1_ul >> 8) - 1);
+			update_pages(SWI_RAM_base >> 8, (SWI_RAM_ul >> 8) - 1);
+		}
+	}
+	auto update_page(std::size_t idx) noexcept -> void
+	{
+		auto page = m_policy_rw.map(idx);
+		// IE and IF are forwarded, the other registers have no side effect yet
+		if(idx == 0xFF or m_code_page[idx] or (m_watch >> 8) == idx) {
+			page.flags |= Memory_page::Slow_write;
+		}
+		m_pages[idx] = page;
+	}
+	auto update_pages(std::size_t first, std::size_t last) noexcept -> void
+	{
+		for(auto idx = first; idx <= last; ++idx) {
+			update_page(idx);
+		}
 	}
-	constexpr auto IME() const noexcept -> std::uint8_t { return read(IME_base) & 0x1F; }
-	constexpr auto IE() const noexcept { return read(0xFF0F); }
 };
 
+template <typename Memory_Policy_tag>
+Memory(Memory_Policy_tag, Rom_image, size_t)
+    -> Memory<Tag_to_MBC_convert_t<Memory_Policy_tag>>;
+
 #endif
@@ -0,0 +1,605 @@
+#ifndef __OPCODE_TABLE_HPP__
+#define __OPCODE_TABLE_HPP__
+#include "include_std.hpp"
+#include <string_view>
+
+namespace ISA {
+/*
+ *  Static description of an opcode:
+ *      - length : size in byte, opcode included
+ *      - cycles : M-cycles when the condition is not met (or unconditional)
+ *      - cycles_taken : M-cycles when a conditional branch is taken
+ *      - flags : effect on Z N H C, in this order
+ *              '-' not affected, '0' reset, '1' set, letter -> depends on result
+ */
+struct Opcode_info {
+	std::string_view mnemonic;
+	std::uint8_t length;
+	std::uint8_t cycles;
+	std::uint8_t cycles_taken;
+	std::string_view flags;
+
+	[[nodiscard]] constexpr auto is_conditional() const noexcept -> bool
+	{
+		return cycles != cycles_taken;
+	}
+	[[nodiscard]] constexpr auto affects_flags() const noexcept -> bool
+	{
+		return flags != "----";
+	}
+	// true when the next instruction may not be the following one in memory
+	[[nodiscard]] constexpr auto changes_flow() const noexcept -> bool
+	{
+		for(const auto prefix :
+		    {"JP", "JR", "CALL", "RET", "RST", "HALT", "STOP", "ILLEGAL"}) {
+			if(mnemonic.starts_with(prefix)) return true;
+		}
+		return false;
+	}
+	// true when the instruction stores to memory, pushes on the stack included
+	[[nodiscard]] constexpr auto writes_memory() const noexcept -> bool
+	{
+		for(const auto prefix : {"LD (", "LDH (", "PUSH", "CALL", "RST"}) {
+			if(mnemonic.starts_with(prefix)) return true;
+		}
+		// read-modify-write, the arithmetic, CP and BIT only read (HL)
+		if(not mnemonic.ends_with("(HL)")) return false;
+		for(const auto prefix :
+		    {"INC", "DEC", "RL", "RR", "SLA", "SRA", "SWAP", "SRL", "RES", "SET"}) {
+			if(mnemonic.starts_with(prefix)) return true;
+		}
+		return false;
+	}
+	// true when the instruction loads from memory, popping included
+	[[nodiscard]] constexpr auto reads_memory() const noexcept -> bool
+	{
+		if(mnemonic.starts_with("POP") or mnemonic.starts_with("RET")) return true;
+		// a store only names its destination between parentheses
+		if(mnemonic.starts_with("LD (") or mnemonic.starts_with("LDH (")) return false;
+		return mnemonic.find('(') != std::string_view::npos;
+	}
+};
+
+// clang-format off
+inline constexpr std::array<Opcode_info, 256> Opcode_table{{
+	{"NOP", 1, 1, 1, "----"}, // 0x00
+	{"LD BC,d16", 3, 3, 3, "----"}, // 0x01
+	{"LD (BC),A", 1, 2, 2, "----"}, // 0x02
+	{"INC BC", 1, 2, 2, "----"}, // 0x03
+	{"INC B", 1, 1, 1, "Z0H-"}, // 0x04
+	{"DEC B", 1, 1, 1, "Z1H-"}, // 0x05
+	{"LD B,d8", 2, 2, 2, "----"}, // 0x06
+	{"RLCA", 1, 1, 1, "000C"}, // 0x07
+	{"LD (a16),SP", 3, 5, 5, "----"}, // 0x08
+	{"ADD HL,BC", 1, 2, 2, "-0HC"}, // 0x09
+	{"LD A,(BC)", 1, 2, 2, "----"}, // 0x0A
+	{"DEC BC", 1, 2, 2, "----"}, // 0x0B
+	{"INC C", 1, 1, 1, "Z0H-"}, // 0x0C
+	{"DEC C", 1, 1, 1, "Z1H-"}, // 0x0D
+	{"LD C,d8", 2, 2, 2, "----"}, // 0x0E
+	{"RRCA", 1, 1, 1, "000C"}, // 0x0F
+	{"STOP", 2, 1, 1, "----"}, // 0x10
+	{"LD DE,d16", 3, 3, 3, "----"}, // 0x11
+	{"LD (DE),A", 1, 2, 2, "----"}, // 0x12
+	{"INC DE", 1, 2, 2, "----"}, // 0x13
+	{"INC D", 1, 1, 1, "Z0H-"}, // 0x14
+	{"DEC D", 1, 1, 1, "Z1H-"}, // 0x15
+	{"LD D,d8", 2, 2, 2, "----"}, // 0x16
+	{"RLA", 1, 1, 1, "000C"}, // 0x17
+	{"JR e8", 2, 3, 3, "----"}, // 0x18
+	{"ADD HL,DE", 1, 2, 2, "-0HC"}, // 0x19
+	{"LD A,(DE)", 1, 2, 2, "----"}, // 0x1A
+	{"DEC DE", 1, 2, 2, "----"}, // 0x1B
+	{"INC E", 1, 1, 1, "Z0H-"}, // 0x1C
+	{"DEC E", 1, 1, 1, "Z1H-"}, // 0x1D
+	{"LD E,d8", 2, 2, 2, "----"}, // 0x1E
+	{"RRA", 1, 1, 1, "000C"}, // 0x1F
+	{"JR NZ,e8", 2, 2, 3, "----"}, // 0x20
+	{"LD HL,d16", 3, 3, 3, "----"}, // 0x21
+	{"LD (HL+),A", 1, 2, 2, "----"}, // 0x22
+	{"INC HL", 1, 2, 2, "----"}, // 0x23
+	{"INC H", 1, 1, 1, "Z0H-"}, // 0x24
+	{"DEC H", 1, 1, 1, "Z1H-"}, // 0x25
+	{"LD H,d8", 2, 2, 2, "----"}, // 0x26
+	{"DAA", 1, 1, 1, "Z-0C"}, // 0x27
+	{"JR Z,e8", 2, 2, 3, "----"}, // 0x28
+	{"ADD HL,HL", 1, 2, 2, "-0HC"}, // 0x29
+	{"LD A,(HL+)", 1, 2, 2, "----"}, // 0x2A
+	{"DEC HL", 1, 2, 2, "----"}, // 0x2B
+	{"INC L", 1, 1, 1, "Z0H-"}, // 0x2C
+	{"DEC L", 1, 1, 1, "Z1H-"}, // 0x2D
+	{"LD L,d8", 2, 2, 2, "----"}, // 0x2E
+	{"CPL", 1, 1, 1, "-11-"}, // 0x2F
+	{"JR NC,e8", 2, 2, 3, "----"}, // 0x30
+	{"LD SP,d16", 3, 3, 3, "----"}, // 0x31
+	{"LD (HL-),A", 1, 2, 2, "----"}, // 0x32
+	{"INC SP", 1, 2, 2, "----"}, // 0x33
+	{"INC (HL)", 1, 3, 3, "Z0H-"}, // 0x34
+	{"DEC (HL)", 1, 3, 3, "Z1H-"}, // 0x35
+	{"LD (HL),d8", 2, 3, 3, "----"}, // 0x36
+	{"SCF", 1, 1, 1, "-001"}, // 0x37
+	{"JR C,e8", 2, 2, 3, "----"}, // 0x38
+	{"ADD HL,SP", 1, 2, 2, "-0HC"}, // 0x39
+	{"LD A,(HL-)", 1, 2, 2, "----"}, // 0x3A
+	{"DEC SP", 1, 2, 2, "----"}, // 0x3B
+	{"INC A", 1, 1, 1, "Z0H-"}, // 0x3C
+	{"DEC A", 1, 1, 1, "Z1H-"}, // 0x3D
+	{"LD A,d8", 2, 2, 2, "----"}, // 0x3E
+	{"CCF", 1, 1, 1, "-00C"}, // 0x3F
+	{"LD B,B", 1, 1, 1, "----"}, // 0x40
+	{"LD B,C", 1, 1, 1, "----"}, // 0x41
+	{"LD B,D", 1, 1, 1, "----"}, // 0x42
+	{"LD B,E", 1, 1, 1, "----"}, // 0x43
+	{"LD B,H", 1, 1, 1, "----"}, // 0x44
+	{"LD B,L", 1, 1, 1, "----"}, // 0x45
+	{"LD B,(HL)", 1, 2, 2, "----"}, // 0x46
+	{"LD B,A", 1, 1, 1, "----"}, // 0x47
+	{"LD C,B", 1, 1, 1, "----"}, // 0x48
+	{"LD C,C", 1, 1, 1, "----"}, // 0x49
+	{"LD C,D", 1, 1, 1, "----"}, // 0x4A
+	{"LD C,E", 1, 1, 1, "----"}, // 0x4B
+	{"LD C,H", 1, 1, 1, "----"}, // 0x4C
+	{"LD C,L", 1, 1, 1, "----"}, // 0x4D
+	{"LD C,(HL)", 1, 2, 2, "----"}, // 0x4E
+	{"LD C,A", 1, 1, 1, "----"}, // 0x4F
+	{"LD D,B", 1, 1, 1, "----"}, // 0x50
+	{"LD D,C", 1, 1, 1, "----"}, // 0x51
+	{"LD D,D", 1, 1, 1, "----"}, // 0x52
+	{"LD D,E", 1, 1, 1, "----"}, // 0x53
+	{"LD D,H", 1, 1, 1, "----"}, // 0x54
+	{"LD D,L", 1, 1, 1, "----"}, // 0x55
+	{"LD D,(HL)", 1, 2, 2, "----"}, // 0x56
+	{"LD D,A", 1, 1, 1, "----"}, // 0x57
+	{"LD E,B", 1, 1, 1, "----"}, // 0x58
+	{"LD E,C", 1, 1, 1, "----"}, // 0x59
+	{"LD E,D", 1, 1, 1, "----"}, // 0x5A
+	{"LD E,E", 1, 1, 1, "----"}, // 0x5B
+	{"LD E,H", 1, 1, 1, "----"}, // 0x5C
+	{"LD E,L", 1, 1, 1, "----"}, // 0x5D
+	{"LD E,(HL)", 1, 2, 2, "----"}, // 0x5E
+	{"LD E,A", 1, 1, 1, "----"}, // 0x5F
+	{"LD H,B", 1, 1, 1, "----"}, // 0x60
+	{"LD H,C", 1, 1, 1, "----"}, // 0x61
+	{"LD H,D", 1, 1, 1, "----"}, // 0x62
+	{"LD H,E", 1, 1, 1, "----"}, // 0x63
+	{"LD H,H", 1, 1, 1, "----"}, // 0x64
+	{"LD H,L", 1, 1, 1, "----"}, // 0x65
+	{"LD H,(HL)", 1, 2, 2, "----"}, // 0x66
+	{"LD H,A", 1, 1, 1, "----"}, // 0x67
+	{"LD L,B", 1, 1, 1, "----"}, // 0x68
+	{"LD L,C", 1, 1, 1, "----"}, // 0x69
+	{"LD L,D", 1, 1, 1, "----"}, // 0x6A
+	{"LD L,E", 1, 1, 1, "----"}, // 0x6B
+	{"LD L,H", 1, 1, 1, "----"}, // 0x6C
+	{"LD L,L", 1, 1, 1, "----"}, // 0x6D
+	{"LD L,(HL)", 1, 2, 2, "----"}, // 0x6E
+	{"LD L,A", 1, 1, 1, "----"}, // 0x6F
+	{"LD (HL),B", 1, 2, 2, "----"}, // 0x70
+	{"LD (HL),C", 1, 2, 2, "----"}, // 0x71
+	{"LD (HL),D", 1, 2, 2, "----"}, // 0x72
+	{"LD (HL),E", 1, 2, 2, "----"}, // 0x73
+	{"LD (HL),H", 1, 2, 2, "----"}, // 0x74
+	{"LD (HL),L", 1, 2, 2, "----"}, // 0x75
+	{"HALT", 1, 1, 1, "----"}, // 0x76
+	{"LD (HL),A", 1, 2, 2, "----"}, // 0x77
+	{"LD A,B", 1, 1, 1, "----"}, // 0x78
+	{"LD A,C", 1, 1, 1, "----"}, // 0x79
+	{"LD A,D", 1, 1, 1, "----"}, // 0x7A
+	{"LD A,E", 1, 1, 1, "----"}, // 0x7B
+	{"LD A,H", 1, 1, 1, "----"}, // 0x7C
+	{"LD A,L", 1, 1, 1, "----"}, // 0x7D
+	{"LD A,(HL)", 1, 2, 2, "----"}, // 0x7E
+	{"LD A,A", 1, 1, 1, "----"}, // 0x7F
+	{"ADD A,B", 1, 1, 1, "Z0HC"}, // 0x80
+	{"ADD A,C", 1, 1, 1, "Z0HC"}, // 0x81
+	{"ADD A,D", 1, 1, 1, "Z0HC"}, // 0x82
+	{"ADD A,E", 1, 1, 1, "Z0HC"}, // 0x83
+	{"ADD A,H", 1, 1, 1, "Z0HC"}, // 0x84
+	{"ADD A,L", 1, 1, 1, "Z0HC"}, // 0x85
+	{"ADD A,(HL)", 1, 2, 2, "Z0HC"}, // 0x86
+	{"ADD A,A", 1, 1, 1, "Z0HC"}, // 0x87
+	{"ADC A,B", 1, 1, 1, "Z0HC"}, // 0x88
+	{"ADC A,C", 1, 1, 1, "Z0HC"}, // 0x89
+	{"ADC A,D", 1, 1, 1, "Z0HC"}, // 0x8A
+	{"ADC A,E", 1, 1, 1, "Z0HC"}, // 0x8B
+	{"ADC A,H", 1, 1, 1, "Z0HC"}, // 0x8C
+	{"ADC A,L", 1, 1, 1, "Z0HC"}, // 0x8D
+	{"ADC A,(HL)", 1, 2, 2, "Z0HC"}, // 0x8E
+	{"ADC A,A", 1, 1, 1, "Z0HC"}, // 0x8F
+	{"SUB B", 1, 1, 1, "Z1HC"}, // 0x90
+	{"SUB C", 1, 1, 1, "Z1HC"}, // 0x91
+	{"SUB D", 1, 1, 1, "Z1HC"}, // 0x92
+	{"SUB E", 1, 1, 1, "Z1HC"}, // 0x93
+	{"SUB H", 1, 1, 1, "Z1HC"}, // 0x94
+	{"SUB L", 1, 1, 1, "Z1HC"}, // 0x95
+	{"SUB (HL)", 1, 2, 2, "Z1HC"}, // 0x96
+	{"SUB A", 1, 1, 1, "Z1HC"}, // 0x97
+	{"SBC A,B", 1, 1, 1, "Z1HC"}, // 0x98
+	{"SBC A,C", 1, 1, 1, "Z1HC"}, // 0x99
+	{"SBC A,D", 1, 1, 1, "Z1HC"}, // 0x9A
+	{"SBC A,E", 1, 1, 1, "Z1HC"}, // 0x9B
+	{"SBC A,H", 1, 1, 1, "Z1HC"}, // 0x9C
+	{"SBC A,L", 1, 1, 1, "Z1HC"}, // 0x9D
+	{"SBC A,(HL)", 1, 2, 2, "Z1HC"}, // 0x9E
+	{"SBC A,A", 1, 1, 1, "Z1HC"}, // 0x9F
+	{"AND B", 1, 1, 1, "Z010"}, // 0xA0
+	{"AND C", 1, 1, 1, "Z010"}, // 0xA1
+	{"AND D", 1, 1, 1, "Z010"}, // 0xA2
+	{"AND E", 1, 1, 1, "Z010"}, // 0xA3
+	{"AND H", 1, 1, 1, "Z010"}, // 0xA4
+	{"AND L", 1, 1, 1, "Z010"}, // 0xA5
+	{"AND (HL)", 1, 2, 2, "Z010"}, // 0xA6
+	{"AND A", 1, 1, 1, "Z010"}, // 0xA7
+	{"XOR B", 1, 1, 1, "Z000"}, // 0xA8
+	{"XOR C", 1, 1, 1, "Z000"}, // 0xA9
+	{"XOR D", 1, 1, 1, "Z000"}, // 0xAA
+	{"XOR E", 1, 1, 1, "Z000"}, // 0xAB
+	{"XOR H", 1, 1, 1, "Z000"}, // 0xAC
+	{"XOR L", 1, 1, 1, "Z000"}, // 0xAD
+	{"XOR (HL)", 1, 2, 2, "Z000"}, // 0xAE
+	{"XOR A", 1, 1, 1, "Z000"}, // 0xAF
+	{"OR B", 1, 1, 1, "Z000"}, // 0xB0
+	{"OR C", 1, 1, 1, "Z000"}, // 0xB1
+	{"OR D", 1, 1, 1, "Z000"}, // 0xB2
+	{"OR E", 1, 1, 1, "Z000"}, // 0xB3
+	{"OR H", 1, 1, 1, "Z000"}, // 0xB4
+	{"OR L", 1, 1, 1, "Z000"}, // 0xB5
+	{"OR (HL)", 1, 2, 2, "Z000"}, // 0xB6
+	{"OR A", 1, 1, 1, "Z000"}, // 0xB7
+	{"CP B", 1, 1, 1, "Z1HC"}, // 0xB8
+	{"CP C", 1, 1, 1, "Z1HC"}, // 0xB9
+	{"CP D", 1, 1, 1, "Z1HC"}, // 0xBA
+	{"CP E", 1, 1, 1, "Z1HC"}, // 0xBB
+	{"CP H", 1, 1, 1, "Z1HC"}, // 0xBC
+	{"CP L", 1, 1, 1, "Z1HC"}, // 0xBD
+	{"CP (HL)", 1, 2, 2, "Z1HC"}, // 0xBE
+	{"CP A", 1, 1, 1, "Z1HC"}, // 0xBF
+	{"RET NZ", 1, 2, 5, "----"}, // 0xC0
+	{"POP BC", 1, 3, 3, "----"}, // 0xC1
+	{"JP NZ,a16", 3, 3, 4, "----"}, // 0xC2
+	{"JP a16", 3, 4, 4, "----"}, // 0xC3
+	{"CALL NZ,a16", 3, 3, 6, "----"}, // 0xC4
+	{"PUSH BC", 1, 4, 4, "----"}, // 0xC5
+	{"ADD A,d8", 2, 2, 2, "Z0HC"}, // 0xC6
+	{"RST 00H", 1, 4, 4, "----"}, // 0xC7
+	{"RET Z", 1, 2, 5, "----"}, // 0xC8
+	{"RET", 1, 4, 4, "----"}, // 0xC9
+	{"JP Z,a16", 3, 3, 4, "----"}, // 0xCA
+	{"PREFIX CB", 2, 2, 2, "----"}, // 0xCB
+	{"CALL Z,a16", 3, 3, 6, "----"}, // 0xCC
+	{"CALL a16", 3, 6, 6, "----"}, // 0xCD
+	{"ADC A,d8", 2, 2, 2, "Z0HC"}, // 0xCE
+	{"RST 08H", 1, 4, 4, "----"}, // 0xCF
+	{"RET NC", 1, 2, 5, "----"}, // 0xD0
+	{"POP DE", 1, 3, 3, "----"}, // 0xD1
+	{"JP NC,a16", 3, 3, 4, "----"}, // 0xD2
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xD3
+	{"CALL NC,a16", 3, 3, 6, "----"}, // 0xD4
+	{"PUSH DE", 1, 4, 4, "----"}, // 0xD5
+	{"SUB d8", 2, 2, 2, "Z1HC"}, // 0xD6
+	{"RST 10H", 1, 4, 4, "----"}, // 0xD7
+	{"RET C", 1, 2, 5, "----"}, // 0xD8
+	{"RETI", 1, 4, 4, "----"}, // 0xD9
+	{"JP C,a16", 3, 3, 4, "----"}, // 0xDA
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xDB
+	{"CALL C,a16", 3, 3, 6, "----"}, // 0xDC
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xDD
+	{"SBC A,d8", 2, 2, 2, "Z1HC"}, // 0xDE
+	{"RST 18H", 1, 4, 4, "----"}, // 0xDF
+	{"LDH (a8),A", 2, 3, 3, "----"}, // 0xE0
+	{"POP HL", 1, 3, 3, "----"}, // 0xE1
+	{"LD (C),A", 1, 2, 2, "----"}, // 0xE2
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xE3
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xE4
+	{"PUSH HL", 1, 4, 4, "----"}, // 0xE5
+	{"AND d8", 2, 2, 2, "Z010"}, // 0xE6
+	{"RST 20H", 1, 4, 4, "----"}, // 0xE7
+	{"ADD SP,e8", 2, 4, 4, "00HC"}, // 0xE8
+	{"JP HL", 1, 1, 1, "----"}, // 0xE9
+	{"LD (a16),A", 3, 4, 4, "----"}, // 0xEA
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xEB
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xEC
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xED
+	{"XOR d8", 2, 2, 2, "Z000"}, // 0xEE
+	{"RST 28H", 1, 4, 4, "----"}, // 0xEF
+	{"LDH A,(a8)", 2, 3, 3, "----"}, // 0xF0
+	{"POP AF", 1, 3, 3, "ZNHC"}, // 0xF1
+	{"LD A,(C)", 1, 2, 2, "----"}, // 0xF2
+	{"DI", 1, 1, 1, "----"}, // 0xF3
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xF4
+	{"PUSH AF", 1, 4, 4, "----"}, // 0xF5
+	{"OR d8", 2, 2, 2, "Z000"}, // 0xF6
+	{"RST 30H", 1, 4, 4, "----"}, // 0xF7
+	{"LD HL,SP+e8", 2, 3, 3, "00HC"}, // 0xF8
+	{"LD SP,HL", 1, 2, 2, "----"}, // 0xF9
+	{"LD A,(a16)", 3, 4, 4, "----"}, // 0xFA
+	{"EI", 1, 1, 1, "----"}, // 0xFB
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xFC
+	{"ILLEGAL", 1, 1, 1, "----"}, // 0xFD
+	{"CP d8", 2, 2, 2, "Z1HC"}, // 0xFE
+	{"RST 38H", 1, 4, 4, "----"}, // 0xFF
+}};
+
+// opcodes following the 0xCB prefix, the prefix is included in length and cycles
+inline constexpr std::array<Opcode_info, 256> Extended_table{{
+	{"RLC B", 2, 2, 2, "Z00C"}, // 0x00
+	{"RLC C", 2, 2, 2, "Z00C"}, // 0x01
+	{"RLC D", 2, 2, 2, "Z00C"}, // 0x02
+	{"RLC E", 2, 2, 2, "Z00C"}, // 0x03
+	{"RLC H", 2, 2, 2, "Z00C"}, // 0x04
+	{"RLC L", 2, 2, 2, "Z00C"}, // 0x05
+	{"RLC (HL)", 2, 4, 4, "Z00C"}, // 0x06
+	{"RLC A", 2, 2, 2, "Z00C"}, // 0x07
+	{"RRC B", 2, 2, 2, "Z00C"}, // 0x08
+	{"RRC C", 2, 2, 2, "Z00C"}, // 0x09
+	{"RRC D", 2, 2, 2, "Z00C"}, // 0x0A
+	{"RRC E", 2, 2, 2, "Z00C"}, // 0x0B
+	{"RRC H", 2, 2, 2, "Z00C"}, // 0x0C
+	{"RRC L", 2, 2, 2, "Z00C"}, // 0x0D
+	{"RRC (HL)", 2, 4, 4, "Z00C"}, // 0x0E
+	{"RRC A", 2, 2, 2, "Z00C"}, // 0x0F
+	{"RL B", 2, 2, 2, "Z00C"}, // 0x10
+	{"RL C", 2, 2, 2, "Z00C"}, // 0x11
+	{"RL D", 2, 2, 2, "Z00C"}, // 0x12
+	{"RL E", 2, 2, 2, "Z00C"}, // 0x13
+	{"RL H", 2, 2, 2, "Z00C"}, // 0x14
+	{"RL L", 2, 2, 2, "Z00C"}, // 0x15
+	{"RL (HL)", 2, 4, 4, "Z00C"}, // 0x16
+	{"RL A", 2, 2, 2, "Z00C"}, // 0x17
+	{"RR B", 2, 2, 2, "Z00C"}, // 0x18
+	{"RR C", 2, 2, 2, "Z00C"}, // 0x19
+	{"RR D", 2, 2, 2, "Z00C"}, // 0x1A
+	{"RR E", 2, 2, 2, "Z00C"}, // 0x1B
+	{"RR H", 2, 2, 2, "Z00C"}, // 0x1C
+	{"RR L", 2, 2, 2, "Z00C"}, // 0x1D
+	{"RR (HL)", 2, 4, 4, "Z00C"}, // 0x1E
+	{"RR A", 2, 2, 2, "Z00C"}, // 0x1F
+	{"SLA B", 2, 2, 2, "Z00C"}, // 0x20
+	{"SLA C", 2, 2, 2, "Z00C"}, // 0x21
+	{"SLA D", 2, 2, 2, "Z00C"}, // 0x22
+	{"SLA E", 2, 2, 2, "Z00C"}, // 0x23
+	{"SLA H", 2, 2, 2, "Z00C"}, // 0x24
+	{"SLA L", 2, 2, 2, "Z00C"}, // 0x25
+	{"SLA (HL)", 2, 4, 4, "Z00C"}, // 0x26
+	{"SLA A", 2, 2, 2, "Z00C"}, // 0x27
+	{"SRA B", 2, 2, 2, "Z00C"}, // 0x28
+	{"SRA C", 2, 2, 2, "Z00C"}, // 0x29
+	{"SRA D", 2, 2, 2, "Z00C"}, // 0x2A
+	{"SRA E", 2, 2, 2, "Z00C"}, // 0x2B
+	{"SRA H", 2, 2, 2, "Z00C"}, // 0x2C
+	{"SRA L", 2, 2, 2, "Z00C"}, // 0x2D
+	{"SRA (HL)", 2, 4, 4, "Z00C"}, // 0x2E
+	{"SRA A", 2, 2, 2, "Z00C"}, // 0x2F
+	{"SWAP B", 2, 2, 2, "Z000"}, // 0x30
+	{"SWAP C", 2, 2, 2, "Z000"}, // 0x31
+	{"SWAP D", 2, 2, 2, "Z000"}, // 0x32
+	{"SWAP E", 2, 2, 2, "Z000"}, // 0x33
+	{"SWAP H", 2, 2, 2, "Z000"}, // 0x34
+	{"SWAP L", 2, 2, 2, "Z000"}, // 0x35
+	{"SWAP (HL)", 2, 4, 4, "Z000"}, // 0x36
+	{"SWAP A", 2, 2, 2, "Z000"}, // 0x37
+	{"SRL B", 2, 2, 2, "Z00C"}, // 0x38
+	{"SRL C", 2, 2, 2, "Z00C"}, // 0x39
+	{"SRL D", 2, 2, 2, "Z00C"}, // 0x3A
+	{"SRL E", 2, 2, 2, "Z00C"}, // 0x3B
+	{"SRL H", 2, 2, 2, "Z00C"}, // 0x3C
+	{"SRL L", 2, 2, 2, "Z00C"}, // 0x3D
+	{"SRL (HL)", 2, 4, 4, "Z00C"}, // 0x3E
+	{"SRL A", 2, 2, 2, "Z00C"}, // 0x3F
+	{"BIT 0,B", 2, 2, 2, "Z01-"}, // 0x40
+	{"BIT 0,C", 2, 2, 2, "Z01-"}, // 0x41
+	{"BIT 0,D", 2, 2, 2, "Z01-"}, // 0x42
+	{"BIT 0,E", 2, 2, 2, "Z01-"}, // 0x43
+	{"BIT 0,H", 2, 2, 2, "Z01-"}, // 0x44
+	{"BIT 0,L", 2, 2, 2, "Z01-"}, // 0x45
+	{"BIT 0,(HL)", 2, 3, 3, "Z01-"}, // 0x46
+	{"BIT 0,A", 2, 2, 2, "Z01-"}, // 0x47
+	{"BIT 1,B", 2, 2, 2, "Z01-"}, // 0x48
+	{"BIT 1,C", 2, 2, 2, "Z01-"}, // 0x49
+	{"BIT 1,D", 2, 2, 2, "Z01-"}, // 0x4A
+	{"BIT 1,E", 2, 2, 2, "Z01-"}, // 0x4B
+	{"BIT 1,H", 2, 2, 2, "Z01-"}, // 0x4C
+	{"BIT 1,L", 2, 2, 2, "Z01-"}, // 0x4D
+	{"BIT 1,(HL)", 2, 3, 3, "Z01-"}, // 0x4E
+	{"BIT 1,A", 2, 2, 2, "Z01-"}, // 0x4F
+	{"BIT 2,B", 2, 2, 2, "Z01-"}, // 0x50
+	{"BIT 2,C", 2, 2, 2, "Z01-"}, // 0x51
+	{"BIT 2,D", 2, 2, 2, "Z01-"}, // 0x52
+	{"BIT 2,E", 2, 2, 2, "Z01-"}, // 0x53
+	{"BIT 2,H", 2, 2, 2, "Z01-"}, // 0x54
+	{"BIT 2,L", 2, 2, 2, "Z01-"}, // 0x55
+	{"BIT 2,(HL)", 2, 3, 3, "Z01-"}, // 0x56
+	{"BIT 2,A", 2, 2, 2, "Z01-"}, // 0x57
+	{"BIT 3,B", 2, 2, 2, "Z01-"}, // 0x58
+	{"BIT 3,C", 2, 2, 2, "Z01-"}, // 0x59
+	{"BIT 3,D", 2, 2, 2, "Z01-"}, // 0x5A
+	{"BIT 3,E", 2, 2, 2, "Z01-"}, // 0x5B
+	{"BIT 3,H", 2, 2, 2, "Z01-"}, // 0x5C
+	{"BIT 3,L", 2, 2, 2, "Z01-"}, // 0x5D
+	{"BIT 3,(HL)", 2, 3, 3, "Z01-"}, // 0x5E
+	{"BIT 3,A", 2, 2, 2, "Z01-"}, // 0x5F
+	{"BIT 4,B", 2, 2, 2, "Z01-"}, // 0x60
+	{"BIT 4,C", 2, 2, 2, "Z01-"}, // 0x61
+	{"BIT 4,D", 2, 2, 2, "Z01-"}, // 0x62
+	{"BIT 4,E", 2, 2, 2, "Z01-"}, // 0x63
+	{"BIT 4,H", 2, 2, 2, "Z01-"}, // 0x64
+	{"BIT 4,L", 2, 2, 2, "Z01-"}, // 0x65
+	{"BIT 4,(HL)", 2, 3, 3, "Z01-"}, // 0x66
+	{"BIT 4,A", 2, 2, 2, "Z01-"}, // 0x67
+	{"BIT 5,B", 2, 2, 2, "Z01-"}, // 0x68
+	{"BIT 5,C", 2, 2, 2, "Z01-"}, // 0x69
+	{"BIT 5,D", 2, 2, 2, "Z01-"}, // 0x6A
+	{"BIT 5,E", 2, 2, 2, "Z01-"}, // 0x6B
+	{"BIT 5,H", 2, 2, 2, "Z01-"}, // 0x6C
+	{"BIT 5,L", 2, 2, 2, "Z01-"}, // 0x6D
+	{"BIT 5,(HL)", 2, 3, 3, "Z01-"}, // 0x6E
+	{"BIT 5,A", 2, 2, 2, "Z01-"}, // 0x6F
+	{"BIT 6,B", 2, 2, 2, "Z01-"}, // 0x70
+	{"BIT 6,C", 2, 2, 2, "Z01-"}, // 0x71
+	{"BIT 6,D", 2, 2, 2, "Z01-"}, // 0x72
+	{"BIT 6,E", 2, 2, 2, "Z01-"}, // 0x73
+	{"BIT 6,H", 2, 2, 2, "Z01-"}, // 0x74
+	{"BIT 6,L", 2, 2, 2, "Z01-"}, // 0x75
+	{"BIT 6,(HL)", 2, 3, 3, "Z01-"}, // 0x76
+	{"BIT 6,A", 2, 2, 2, "Z01-"}, // 0x77
+	{"BIT 7,B", 2, 2, 2, "Z01-"}, // 0x78
+	{"BIT 7,C", 2, 2, 2, "Z01-"}, // 0x79
+	{"BIT 7,D", 2, 2, 2, "Z01-"}, // 0x7A
+	{"BIT 7,E", 2, 2, 2, "Z01-"}, // 0x7B
+	{"BIT 7,H", 2, 2, 2, "Z01-"}, // 0x7C
+	{"BIT 7,L", 2, 2, 2, "Z01-"}, // 0x7D
+	{"BIT 7,(HL)", 2, 3, 3, "Z01-"}, // 0x7E
+	{"BIT 7,A", 2, 2, 2, "Z01-"}, // 0x7F
+	{"RES 0,B", 2, 2, 2, "----"}, // 0x80
+	{"RES 0,C", 2, 2, 2, "----"}, // 0x81
+	{"RES 0,D", 2, 2, 2, "----"}, // 0x82
+	{"RES 0,E", 2, 2, 2, "----"}, // 0x83
+	{"RES 0,H", 2, 2, 2, "----"}, // 0x84
+	{"RES 0,L", 2, 2, 2, "----"}, // 0x85
+	{"RES 0,(HL)", 2, 4, 4, "----"}, // 0x86
+	{"RES 0,A", 2, 2, 2, "----"}, // 0x87
+	{"RES 1,B", 2, 2, 2, "----"}, // 0x88
+	{"RES 1,C", 2, 2, 2, "----"}, // 0x89
+	{"RES 1,D", 2, 2, 2, "----"}, // 0x8A
+	{"RES 1,E", 2, 2, 2, "----"}, // 0x8B
+	{"RES 1,H", 2, 2, 2, "----"}, // 0x8C
+	{"RES 1,L", 2, 2, 2, "----"}, // 0x8D
+	{"RES 1,(HL)", 2, 4, 4, "----"}, // 0x8E
+	{"RES 1,A", 2, 2, 2, "----"}, // 0x8F
+	{"RES 2,B", 2, 2, 2, "----"}, // 0x90
+	{"RES 2,C", 2, 2, 2, "----"}, // 0x91
+	{"RES 2,D", 2, 2, 2, "----"}, // 0x92
+	{"RES 2,E", 2, 2, 2, "----"}, // 0x93
+	{"RES 2,H", 2, 2, 2, "----"}, // 0x94
+	{"RES 2,L", 2, 2, 2, "----"}, // 0x95
+	{"RES 2,(HL)", 2, 4, 4, "----"}, // 0x96
+	{"RES 2,A", 2, 2, 2, "----"}, // 0x97
+	{"RES 3,B", 2, 2, 2, "----"}, // 0x98
+	{"RES 3,C", 2, 2, 2, "----"}, // 0x99
+	{"RES 3,D", 2, 2, 2, "----"}, // 0x9A
+	{"RES 3,E", 2, 2, 2, "----"}, // 0x9B
+	{"RES 3,H", 2, 2, 2, "----"}, // 0x9C
+	{"RES 3,L", 2, 2, 2, "----"}, // 0x9D
+	{"RES 3,(HL)", 2, 4, 4, "----"}, // 0x9E
+	{"RES 3,A", 2, 2, 2, "----"}, // 0x9F
+	{"RES 4,B", 2, 2, 2, "----"}, // 0xA0
+	{"RES 4,C", 2, 2, 2, "----"}, // 0xA1
+	{"RES 4,D", 2, 2, 2, "----"}, // 0xA2
+	{"RES 4,E", 2, 2, 2, "----"}, // 0xA3
+	{"RES 4,H", 2, 2, 2, "----"}, // 0xA4
+	{"RES 4,L", 2, 2, 2, "----"}, // 0xA5
+	{"RES 4,(HL)", 2, 4, 4, "----"}, // 0xA6
+	{"RES 4,A", 2, 2, 2, "----"}, // 0xA7
+	{"RES 5,B", 2, 2, 2, "----"}, // 0xA8
+	{"RES 5,C", 2, 2, 2, "----"}, // 0xA9
+	{"RES 5,D", 2, 2, 2, "----"}, // 0xAA
+	{"RES 5,E", 2, 2, 2, "----"}, // 0xAB
+	{"RES 5,H", 2, 2, 2, "----"}, // 0xAC
+	{"RES 5,L", 2, 2, 2, "----"}, // 0xAD
+	{"RES 5,(HL)", 2, 4, 4, "----"}, // 0xAE
+	{"RES 5,A", 2, 2, 2, "----"}, // 0xAF
+	{"RES 6,B", 2, 2, 2, "----"}, // 0xB0
+	{"RES 6,C", 2, 2, 2, "----"}, // 0xB1
+	{"RES 6,D", 2, 2, 2, "----"}, // 0xB2
+	{"RES 6,E", 2, 2, 2, "----"}, // 0xB3
+	{"RES 6,H", 2, 2, 2, "----"}, // 0xB4
+	{"RES 6,L", 2, 2, 2, "----"}, // 0xB5
+	{"RES 6,(HL)", 2, 4, 4, "----"}, // 0xB6
+	{"RES 6,A", 2, 2, 2, "----"}, // 0xB7
+	{"RES 7,B", 2, 2, 2, "----"}, // 0xB8
+	{"RES 7,C", 2, 2, 2, "----"}, // 0xB9
+	{"RES 7,D", 2, 2, 2, "----"}, // 0xBA
+	{"RES 7,E", 2, 2, 2, "----"}, // 0xBB
+	{"RES 7,H", 2, 2, 2, "----"}, // 0xBC
+	{"RES 7,L", 2, 2, 2, "----"}, // 0xBD
+	{"RES 7,(HL)", 2, 4, 4, "----"}, // 0xBE
+	{"RES 7,A", 2, 2, 2, "----"}, // 0xBF
+	{"SET 0,B", 2, 2, 2, "----"}, // 0xC0
+	{"SET 0,C", 2, 2, 2, "----"}, // 0xC1
+	{"SET 0,D", 2, 2, 2, "----"}, // 0xC2
+	{"SET 0,E", 2, 2, 2, "----"}, // 0xC3
+	{"SET 0,H", 2, 2, 2, "----"}, // 0xC4
+	{"SET 0,L", 2, 2, 2, "----"}, // 0xC5
+	{"SET 0,(HL)", 2, 4, 4, "----"}, // 0xC6
+	{"SET 0,A", 2, 2, 2, "----"}, // 0xC7
+	{"SET 1,B", 2, 2, 2, "----"}, // 0xC8
+	{"SET 1,C", 2, 2, 2, "----"}, // 0xC9
+	{"SET 1,D", 2, 2, 2, "----"}, // 0xCA
+	{"SET 1,E", 2, 2, 2, "----"}, // 0xCB
+	{"SET 1,H", 2, 2, 2, "----"}, // 0xCC
+	{"SET 1,L", 2, 2, 2, "----"}, // 0xCD
+	{"SET 1,(HL)", 2, 4, 4, "----"}, // 0xCE
+	{"SET 1,A", 2, 2, 2, "----"}, // 0xCF
+	{"SET 2,B", 2, 2, 2, "----"}, // 0xD0
+	{"SET 2,C", 2, 2, 2, "----"}, // 0xD1
+	{"SET 2,D", 2, 2, 2, "----"}, // 0xD2
+	{"SET 2,E", 2, 2, 2, "----"}, // 0xD3
+	{"SET 2,H", 2, 2, 2, "----"}, // 0xD4
+	{"SET 2,L", 2, 2, 2, "----"}, // 0xD5
+	{"SET 2,(HL)", 2, 4, 4, "----"}, // 0xD6
+	{"SET 2,A", 2, 2, 2, "----"}, // 0xD7
+	{"SET 3,B", 2, 2, 2, "----"}, // 0xD8
+	{"SET 3,C", 2, 2, 2, "----"}, // 0xD9
+	{"SET 3,D", 2, 2, 2, "----"}, // 0xDA
+	{"SET 3,E", 2, 2, 2, "----"}, // 0xDB
+	{"SET 3,H", 2, 2, 2, "----"}, // 0xDC
+	{"SET 3,L", 2, 2, 2, "----"}, // 0xDD
+	{"SET 3,(HL)", 2, 4, 4, "----"}, // 0xDE
+	{"SET 3,A", 2, 2, 2, "----"}, // 0xDF
+	{"SET 4,B", 2, 2, 2, "----"}, // 0xE0
+	{"SET 4,C", 2, 2, 2, "----"}, // 0xE1
+	{"SET 4,D", 2, 2, 2, "----"}, // 0xE2
+	{"SET 4,E", 2, 2, 2, "----"}, // 0xE3
+	{"SET 4,H", 2, 2, 2, "----"}, // 0xE4
+	{"SET 4,L", 2, 2, 2, "----"}, // 0xE5
+	{"SET 4,(HL)", 2, 4, 4, "----"}, // 0xE6
+	{"SET 4,A", 2, 2, 2, "----"}, // 0xE7
+	{"SET 5,B", 2, 2, 2, "----"}, // 0xE8
+	{"SET 5,C", 2, 2, 2, "----"}, // 0xE9
+	{"SET 5,D", 2, 2, 2, "----"}, // 0xEA
+	{"SET 5,E", 2, 2, 2, "----"}, // 0xEB
+	{"SET 5,H", 2, 2, 2, "----"}, // 0xEC
+	{"SET 5,L", 2, 2, 2, "----"}, // 0xED
+	{"SET 5,(HL)", 2, 4, 4, "----"}, // 0xEE
+	{"SET 5,A", 2, 2, 2, "----"}, // 0xEF
+	{"SET 6,B", 2, 2, 2, "----"}, // 0xF0
+	{"SET 6,C", 2, 2, 2, "----"}, // 0xF1
+	{"SET 6,D", 2, 2, 2, "----"}, // 0xF2
+	{"SET 6,E", 2, 2, 2, "----"}, // 0xF3
+	{"SET 6,H", 2, 2, 2, "----"}, // 0xF4
+	{"SET 6,L", 2, 2, 2, "----"}, // 0xF5
+	{"SET 6,(HL)", 2, 4, 4, "----"}, // 0xF6
+	{"SET 6,A", 2, 2, 2, "----"}, // 0xF7
+	{"SET 7,B", 2, 2, 2, "----"}, // 0xF8
+	{"SET 7,C", 2, 2, 2, "----"}, // 0xF9
+	{"SET 7,D", 2, 2, 2, "----"}, // 0xFA
+	{"SET 7,E", 2, 2, 2, "----"}, // 0xFB
+	{"SET 7,H", 2, 2, 2, "----"}, // 0xFC
+	{"SET 7,L", 2, 2, 2, "----"}, // 0xFD
+	{"SET 7,(HL)", 2, 4, 4, "----"}, // 0xFE
+	{"SET 7,A", 2, 2, 2, "----"}, // 0xFF
+}};
+// clang-format on
+
+// the properties the decoder needs, computed once: no string comparison at run time
+enum Property : std::uint8_t {
+	Changes_flow = 0b001,
+	Writes_memory = 0b010,
+	Reads_memory = 0b100
+};
+constexpr auto properties(const std::array<Opcode_info, 256> &table) noexcept
+    -> std::array<std::uint8_t, 256>
+{
+	std::array<std::uint8_t, 256> result{};
+	for(std::size_t i = 0; i < table.size(); ++i) {
+		if(table[i].changes_flow()) result[i] |= Changes_flow;
+		if(table[i].writes_memory()) result[i] |= Writes_memory;
+		if(table[i].reads_memory()) result[i] |= Reads_memory;
+	}
+	return result;
+}
+inline constexpr auto Opcode_properties = properties(Opcode_table);
+inline constexpr auto Extended_properties = properties(Extended_table);
+
+} // namespace ISA
+#endif
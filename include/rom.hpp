@@ -0,0 +1,65 @@
+#ifndef __ROM_HPP__
+#define __ROM_HPP__
+#include "include_std.hpp"
+#include "units.hpp"
+
+#include <filesystem>
+#include <span>
+
+// how Rom_image::map sets the mapping up
+struct Rom_hints {
+	// fault every page in at mapping time
+	bool populate = false;
+	// ask for transparent huge pages, when the file system supports it
+	bool huge_pages = false;
+};
+
+/*
+ *  The cartridge ROM as the controllers see it. A file is mapped read only
+ *  (MAP_PRIVATE): nothing is copied at startup, pages are faulted in when a
+ *  bank is first read and are shared with every process mapping the same
+ *  file. A program given in memory is kept in a vector.
+ *
+ *  The image always holds whole banks: its size is a power of two of 32kB
+ *  at least, files of another size are copied and padded with zeros. The
+ *  controllers never write there, ROM writes are their registers.
+ */
+class Rom_image {
+  public:
+	static constexpr std::size_t Min_size = 32_kB;
+
+	// implicit, a program is a ROM
+	Rom_image(std::vector<std::uint8_t> program);
+	// throw std::system_error when the file cannot be read
+	[[nodiscard]] static auto map(const std::filesystem::path &path, Rom_hints hints = {})
+	    -> Rom_image;
+
+	Rom_image(const Rom_image &) = delete;
+	auto operator=(const Rom_image &) -> Rom_image & = delete;
+	Rom_image(Rom_image &&other) noexcept;
+	auto operator=(Rom_image &&other) noexcept -> Rom_image &;
+	~Rom_image();
+
+	[[nodiscard]] auto bytes() const noexcept -> std::span<std::uint8_t>
+	{
+		return {m_data, m_size};
+	}
+	[[nodiscard]] auto size() const noexcept -> std::size_t { return m_size; }
+	// false when the bytes live in a copy
+	[[nodiscard]] auto mapped() const noexcept -> bool { return m_mapped; }
+	[[nodiscard]] auto operator[](std::size_t idx) const noexcept -> std::uint8_t
+	{
+		return m_data[idx];
+	}
+
+  private:
+	Rom_image() = default;
+	static auto padded_size(std::size_t size) noexcept -> std::size_t;
+
+	std::vector<std::uint8_t> m_copy;
+	std::uint8_t *m_data = nullptr;
+	std::size_t m_size = 0;
+	bool m_mapped = false;
+};
+
+#endif
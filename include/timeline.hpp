@@ -0,0 +1,161 @@
+#ifndef __TIMELINE_HPP__
+#define __TIMELINE_HPP__
+#include "include_std.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#ifdef TRACE_TIMELINE
+#define TIMELINE_TRACE(...) (std::clog << __VA_ARGS__ << '\n')
+#else
+#define TIMELINE_TRACE(...) ((void)0)
+#endif
+
+/*
+ *  Virtual time of the emulator, counted in master cycles.
+ *
+ *  Events due within Slots cycles are linked in a timing wheel, one bucket
+ *  per cycle, with a bitmap of the buckets in use: scheduling is O(1) and
+ *  reaching the next cycle costs O(1 + number woken) whatever the number of
+ *  domains waiting. Later events wait in a binary heap until their cycle
+ *  comes. The events live in the awaiters, nothing is allocated.
+ *
+ *  Advancing the time never involves the kernel: wall-clock pacing is done
+ *  elsewhere, once per frame. Build with TRACE_TIMELINE (make TRACE=1) to
+ *  log the cycles where something is resumed.
+ */
+class Timeline {
+  public:
+	using Cycle = std::uint64_t;
+	static constexpr Cycle Never = std::numeric_limits<Cycle>::max();
+	static constexpr std::size_t Slots = 256;
+
+	// a suspended coroutine, owned by its awaiter
+	struct Event {
+		Cycle when;
+		std::coroutine_handle<> handle;
+		Event *next = nullptr;
+		std::uint64_t order = 0;
+	};
+
+	Timeline() = default;
+	Timeline(const Timeline &) = delete;
+	auto operator=(const Timeline &) -> Timeline & = delete;
+
+	[[nodiscard]] auto now() const noexcept -> Cycle { return m_now; }
+	[[nodiscard]] auto pending() const noexcept -> std::size_t
+	{
+		return m_wheel_events + m_far.size();
+	}
+	// cycle of the earliest event
+	[[nodiscard]] auto next() const noexcept -> Cycle
+	{
+		const auto far = (m_far.empty()) ? Never : m_far.front()->when;
+		return std::min(next_in_wheel(), far);
+	}
+
+	// the cycle advance_to is running to: nothing outside of the timeline
+	// runs before it, a domain waiting for another one can sleep until
+	// min(next(), horizon())
+	[[nodiscard]] auto horizon() const noexcept -> Cycle { return m_horizon; }
+
+	// resume the event once the time reaches its cycle, events due at the
+	// same cycle are resumed in the order they were scheduled
+	auto schedule(Event &event) -> void
+	{
+		event.when = std::max(event.when, m_now);
+		if(event.when - m_now >= Slots) [[unlikely]] {
+			schedule_far(event);
+			return;
+		}
+		const auto slot = event.when % Slots;
+		auto &bucket = m_wheel[slot];
+		event.next = nullptr;
+		if(bucket.head == nullptr) {
+			bucket.head = &event;
+			m_used[slot / 64] |= std::uint64_t{1} << (slot % 64);
+		}
+		else {
+			bucket.tail->next = &event;
+		}
+		bucket.tail = &event;
+		++m_wheel_events;
+	}
+	// run every event up to limit included, the time is then limit
+	auto advance_to(Cycle limit) -> void
+	{
+		m_horizon = limit;
+		for(auto when = next(); when <= limit; when = next()) {
+			m_now = when;
+			TIMELINE_TRACE("timeline: cycle " << when);
+			// scheduled while this cycle was out of the wheel, so first
+			while(not m_far.empty() and m_far.front()->when == when) [[unlikely]] {
+				std::pop_heap(std::begin(m_far), std::end(m_far), later);
+				const auto handle = m_far.back()->handle;
+				m_far.pop_back();
+				handle.resume();
+			}
+			// the awaiter is gone once resumed, and may schedule on this cycle
+			const auto slot = when % Slots;
+			auto &bucket = m_wheel[slot];
+			while(bucket.head != nullptr) {
+				const auto handle = bucket.head->handle;
+				bucket.head = bucket.head->next;
+				--m_wheel_events;
+				handle.resume();
+			}
+			m_used[slot / 64] &= ~(std::uint64_t{1} << (slot % 64));
+		}
+		m_now = std::max(m_now, limit);
+	}
+	auto advance(Cycle cycles) -> void { advance_to(m_now + cycles); }
+
+  private:
+	// out of line so that schedule() stays small in the awaiters
+	[[gnu::noinline]] auto schedule_far(Event &event) -> void
+	{
+		event.order = m_order++;
+		m_far.push_back(&event);
+		std::push_heap(std::begin(m_far), std::end(m_far), later);
+	}
+	struct Bucket {
+		Event *head = nullptr;
+		Event *tail = nullptr;
+	};
+	static auto later(const Event *lhs, const Event *rhs) noexcept -> bool
+	{
+		if(lhs->when != rhs->when) return lhs->when > rhs->when;
+		return lhs->order > rhs->order;
+	}
+	// first bucket in use from the current cycle, wrapping around
+	auto next_in_wheel() const noexcept -> Cycle
+	{
+		if(m_wheel_events == 0) return Never;
+		const auto start = m_now % Slots;
+		const auto first = start / 64;
+		// usually in the same word
+		const auto bits = m_used[first] & (~std::uint64_t{0} << (start % 64));
+		if(bits != 0) {
+			return m_now + (first * 64 + std::countr_zero(bits) - start);
+		}
+		for(std::size_t step = 1; step <= m_used.size(); ++step) {
+			const auto word = (first + step) % m_used.size();
+			if(m_used[word] != 0) {
+				const auto slot = word * 64 + std::countr_zero(m_used[word]);
+				return m_now + (slot + Slots - start) % Slots;
+			}
+		}
+		return Never;
+	}
+
+	Cycle m_now = 0;
+	Cycle m_horizon = 0;
+	std::uint64_t m_order = 0;
+	std::array<Bucket, Slots> m_wheel{};
+	std::array<std::uint64_t, Slots / 64> m_used{};
+	std::size_t m_wheel_events = 0;
+	std::vector<Event *> m_far;
+};
+
+#endif
@@ -4,55 +4,78 @@ auto Clock_domain::operator co_await() const noexcept -> Clock_domain::Awaiter
 {
 	return Awaiter{*this};
 }
-auto Clock_domain::notify_edge() const -> void
+auto Clock_domain::cycles(int n) const noexcept -> Clock_domain::Awaiter
 {
-	if(_edge_awaiter.size() == 0) {
-		return;
-	}
-	for(auto it : _edge_awaiter) {
-		(*it)._cycle--;
-	}
-	auto end_it = std::partition(std::begin(_edge_awaiter), std::end(_edge_awaiter),
-	                             [](const auto elt) { return (*elt).get_cycle() == 0; });
-
-	if((_edge_awaiter[0])->get_cycle() == 0) {
-		std::cout << "Notifying Edge" << std::endl;
-		auto resume_awaiter = std::span(std::begin(_edge_awaiter), end_it);
-		for(const auto it : resume_awaiter) {
-			it->coroutineHandle.resume();
-		}
-		_edge_awaiter.erase(std::begin(_edge_awaiter),
-		                    std::begin(_edge_awaiter) + resume_awaiter.size());
-	}
+	return Awaiter{*this, n};
 }
 
-Clock_domain::Poll_timer::Poll_timer(double usec) noexcept
+auto Clock_domain::until(Timeline::Cycle when) const noexcept -> Clock_domain::Awaiter
 {
-	_clock_fd = timerfd_create(CLOCK_REALTIME, 0);
-	if(_clock_fd == -1) {
-		std::terminate();
-	}
-	_timerValue.it_value.tv_sec = 0;
-	_timerValue.it_value.tv_nsec = usec;
-	_timerValue.it_interval.tv_sec = 0;
-	_timerValue.it_interval.tv_nsec = usec;
-	start_timer();
+	const Timeline::Cycle mask = _divider - 1;
+	const auto edge = (_timeline.now() + mask) & ~mask;
+	const auto cycles = (when > edge) ? (when - edge + mask) / _divider : 1;
+	constexpr Timeline::Cycle longest = std::numeric_limits<int>::max();
+	return Awaiter{*this, static_cast<int>(std::min(cycles, longest))};
 }
 
-auto Clock_domain::Poll_timer::start_timer() const noexcept -> void
+namespace {
+auto monotonic_now() noexcept -> std::chrono::nanoseconds
 {
-	/* start timer */
-	if(timerfd_settime(_clock_fd, 0, &_timerValue, NULL) < 0) {
-		std::cout << "could not start timer" << '\n';
-		std::terminate();
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec};
+}
+} // namespace
+
+Frame_pacer::Frame_pacer(std::chrono::nanoseconds period) noexcept
+    : _period(period), _deadline(monotonic_now())
+{
+}
+
+auto Frame_pacer::wait() noexcept -> void
+{
+	++_stats.frames;
+	_deadline += _period;
+
+	const auto now = monotonic_now();
+	if(now >= _deadline) {
+		// the next frame starts right away, unless we are too far behind
+		++_stats.late;
+		lag(now - _deadline);
+		const auto behind = (now - _deadline) / _period;
+		if(behind >= static_cast<std::int64_t>(Max_catch_up)) {
+			_stats.dropped += behind;
+			_deadline += behind * _period;
+		}
+		return;
 	}
+	const auto sec = std::chrono::duration_cast<std::chrono::seconds>(_deadline);
+	const struct timespec deadline{sec.count(), (_deadline - sec).count()};
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+	}
+	const auto jitter = monotonic_now() - _deadline;
+	_stats.jitter_max = std::max(_stats.jitter_max, jitter);
+	_stats.jitter_total += jitter;
+	++_stats.sleeps;
+	lag(jitter);
+}
+
+auto Frame_pacer::lag(std::chrono::nanoseconds lag) noexcept -> void
+{
+	_stats.lag = lag;
+	_stats.lag_max = std::max(_stats.lag_max, lag);
 }
 
-auto Clock_domain::Awaiter::await_ready() const noexcept -> bool { return false; }
+auto Clock_domain::Awaiter::await_ready() const noexcept -> bool { return _cycle <= 0; }
 
 auto Clock_domain::Awaiter::await_suspend(std::coroutine_handle<> coro) noexcept -> bool
 {
-	coroutineHandle = coro;
-	_event._edge_awaiter.push_back(this);
+	auto &timeline = _event._timeline;
+	// from the current edge of the domain, or the next one if in between
+	const Timeline::Cycle mask = _event._divider - 1;
+	const auto edge = (timeline.now() + mask) & ~mask;
+	_timeline_event.when = edge + Timeline::Cycle(_cycle) * _event._divider;
+	_timeline_event.handle = coro;
+	timeline.schedule(_timeline_event);
 	return true;
 }
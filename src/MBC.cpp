@@ -1,31 +1,65 @@
 #include "MBC.hpp"
+
+namespace {
+// the byte at addr through the partition of a controller. A RAM smaller than
+// a bank, 2kB, is mirrored across 0xA000-0xBFFF
+template <typename Partition>
+auto mapped(const Partition &partition, std::span<std::uint8_t> ram,
+            std::uint16_t addr) noexcept -> std::uint8_t *
+{
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and not ram.empty() and
+	   ram.size() < 8_kB) {
+		return &ram[(addr - SWI_RAM_base) % ram.size()];
+	}
+	return partition.data(addr);
+}
+} // namespace
+
 // TODO change nbr with enum to make code more explicit
 auto MBC1::swap_bank_rom_high()
 {
+	const size_t addr = (reg1_2() & (m_rom.size() / 16_kB - 1)) * 16_kB;
 	for(size_t i = 0; i < 2; ++i) {
-		MBC1_Partition::section mem_part{&m_memory[reg1_2() * 16_kB + i * 8_kB],
-		                                 &m_memory[reg1_2() * 16_kB + i * 8_kB + 8_kB]};
+		MBC1_Partition::section mem_part{&m_rom[addr + i * 8_kB], 8_kB};
 		m_memory_partition.swap(i + 2, std::move(mem_part));
 	}
 	return;
 }
 auto MBC1::swap_bank_rom_low()
 {
-	const size_t addr = (mode()) ? (reg2() << 5) * 16_kB : 0b0;
+	const size_t banks = m_rom.size() / 16_kB;
+	const size_t addr = (mode()) ? ((reg2() << 5) & (banks - 1)) * 16_kB : 0b0;
 	for(size_t i = 0; i < 2; ++i) {
-		MBC1_Partition::section mem_part{&m_memory[addr + i * 8_kB],
-		                                 &m_memory[addr + i * 8_kB + 8_kB]};
+		MBC1_Partition::section mem_part{&m_rom[addr + i * 8_kB], 8_kB};
 		m_memory_partition.swap(i, std::move(mem_part));
 	}
 	return;
 }
 auto MBC1::swap_bank_ram()
 {
-	const size_t addr = (mode()) ? reg2() * 8_kB : 0b0;
-	MBC1_Partition::section mem_part{&m_memory[addr], &m_memory[addr + 8_kB]};
+	const size_t banks = m_ram.size() / 8_kB;
+	const size_t addr = (mode()) ? (reg2() & (banks - 1)) * 8_kB : 0b0;
+	MBC1_Partition::section mem_part{&m_ram[addr], 8_kB};
 	m_memory_partition.swap(5, std::move(mem_part));
 	return;
 }
+MBC1::MBC1(std::span<std::uint8_t> rom, std::span<std::uint8_t> memory,
+           std::span<std::uint8_t> ram)
+    : m_rom(rom), m_ram(ram), m_memory(memory),
+      m_memory_partition(m_memory.begin(), m_memory.end()), m_rd(), m_gen(m_rd()),
+      m_distrib(0, 255)
+{
+	const auto size = m_rom.size();
+	if(size > 2_MB or ram.size() > 32_kB or (size >= 1_MB and ram.size() > 8_kB)) {
+		throw std::invalid_argument("Either program or ram is too big");
+	}
+	if(size < 32_kB or not is_pow_of_2(size)) {
+		throw std::invalid_argument("program is incomplete");
+	}
+	swap_bank_rom_low();
+	swap_bank_rom_high();
+	if(m_ram.size() >= 8_kB) swap_bank_ram();
+}
 auto MBC1::ramg_enable(std::uint8_t value) noexcept -> void
 {
 	m_ramg_enable = ((value & 0x0F) == 0x0A) ? true : false;
@@ -42,21 +76,40 @@ auto MBC1::bank_reg2(std::uint8_t value) noexcept -> void
 	m_bank_selector = (m_bank_selector & 0b1001'1111) | ((value & 0b11) << 5);
 	swap_bank_rom_high();
 	swap_bank_rom_low();
-        if(m_ram > 8_kB) swap_bank_ram();
+	if(m_ram.size() > 8_kB) swap_bank_ram();
 }
 auto MBC1::bank_mode(std::uint8_t value) noexcept -> void
 {
 	m_bank_selector = set_bit(m_bank_selector, 7, static_cast<std::uint8_t>(value & 0b1));
 	swap_bank_rom_high();
 	swap_bank_rom_low();
-        if(m_ram > 8_kB) swap_bank_ram();
+	if(m_ram.size() > 8_kB) swap_bank_ram();
 }
-[[nodiscard]] auto MBC1::read(std::uint16_t addr) const noexcept -> std::uint8_t
+[[nodiscard]] auto MBC1::bank(std::uint16_t addr) const noexcept -> std::uint16_t
 {
+	if(addr < IROM1_base) return (mode()) ? (reg2() << 5) : 0;
+	if(addr < IROM1_ul) return reg1_2();
 	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul) {
-		return (m_ramg_enable) ? m_memory_partition[addr] : m_distrib(m_gen);
+		return (mode() and m_ram.size() > 8_kB) ? reg2() : 0;
 	}
-	return m_memory_partition[addr];
+	return 0;
+}
+[[nodiscard]] auto MBC1::map(std::uint8_t page) noexcept -> Memory_page
+{
+	const std::uint16_t addr = page << 8;
+	auto *data = mapped(m_memory_partition, m_ram, addr);
+	if(addr < IROM1_ul) return {data, Memory_page::Slow_write};
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and not m_ramg_enable) {
+		return {data, Memory_page::Slow_read | Memory_page::Slow_write};
+	}
+	return {data, 0};
+}
+[[nodiscard]] auto MBC1::read(std::uint16_t addr) const noexcept -> std::uint8_t
+{
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and not m_ramg_enable) {
+		return m_distrib(m_gen);
+	}
+	return *mapped(m_memory_partition, m_ram, addr);
 }
 auto MBC1::write(std::uint16_t addr, std::uint8_t value) noexcept -> void
 {
@@ -80,9 +133,257 @@ auto MBC1::write(std::uint16_t addr, std::uint8_t value) noexcept -> void
 	}
 	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul) {
 		if(m_ramg_enable) {
-			m_memory_partition[addr] = value;
+			*mapped(m_memory_partition, m_ram, addr) = value;
 		}
+		return;
 	}
-	m_memory_partition[addr] = value;
+	*mapped(m_memory_partition, m_ram, addr) = value;
 	return;
 }
+
+auto Real_time_clock::set_clock(Cycle_counter clock) noexcept -> void
+{
+	sync();
+	m_clock = clock;
+	m_synced = m_clock();
+}
+auto Real_time_clock::sync() noexcept -> void
+{
+	const auto now = m_clock();
+	if(not m_halted) m_cycles += now - m_synced;
+	m_synced = now;
+	tick(m_cycles / Cycles_per_second);
+	m_cycles %= Cycles_per_second;
+}
+namespace {
+// add n to a register which rolls over at modulo, return the carries to the
+// next one. Above modulo it first counts up to its mask and wraps to 0
+auto count(std::uint8_t &reg, std::uint64_t n, std::uint8_t modulo,
+           std::uint8_t mask) noexcept -> std::uint64_t
+{
+	if(reg >= modulo) {
+		const unsigned wrap = mask + 1 - reg;
+		if(n < wrap) {
+			reg += n;
+			return 0;
+		}
+		n -= wrap;
+		reg = 0;
+	}
+	const auto total = reg + n;
+	reg = total % modulo;
+	return total / modulo;
+}
+} // namespace
+auto Real_time_clock::tick(std::uint64_t seconds) noexcept -> void
+{
+	if(seconds == 0) return;
+	const auto minutes = count(m_seconds, seconds, 60, 0b11'1111);
+	const auto hours = count(m_minutes, minutes, 60, 0b11'1111);
+	const auto days = m_days + count(m_hours, hours, 24, 0b1'1111);
+	if(days >= 512) m_carry = true;
+	m_days = days % 512;
+}
+auto Real_time_clock::registers() const noexcept -> std::array<std::uint8_t, 5>
+{
+	return {m_seconds, m_minutes, m_hours, static_cast<std::uint8_t>(m_days & 0xFF),
+	        static_cast<std::uint8_t>((m_days >> 8) | (m_halted << 6) | (m_carry << 7))};
+}
+auto Real_time_clock::latch() noexcept -> void
+{
+	sync();
+	m_latched = registers();
+}
+auto Real_time_clock::write(std::uint8_t reg, std::uint8_t value) noexcept -> void
+{
+	sync();
+	switch(reg) {
+	case Seconds:
+		m_seconds = value & 0b11'1111;
+		// setting the seconds resets the divider of the clock
+		m_cycles = 0;
+		break;
+	case Minutes: m_minutes = value & 0b11'1111; break;
+	case Hours: m_hours = value & 0b1'1111; break;
+	case Day_low: m_days = (m_days & 0x100) | value; break;
+	case Day_high:
+		m_days = (m_days & 0xFF) | ((value & 0b1) << 8);
+		m_halted = value & 0b0100'0000;
+		m_carry = value & 0b1000'0000;
+		break;
+	default: return;
+	}
+	m_latched[reg - Seconds] = value;
+}
+
+MBC3::MBC3(std::span<std::uint8_t> rom, std::span<std::uint8_t> memory,
+           std::span<std::uint8_t> ram)
+    : m_rom(rom), m_ram(ram), m_memory(memory),
+      m_memory_partition(m_memory.begin(), m_memory.end())
+{
+	if(m_rom.size() > 2_MB or m_ram.size() > 32_kB) {
+		throw std::invalid_argument("Either program or ram is too big");
+	}
+	if(m_rom.size() < 32_kB or not is_pow_of_2(m_rom.size())) {
+		throw std::invalid_argument("program is incomplete");
+	}
+	for(size_t i = 0; i < 2; ++i) {
+		m_memory_partition.swap(i, MBC3_Partition::section{&m_rom[i * 8_kB], 8_kB});
+	}
+	swap_bank_rom();
+	swap_bank_ram();
+}
+auto MBC3::swap_bank_rom() noexcept -> void
+{
+	const size_t addr = (m_rom_bank & (m_rom.size() / 16_kB - 1)) * 16_kB;
+	for(size_t i = 0; i < 2; ++i) {
+		MBC3_Partition::section mem_part{&m_rom[addr + i * 8_kB], 8_kB};
+		m_memory_partition.swap(i + 2, std::move(mem_part));
+	}
+}
+// the clock registers keep the current bank mapped, they are not memory
+auto MBC3::swap_bank_ram() noexcept -> void
+{
+	if(m_ram.size() < 8_kB or rtc_selected()) return;
+	const size_t addr = (m_ram_select & (m_ram.size() / 8_kB - 1)) * 8_kB;
+	m_memory_partition.swap(5, MBC3_Partition::section{&m_ram[addr], 8_kB});
+}
+[[nodiscard]] auto MBC3::bank(std::uint16_t addr) const noexcept -> std::uint16_t
+{
+	if(addr < IROM1_base) return 0;
+	if(addr < IROM1_ul) return m_rom_bank & (m_rom.size() / 16_kB - 1);
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and m_ram.size() >= 8_kB) {
+		return m_ram_select & (m_ram.size() / 8_kB - 1);
+	}
+	return 0;
+}
+[[nodiscard]] auto MBC3::map(std::uint8_t page) noexcept -> Memory_page
+{
+	const std::uint16_t addr = page << 8;
+	auto *data = mapped(m_memory_partition, m_ram, addr);
+	if(addr < IROM1_ul) return {data, Memory_page::Slow_write};
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and
+	   (not m_ramg_enable or rtc_selected())) {
+		return {data, Memory_page::Slow_read | Memory_page::Slow_write};
+	}
+	return {data, 0};
+}
+[[nodiscard]] auto MBC3::read(std::uint16_t addr) const noexcept -> std::uint8_t
+{
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul) {
+		if(not m_ramg_enable) return 0xFF;
+		if(rtc_selected()) return m_rtc.read(m_ram_select);
+	}
+	return *mapped(m_memory_partition, m_ram, addr);
+}
+auto MBC3::write(std::uint16_t addr, std::uint8_t value) noexcept -> void
+{
+	if(addr < 0x2000) {
+		m_ramg_enable = (value & 0x0F) == 0x0A;
+		return;
+	}
+	if(addr < 0x4000) {
+		m_rom_bank = value & 0b111'1111;
+		if(m_rom_bank == 0) m_rom_bank = 0b1;
+		swap_bank_rom();
+		return;
+	}
+	if(addr < 0x6000) {
+		m_ram_select = value & 0x0F;
+		swap_bank_ram();
+		return;
+	}
+	if(addr < 0x8000) {
+		if(m_latch == 0x00 and value == 0x01) m_rtc.latch();
+		m_latch = value;
+		return;
+	}
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul) {
+		if(not m_ramg_enable) return;
+		if(rtc_selected()) m_rtc.write(m_ram_select, value);
+		else *mapped(m_memory_partition, m_ram, addr) = value;
+		return;
+	}
+	*mapped(m_memory_partition, m_ram, addr) = value;
+}
+
+MBC5::MBC5(std::span<std::uint8_t> rom, std::span<std::uint8_t> memory,
+           std::span<std::uint8_t> ram)
+    : m_rom(rom), m_ram(ram), m_memory(memory),
+      m_memory_partition(m_memory.begin(), m_memory.end())
+{
+	if(m_rom.size() > 8_MB or m_ram.size() > 128_kB) {
+		throw std::invalid_argument("Either program or ram is too big");
+	}
+	if(m_rom.size() < 32_kB or not is_pow_of_2(m_rom.size())) {
+		throw std::invalid_argument("program is incomplete");
+	}
+	for(size_t i = 0; i < 2; ++i) {
+		m_memory_partition.swap(i, MBC5_Partition::section{&m_rom[i * 8_kB], 8_kB});
+	}
+	swap_bank_rom();
+	swap_bank_ram();
+}
+auto MBC5::swap_bank_rom() noexcept -> void
+{
+	const size_t addr = (m_rom_bank & (m_rom.size() / 16_kB - 1)) * 16_kB;
+	for(size_t i = 0; i < 2; ++i) {
+		MBC5_Partition::section mem_part{&m_rom[addr + i * 8_kB], 8_kB};
+		m_memory_partition.swap(i + 2, std::move(mem_part));
+	}
+}
+auto MBC5::swap_bank_ram() noexcept -> void
+{
+	if(m_ram.size() < 8_kB) return;
+	const size_t addr = (m_ram_bank & (m_ram.size() / 8_kB - 1)) * 8_kB;
+	m_memory_partition.swap(5, MBC5_Partition::section{&m_ram[addr], 8_kB});
+}
+[[nodiscard]] auto MBC5::bank(std::uint16_t addr) const noexcept -> std::uint16_t
+{
+	if(addr < IROM1_base) return 0;
+	if(addr < IROM1_ul) return m_rom_bank & (m_rom.size() / 16_kB - 1);
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and m_ram.size() >= 8_kB) {
+		return m_ram_bank & (m_ram.size() / 8_kB - 1);
+	}
+	return 0;
+}
+[[nodiscard]] auto MBC5::map(std::uint8_t page) noexcept -> Memory_page
+{
+	const std::uint16_t addr = page << 8;
+	auto *data = mapped(m_memory_partition, m_ram, addr);
+	if(addr < IROM1_ul) return {data, Memory_page::Slow_write};
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and not m_ramg_enable) {
+		return {data, Memory_page::Slow_read | Memory_page::Slow_write};
+	}
+	return {data, 0};
+}
+[[nodiscard]] auto MBC5::read(std::uint16_t addr) const noexcept -> std::uint8_t
+{
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and not m_ramg_enable) return 0xFF;
+	return *mapped(m_memory_partition, m_ram, addr);
+}
+auto MBC5::write(std::uint16_t addr, std::uint8_t value) noexcept -> void
+{
+	if(addr < 0x2000) {
+		m_ramg_enable = value == 0x0A;
+		return;
+	}
+	if(addr < 0x3000) {
+		m_rom_bank = (m_rom_bank & 0x100) | value;
+		swap_bank_rom();
+		return;
+	}
+	if(addr < 0x4000) {
+		m_rom_bank = (m_rom_bank & 0xFF) | ((value & 0b1) << 8);
+		swap_bank_rom();
+		return;
+	}
+	if(addr < 0x6000) {
+		m_ram_bank = value & 0x0F;
+		swap_bank_ram();
+		return;
+	}
+	if(addr < 0x8000) return;
+	if(addr >= SWI_RAM_base and addr < SWI_RAM_ul and not m_ramg_enable) return;
+	*mapped(m_memory_partition, m_ram, addr) = value;
+}
@@ -0,0 +1,69 @@
+#include "cartridge_ram.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+Cartridge_ram::Cartridge_ram(std::size_t size) : m_copy(size, 0x00)
+{
+	m_data = m_copy.data();
+	m_size = m_copy.size();
+}
+
+auto Cartridge_ram::map(const std::filesystem::path &path, std::size_t size)
+    -> Cartridge_ram
+{
+	if(size == 0) return Cartridge_ram{size};
+	const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0) throw std::system_error(errno, std::generic_category(), path.string());
+	struct stat info {};
+	int error = (fstat(fd, &info) < 0) ? errno : 0;
+	if(error == 0 and static_cast<std::size_t>(info.st_size) < size and
+	   ftruncate(fd, size) < 0) {
+		error = errno;
+	}
+	void *data = MAP_FAILED;
+	if(error == 0) {
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(data == MAP_FAILED) error = errno;
+	}
+	close(fd);
+	if(error != 0) throw std::system_error(error, std::generic_category(), path.string());
+
+	Cartridge_ram ram;
+	ram.m_data = static_cast<std::uint8_t *>(data);
+	ram.m_size = size;
+	ram.m_mapped = true;
+	return ram;
+}
+
+Cartridge_ram::Cartridge_ram(Cartridge_ram &&other) noexcept
+    : m_copy(std::move(other.m_copy)), m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_mapped(std::exchange(other.m_mapped, false))
+{
+}
+
+auto Cartridge_ram::operator=(Cartridge_ram &&other) noexcept -> Cartridge_ram &
+{
+	std::swap(m_copy, other.m_copy);
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_mapped, other.m_mapped);
+	return *this;
+}
+
+Cartridge_ram::~Cartridge_ram()
+{
+	if(not m_mapped) return;
+	msync(m_data, m_size, MS_SYNC);
+	munmap(m_data, m_size);
+}
+
+auto Cartridge_ram::flush() noexcept -> void
+{
+	if(m_mapped) msync(m_data, m_size, MS_ASYNC);
+}
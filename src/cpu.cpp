@@ -12,7 +12,8 @@
 using namespace ISA;
 using namespace std;
 
-auto SM83::dump(ostream &cout) -> void
+template <typename MBC>
+auto SM83<MBC>::dump(ostream &cout) -> void
 {
 	cout << "Register A:" << static_cast<int>(m_regbank.A) << '\n';
 	cout << "Register B:" << static_cast<int>(m_regbank.B) << '\n';
@@ -24,1281 +25,533 @@ auto SM83::dump(ostream &cout) -> void
 	cout << "Register SP:" << static_cast<int>(m_regbank.SP) << '\n';
 }
 
-[[nodiscard]] auto SM83::fetch(const Memory &memory) -> task<uint8_t>
+template <typename MBC>
+auto SM83<MBC>::dispatch_interrupt(Memory<MBC> &memory) noexcept -> void
 {
-	co_return co_await await<1>(m_clock, &Memory::read, std::cref(memory),
-	                            m_regbank.PC++);
+	const auto vector = memory.acknowledge_interrupt();
+	PUSH(m_regbank.SP, memory, m_regbank.PC);
+	JP(m_regbank.PC, vector);
 }
-[[nodiscard]] auto SM83::fetch_ovelap(const Memory &memory) noexcept -> uint8_t
+
+template <typename MBC>
+auto SM83<MBC>::poll_interrupt(Memory<MBC> &memory) noexcept -> bool
 {
-	return memory.read(m_regbank.PC++);
+	if(not memory.interrupts().pending()) [[likely]] {
+		return false;
+	}
+	dispatch_interrupt(memory);
+	m_cycles += Interrupt_controller::Dispatch_cycles;
+	return true;
 }
 
-[[nodiscard]] auto SM83::fetch_imm8(const Memory &memory) -> task<uint8_t>
+template <typename MBC>
+auto SM83<MBC>::call_handler(void *cpu, void *memory, const void *context) noexcept
+    -> bool
 {
-	co_return co_await await<1>(m_clock, &Memory::read, std::cref(memory),
-	                            m_regbank.PC++);
+	auto *self = static_cast<SM83 *>(cpu);
+	const auto &instruction = *static_cast<const Instruction *>(context);
+	const bool taken = (self->*instruction.handler)(*static_cast<Memory<MBC> *>(memory),
+	                                                instruction.operand);
+	// the native code only knows the materialized flags
+	self->m_regbank.F = self->m_regbank.F.read();
+	return taken;
 }
 
-[[nodiscard]] auto SM83::fetch_imm16(const Memory &memory) -> task<uint16_t>
+template <typename MBC>
+auto SM83<MBC>::read_memory(void *memory, std::uint16_t addr) noexcept -> std::uint8_t
 {
-	const uint8_t lo =
-	    co_await await<1>(m_clock, &Memory::read, std::cref(memory), m_regbank.PC++);
-	const uint8_t hi =
-	    co_await await<1>(m_clock, &Memory::read, std::cref(memory), m_regbank.PC++);
-	co_return(hi << 4) | lo;
+	return static_cast<const Memory<MBC> *>(memory)->read(addr);
 }
-auto SM83::interrupt_handler(Memory &memory) -> task<void>
+
+template <typename MBC>
+auto SM83<MBC>::write_memory(void *memory, std::uint16_t addr,
+                             std::uint8_t value) noexcept -> void
 {
-	// disable it
-	memory.write_IME(0x0);
-	co_await await<1>(m_clock, PUSH, m_regbank.SP, memory, m_regbank.PC);
-	// co_await await<1>(m_clock,  JP, m_regbank.PC, ((memory.IE() & 5) * 0x8) + 0x40);
-	co_return;
+	static_cast<Memory<MBC> *>(memory)->write(addr, value);
 }
 
-auto SM83::run(Memory &memory) -> Dummy_coro
+template <typename MBC>
+auto SM83<MBC>::translate(Basic_block<Handler> &block) -> void
 {
-	std::uint8_t opcode = co_await fetch(memory);
-	while(1) {
-		co_await execute(opcode, memory);
-		// fetch overlap interrup check
-		// fetch overlap execute
-		opcode = fetch_ovelap(memory);
-		if((memory.IME() & memory.IE())) {
-			co_await interrupt_handler(memory);
-			opcode = co_await fetch(memory);
-		}
+	// RAM blocks may be rewritten, only the ROM is worth it
+	if(block.begin >= IROM1_ul) return;
+	std::vector<Dynarec::Op> ops;
+	ops.reserve(block.ops.size());
+	std::uint16_t pc = block.begin;
+	for(const auto &instruction : block.ops) {
+		pc += instruction.length;
+		ops.push_back({instruction.opcode, instruction.operand, pc, instruction.cycles,
+		               instruction.cycles_taken, instruction.properties, &instruction});
+	}
+	block.native = m_dynarec.compile(ops, block.begin, block.links);
+}
+
+template <typename MBC>
+auto SM83<MBC>::native(Basic_block<Handler> &block) -> Dynarec::Native
+{
+	if(m_dynarec_enabled and block.native == nullptr and
+	   ++block.hits == Dynarec::Hot_threshold) {
+		translate(block);
 	}
+	return block.native;
 }
 
-auto SM83::has_imm(uint8_t opcode) noexcept -> IMMEDIATE
+template <typename MBC>
+auto SM83<MBC>::link(const Basic_block<Handler> &block,
+                     const Memory<MBC> &memory) noexcept -> void
 {
-	// d16 : 01 11 21 31
-	// d8  : 06 16 26 36 C6 D6 E6 F6
-	//       0E 1E 2E 3E CE DE EE FE
-	// a8  : E0 F0
-	// a16 : C2 C3 C4 CA CC CD
-	//       D2 D4 DA DC
-	//       08
-	//       EA
-	//       FA
-	IMMEDIATE predicate = NO_IMM;
-	switch(opcode >> 4) {
-	case 0x0:
-		if((opcode & 0b1111) == 0x8) {
-			predicate = IMM16;
-			break;
-		}
-	case 0x1:
-	case 0x2:
-	case 0x3:
-		switch(opcode & 0b1111) {
-		case 0x1:
-			predicate = IMM16;
-			break;
-		case 0x6:
-		case 0xE:
-			predicate = IMM8;
-			break;
-		default:
-			break;
-		}
-		break;
-	case 0xC:
-		switch(opcode & 0b1111) {
-		case 0x1:
-		case 0x3:
-		case 0x4:
-		case 0x6:
-		case 0xA:
-		case 0xC:
-		case 0xD:
-		case 0xE:
-			predicate = IMM16;
-			break;
-		default:
-			break;
-		}
-		break;
-	case 0xD:
-		switch(opcode & 0b1111) {
-		case 0x2:
-		case 0x4:
-		case 0xA:
-		case 0xC:
-			predicate = IMM16;
-			break;
-		case 0x6:
-		case 0xE:
-			predicate = IMM8;
-			break;
-		default:
-			break;
-		}
+	// an interrupt or HALT may have led elsewhere since
+	if(m_exit != nullptr and block.native != nullptr and block.begin == m_exit->target) {
+		m_exit->code = block.native;
+		m_exit->mapping = memory.mapping_version();
+	}
+	m_exit = nullptr;
+}
 
-		break;
-	case 0xE:
-		switch(opcode & 0b1111) {
-		case 0x6:
-		case 0xE:
-			predicate = IMM8;
-			break;
-		case 0xA:
-			predicate = IMM16;
-			break;
-		default:
-			break;
+template <typename MBC>
+auto SM83<MBC>::run(Memory<MBC> &memory) -> Dummy_coro
+{
+	auto &timeline = m_clock.timeline();
+	while(1) {
+		if(halted(memory)) [[unlikely]] {
+			// only another domain or the host can request an interrupt: sleep
+			// until the first of them runs
+			const auto before = timeline.now();
+			co_await m_clock.until(std::min(timeline.next(), timeline.horizon()));
+			m_idle_cycles += (timeline.now() - before) / m_clock.divider();
+			if(halted(memory)) continue;
+			if(memory.interrupts().pending()) {
+				co_await m_clock.cycles(Interrupt_controller::Dispatch_cycles);
+				dispatch_interrupt(memory);
+			}
 		}
-		break;
-	case 0xF:
-		switch(opcode & 0b1111) {
-		case 0xA:
-			predicate = IMM16;
-			break;
-		case 0x6:
-		case 0xE:
-			predicate = IMM8;
-			break;
-		default:
-			break;
+		auto &block = m_cache.lookup(m_regbank.PC, memory);
+		Idle_state state{};
+		if(block.self_loop) state = idle_state(memory);
+		const auto start = timeline.now();
+		const auto mapping = memory.mapping_version();
+		// instructions are plain calls, only the clock suspends: the opcode and
+		// its immediate are fetched during the first cycles, effects are
+		// visible at the end of the instruction
+		for(const auto &instruction : block.ops) {
+			co_await m_clock.cycles(instruction.cycles);
+			if(apply(instruction, memory)) {
+				co_await m_clock.cycles(instruction.cycles_taken - instruction.cycles);
+			}
+			if(memory.interrupts().pending()) {
+				co_await m_clock.cycles(Interrupt_controller::Dispatch_cycles);
+				dispatch_interrupt(memory);
+				break;
+			}
+			// the block may have rewritten itself, or switched the bank it runs from
+			if(m_cache.stale(memory) or memory.mapping_version() != mapping) break;
+		}
+		// an idle iteration (see run_cycles) is repeated until another domain
+		// runs: skip the whole ones before its event, or the end of advance_to
+		if(block.self_loop and m_regbank.PC == block.begin and
+		   idle_state(memory) == state) {
+			const auto now = timeline.now();
+			const auto period = now - start;
+			const auto event = std::min(timeline.next(), timeline.horizon());
+			if(period > 0 and event > now and (event - now) >= period) {
+				const auto skipped = (event - now) / period * period;
+				co_await m_clock.until(now + skipped);
+				m_idle_cycles += skipped / m_clock.divider();
+			}
 		}
-		break;
-	default:
-		break;
 	}
-	return predicate;
 }
+
 namespace {
-constexpr auto nbr_to_reg(std::uint8_t nibble_lo, Register_bank &regbank,
-                          Memory &memory) noexcept -> std::uint8_t *
+// 8 bits operand encoding : B C D E H L (HL) A
+template <std::uint8_t idx> auto reg8(Register_bank &bank) noexcept -> Register8 &
 {
-	switch(nibble_lo % 7) {
-	case 0x0:
-		return &regbank.B;
-	case 0x1:
-		return &regbank.C;
-	case 0x2:
-		return &regbank.D;
-	case 0x3:
-		return &regbank.E;
-	case 0x4:
-		return &regbank.H;
-	case 0x5:
-		return &regbank.L;
-		//	case 0x6:
-		//		return &memory[compose(regbank.H, regbank.L)];
-	case 0x7:
-		return &regbank.A;
-	}
-	return nullptr;
+	static_assert(idx != 6, "(HL) is a memory operand");
+	if constexpr(idx == 0) return bank.B;
+	else if constexpr(idx == 1) return bank.C;
+	else if constexpr(idx == 2) return bank.D;
+	else if constexpr(idx == 3) return bank.E;
+	else if constexpr(idx == 4) return bank.H;
+	else if constexpr(idx == 5) return bank.L;
+	else return bank.A;
 }
-} // namespace
-auto SM83::extended_set(uint8_t opcode, Memory &memory) noexcept -> void
+template <std::uint8_t idx, typename MBC>
+auto read8(Register_bank &bank, const Memory<MBC> &memory) noexcept -> Register8
 {
-	const auto [hi, lo] = decompose(opcode);
-	auto *lhs = nbr_to_reg(lo, m_regbank, memory);
-	switch(hi) {
-	case 0x0:
-		*lhs = (lo < 8) ? RLC(*lhs, m_regbank.F) : RRC(*lhs, m_regbank.F);
-		break;
-	case 0x1:
-		*lhs = (lo < 8) ? RL(*lhs, m_regbank.F) : RR(*lhs, m_regbank.F);
-		break;
-	case 0x2:
-		*lhs = (lo < 8) ? SLA(*lhs, m_regbank.F) : SRA(*lhs, m_regbank.F);
-		break;
-	case 0x3:
-		*lhs = (lo < 8) ? SWAP(*lhs, m_regbank.F) : SWAP(*lhs, m_regbank.F);
-		break;
-	case 0x4:
-	case 0x5:
-	case 0x6:
-	case 0x7:
-	case 0x8:
-		*lhs = BIT(lo & 7, *lhs, m_regbank.F);
-		break;
-	case 0x9:
-	case 0xA:
-	case 0xB:
-		*lhs = RES(lo & 7, *lhs);
-		break;
-	case 0xC:
-	case 0xD:
-	case 0xE:
-	case 0xF:
-		*lhs = SET(lo & 7, *lhs);
-		break;
-	}
+	if constexpr(idx == 6) return memory.read(bank.HL);
+	else return reg8<idx>(bank);
+}
+template <std::uint8_t idx, typename MBC>
+auto write8(Register_bank &bank, Memory<MBC> &memory, Register8 value) noexcept -> void
+{
+	if constexpr(idx == 6) memory.write(bank.HL, value);
+	else reg8<idx>(bank) = value;
+}
+// 16 bits operand encoding : BC DE HL SP, AF takes the place of SP for PUSH/POP
+template <std::uint8_t idx, bool AF = false>
+auto read16(const Register_bank &bank) noexcept -> Register16
+{
+	if constexpr(idx == 0) return bank.BC;
+	else if constexpr(idx == 1) return bank.DE;
+	else if constexpr(idx == 2) return bank.HL;
+	else if constexpr(AF) return bank.AF();
+	else return bank.SP;
+}
+template <std::uint8_t idx, bool AF = false>
+auto write16(Register_bank &bank, Register16 value) noexcept -> void
+{
+	if constexpr(idx == 0) bank.BC = value;
+	else if constexpr(idx == 1) bank.DE = value;
+	else if constexpr(idx == 2) bank.HL = value;
+	else if constexpr(AF) bank.set_AF(value);
+	else bank.SP = value;
 }
+// ADD ADC SUB SBC AND XOR OR CP
+template <std::uint8_t op> auto alu(Register_bank &bank, Register8 value) noexcept -> void
+{
+	if constexpr(op == 0) bank.A = ADD(bank.A, value, bank.F);
+	else if constexpr(op == 1) bank.A = ADC(bank.A, value, bank.F);
+	else if constexpr(op == 2) bank.A = SUB(bank.A, value, bank.F);
+	else if constexpr(op == 3) bank.A = SBC(bank.A, value, bank.F);
+	else if constexpr(op == 4) bank.A = AND(bank.A, value, bank.F);
+	else if constexpr(op == 5) bank.A = XOR(bank.A, value, bank.F);
+	else if constexpr(op == 6) bank.A = OR(bank.A, value, bank.F);
+	else CP(bank.A, value, bank.F);
+}
+// RLC RRC RL RR SLA SRA SWAP SRL
+template <std::uint8_t op>
+auto shift(Register8 value, Flag_register &F) noexcept -> Register8
+{
+	if constexpr(op == 0) return RLC(value, F);
+	else if constexpr(op == 1) return RRC(value, F);
+	else if constexpr(op == 2) return RL(value, F);
+	else if constexpr(op == 3) return RR(value, F);
+	else if constexpr(op == 4) return SLA(value, F);
+	else if constexpr(op == 5) return SRA(value, F);
+	else if constexpr(op == 6) return SWAP(value, F);
+	else return SRL(value, F);
+}
+} // namespace
 
-auto SM83::execute(uint8_t opcode, Memory &memory) noexcept -> task<void>
+/*
+ *  Opcodes are decoded at compile time from their bit fields:
+ *      | 7 6 | 5 4 3 | 2 1 0 |
+ *      |  x  |   y   |   z   |
+ *      |     | p | q |       |
+ *  see ISA::Opcode_table for timing and flags.
+ */
+template <typename MBC>
+template <std::uint8_t opcode>
+auto SM83<MBC>::instruction(Memory<MBC> &memory, std::uint16_t imm) noexcept -> bool
 {
-	switch(opcode) {
-	case 0x00: {
+	constexpr std::uint8_t x = opcode >> 6;
+	constexpr std::uint8_t y = (opcode >> 3) & 0b111;
+	constexpr std::uint8_t z = opcode & 0b111;
+	constexpr std::uint8_t p = y >> 1;
+	constexpr std::uint8_t q = y & 0b1;
+	constexpr auto cc = static_cast<FLAG>(y & 0b11);
+	auto &bank = m_regbank;
+	const auto imm8 = static_cast<Imm8>(imm);
+
+	/*************************** x = 0 *********************************/
+	if constexpr(opcode == 0x00) {
 		NOOP();
-		break;
-	}
-	case 0x01: {
-		tie(m_regbank.B, m_regbank.C) = decompose(LD(co_await fetch_imm16(memory)));
-		break;
-	}
-	case 0x02: {
-		memory.write(compose(m_regbank.B, m_regbank.C), LD(m_regbank.A));
-		break;
-	}
-	case 0x03: {
-		const Register16 BC = compose(m_regbank.B, m_regbank.C);
-		tie(m_regbank.B, m_regbank.C) = decompose(INC(BC, m_regbank.F));
-		break;
-	}
-	case 0x04: {
-		m_regbank.B =
-		    co_await await<3>(m_clock, INC<std::uint8_t>, m_regbank.B, m_regbank.F);
-		break;
-	}
-	case 0x05: {
-		m_regbank.B = DEC(m_regbank.B, m_regbank.F);
-		break;
-	}
-	case 0x06: {
-		m_regbank.B = LD(co_await fetch_imm8(memory));
-		break;
-	}
-	case 0x07: {
-		m_regbank.A = RLC(m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x08: {
-		const Register16 imm16 = co_await fetch_imm16(memory);
-		const auto [hi, lo] = decompose(LD(m_regbank.SP));
-		memory.write(imm16, hi);
-		memory.write(imm16 + 1, lo);
-		break;
 	}
-	case 0x09: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		const Register16 BC = compose(m_regbank.B, m_regbank.C);
-		tie(m_regbank.H, m_regbank.L) = decompose(ADD(HL, BC, m_regbank.F));
-		break;
+	else if constexpr(opcode == 0x08) {
+		const auto [hi, lo] = decompose(LD(bank.SP));
+		memory.write(imm, lo);
+		memory.write(imm + 1, hi);
 	}
-	case 0x0a: {
-		m_regbank.A = LD(compose(m_regbank.B, m_regbank.C), memory);
-		break;
-	}
-	case 0x0b: {
-		const Register16 BC = compose(m_regbank.B, m_regbank.C);
-		tie(m_regbank.B, m_regbank.C) = decompose(DEC(BC, m_regbank.F));
-		break;
-	}
-	case 0x0c: {
-		m_regbank.C = INC(m_regbank.C, m_regbank.F);
-		break;
-	}
-	case 0x0d: {
-		m_regbank.C = DEC(m_regbank.C, m_regbank.F);
-		break;
-	}
-	case 0x0e: {
-		m_regbank.C = LD(co_await fetch_imm8(memory));
-		break;
-	}
-	case 0x0f: {
-		m_regbank.A = RRC(m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x10: {
+	else if constexpr(opcode == 0x10) {
 		STOP();
-		break;
-	}
-	case 0x11: {
-		tie(m_regbank.D, m_regbank.E) = decompose(LD(co_await fetch_imm16(memory)));
-		break;
-	}
-	case 0x12: {
-		memory.write(compose(m_regbank.D, m_regbank.E), LD(m_regbank.A));
-		break;
-	}
-	case 0x13: {
-		const Register16 DE = compose(m_regbank.D, m_regbank.E);
-		tie(m_regbank.D, m_regbank.E) = decompose(INC(DE, m_regbank.F));
-		break;
-	}
-	case 0x14: {
-		m_regbank.D = INC(m_regbank.D, m_regbank.F);
-		break;
-	}
-	case 0x15: {
-		m_regbank.D = DEC(m_regbank.D, m_regbank.F);
-		break;
-	}
-	case 0x16: {
-		m_regbank.D = LD(co_await fetch_imm8(memory));
-		break;
-	}
-	case 0x17: {
-		m_regbank.A = RL(m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x18: {
-		JR(m_regbank.PC, co_await fetch_imm8(memory));
-		break;
-	}
-	case 0x19: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		const Register16 DE = compose(m_regbank.D, m_regbank.E);
-		tie(m_regbank.H, m_regbank.L) = decompose(ADD(HL, DE, m_regbank.F));
-		break;
-	}
-	case 0x1a: {
-		m_regbank.A = LD(compose(m_regbank.D, m_regbank.E), memory);
-		break;
-	}
-	case 0x1b: {
-		const Register16 DE = compose(m_regbank.D, m_regbank.E);
-		tie(m_regbank.D, m_regbank.E) = decompose(DEC(DE, m_regbank.F));
-		break;
-	}
-	case 0x1c: {
-		m_regbank.E = INC(m_regbank.E, m_regbank.F);
-		break;
-	}
-	case 0x1d: {
-		m_regbank.E = DEC(m_regbank.E, m_regbank.F);
-		break;
-	}
-	case 0x1e: {
-		m_regbank.E = LD(co_await fetch_imm8(memory));
-		break;
-	}
-	case 0x1f: {
-		m_regbank.A = RR(m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x20: {
-		JR<NZ>(m_regbank.PC, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0x21: {
-		tie(m_regbank.H, m_regbank.L) = decompose(LD(co_await fetch_imm16(memory)));
-		break;
-	}
-	case 0x22: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		memory.write(HL, LD<Inc_HL>(m_regbank.A, m_regbank));
-		break;
-	}
-	case 0x23: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		tie(m_regbank.H, m_regbank.L) = decompose(INC(HL, m_regbank.F));
-		break;
-	}
-	case 0x24: {
-		m_regbank.H = INC(m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0x25: {
-		m_regbank.H = DEC(m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0x26: {
-		m_regbank.H = LD(co_await fetch_imm8(memory));
-		break;
-	}
-	case 0x27: {
-		m_regbank.A = DAA(m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x28: {
-		JR<Z>(m_regbank.PC, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0x29: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		tie(m_regbank.H, m_regbank.L) = decompose(ADD(HL, HL, m_regbank.F));
-		break;
-	}
-	case 0x2a: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		m_regbank.A = LD<Inc_HL>(HL, m_regbank);
-		break;
-	}
-	case 0x2b: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		tie(m_regbank.H, m_regbank.L) = decompose(DEC(HL, m_regbank.F));
-		break;
-	}
-	case 0x2c: {
-		m_regbank.L = INC(m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0x2d: {
-		m_regbank.L = DEC(m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0x2e: {
-		m_regbank.L = LD(co_await fetch_imm8(memory));
-		break;
-	}
-	case 0x2f: {
-		m_regbank.A = CPL(m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x30: {
-		JR<NC>(m_regbank.PC, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0x31: {
-		m_regbank.SP = LD(co_await fetch_imm16(memory));
-		break;
-	}
-	case 0x32: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		memory.write(HL, LD<Dec_HL>(m_regbank.A, m_regbank));
-		break;
-	}
-	case 0x33: {
-		m_regbank.SP = INC(m_regbank.SP, m_regbank.F);
-		break;
-	}
-	case 0x34: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		tie(m_regbank.H, m_regbank.L) = decompose(INC(HL, m_regbank.F, memory));
-		break;
-	}
-	case 0x35: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		tie(m_regbank.H, m_regbank.L) = decompose(DEC(HL, m_regbank.F, memory));
-		break;
-	}
-	case 0x36: {
-		tie(m_regbank.H, m_regbank.L) =
-		    decompose<uint16_t>(LD(co_await fetch_imm8(memory)));
-		break;
-	}
-	case 0x37: {
-		SCF(m_regbank.F);
-		break;
-	}
-	case 0x38: {
-		JR<C>(m_regbank.PC, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0x39: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		tie(m_regbank.H, m_regbank.L) = decompose(ADD(HL, m_regbank.SP, m_regbank.F));
-		break;
-	}
-	case 0x3a: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		memory.write(HL, LD<Inc_HL>(m_regbank.A, m_regbank));
-		break;
-	}
-	case 0x3b: {
-		m_regbank.SP = DEC(m_regbank.SP, m_regbank.F);
-		break;
-	}
-	case 0x3c: {
-		m_regbank.A = INC(m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x3d: {
-		m_regbank.A = DEC(m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x3e: {
-		m_regbank.A = LD(co_await fetch_imm8(memory));
-		break;
-	}
-	case 0x3f: {
-		CCF(m_regbank.F);
-		break;
-	}
-	case 0x40: {
-		m_regbank.B = LD(m_regbank.B);
-		break;
-	}
-	case 0x41: {
-		m_regbank.B = LD(m_regbank.C);
-		break;
-	}
-	case 0x42: {
-		m_regbank.B = LD(m_regbank.D);
-		break;
-	}
-	case 0x43: {
-		m_regbank.B = LD(m_regbank.E);
-		break;
-	}
-	case 0x44: {
-		m_regbank.B = LD(m_regbank.H);
-		break;
-	}
-	case 0x45: {
-		m_regbank.B = LD(m_regbank.L);
-		break;
-	}
-	case 0x46: {
-		m_regbank.B = LD(compose(m_regbank.H, m_regbank.L), memory);
-		break;
-	}
-	case 0x47: {
-		m_regbank.B = LD(m_regbank.A);
-		break;
-	}
-	case 0x48: {
-		m_regbank.C = LD(m_regbank.B);
-		break;
-	}
-	case 0x49: {
-		m_regbank.C = LD(m_regbank.C);
-		break;
-	}
-	case 0x4a: {
-		m_regbank.C = LD(m_regbank.D);
-		break;
-	}
-	case 0x4b: {
-		m_regbank.C = LD(m_regbank.E);
-		break;
-	}
-	case 0x4c: {
-		m_regbank.C = LD(m_regbank.H);
-		break;
-	}
-	case 0x4d: {
-		m_regbank.C = LD(m_regbank.L);
-		break;
-	}
-	case 0x4e: {
-		m_regbank.C = LD(compose(m_regbank.H, m_regbank.L), memory);
-		break;
-	}
-	case 0x4f: {
-		m_regbank.C = LD(m_regbank.A);
-		break;
-	}
-	case 0x50: {
-		m_regbank.D = LD(m_regbank.B);
-		break;
-	}
-	case 0x51: {
-		m_regbank.D = LD(m_regbank.C);
-		break;
-	}
-	case 0x52: {
-		m_regbank.D = LD(m_regbank.D);
-		break;
-	}
-	case 0x53: {
-		m_regbank.D = LD(m_regbank.E);
-		break;
-	}
-	case 0x54: {
-		m_regbank.D = LD(m_regbank.H);
-		break;
-	}
-	case 0x55: {
-		m_regbank.D = LD(m_regbank.L);
-		break;
-	}
-	case 0x56: {
-		m_regbank.D = LD(compose(m_regbank.H, m_regbank.L), memory);
-		break;
-	}
-	case 0x57: {
-		m_regbank.D = LD(m_regbank.A);
-		break;
-	}
-	case 0x58: {
-		m_regbank.E = LD(m_regbank.B);
-		break;
-	}
-	case 0x59: {
-		m_regbank.E = LD(m_regbank.C);
-		break;
-	}
-	case 0x5a: {
-		m_regbank.E = LD(m_regbank.D);
-		break;
-	}
-	case 0x5b: {
-		m_regbank.E = LD(m_regbank.E);
-		break;
-	}
-	case 0x5c: {
-		m_regbank.E = LD(m_regbank.H);
-		break;
-	}
-	case 0x5d: {
-		m_regbank.E = LD(m_regbank.L);
-		break;
-	}
-	case 0x5e: {
-		m_regbank.E = LD(compose(m_regbank.H, m_regbank.L), memory);
-		break;
-	}
-	case 0x5f: {
-		m_regbank.E = LD(m_regbank.A);
-		break;
-	}
-	case 0x60: {
-		m_regbank.H = LD(m_regbank.B);
-		break;
-	}
-	case 0x61: {
-		m_regbank.H = LD(m_regbank.C);
-		break;
-	}
-	case 0x62: {
-		m_regbank.H = LD(m_regbank.D);
-		break;
-	}
-	case 0x63: {
-		m_regbank.H = LD(m_regbank.E);
-		break;
-	}
-	case 0x64: {
-		m_regbank.H = LD(m_regbank.H);
-		break;
-	}
-	case 0x65: {
-		m_regbank.H = LD(m_regbank.L);
-		break;
 	}
-	case 0x66: {
-		m_regbank.H = LD(compose(m_regbank.H, m_regbank.L), memory);
-		break;
+	else if constexpr(opcode == 0x18) {
+		JR(bank.PC, static_cast<Imm8_s>(imm8));
 	}
-	case 0x67: {
-		m_regbank.H = LD(m_regbank.A);
-		break;
+	else if constexpr(x == 0 and z == 0) {
+		return JR<cc>(bank.PC, static_cast<Imm8_s>(imm8), bank.F);
 	}
-	case 0x68: {
-		m_regbank.L = LD(m_regbank.B);
-		break;
+	else if constexpr(x == 0 and z == 1 and q == 0) {
+		write16<p>(bank, LD(imm));
 	}
-	case 0x69: {
-		m_regbank.L = LD(m_regbank.C);
-		break;
+	else if constexpr(x == 0 and z == 1) {
+		write16<2>(bank, ADD(read16<2>(bank), read16<p>(bank), bank.F));
 	}
-	case 0x6a: {
-		m_regbank.L = LD(m_regbank.D);
-		break;
+	else if constexpr(x == 0 and z == 2 and q == 0) {
+		const Register16 HL = read16<2>(bank);
+		if constexpr(p < 2) memory.write(read16<p>(bank), LD(bank.A));
+		else if constexpr(p == 2) memory.write(HL, LD<Inc_HL>(bank.A, bank));
+		else memory.write(HL, LD<Dec_HL>(bank.A, bank));
 	}
-	case 0x6b: {
-		m_regbank.L = LD(m_regbank.E);
-		break;
+	else if constexpr(x == 0 and z == 2) {
+		if constexpr(p < 2) bank.A = LD(read16<p>(bank), memory);
+		else if constexpr(p == 2) bank.A = LD<Inc_HL>(read16<2>(bank), memory, bank);
+		else bank.A = LD<Dec_HL>(read16<2>(bank), memory, bank);
 	}
-	case 0x6c: {
-		m_regbank.L = LD(m_regbank.H);
-		break;
+	else if constexpr(x == 0 and z == 3) {
+		const Register16 value = read16<p>(bank);
+		write16<p>(bank, static_cast<Register16>((q == 0) ? value + 1 : value - 1));
 	}
-	case 0x6d: {
-		m_regbank.L = LD(m_regbank.L);
-		break;
+	else if constexpr(x == 0 and z == 4) {
+		write8<y>(bank, memory, INC(read8<y>(bank, memory), bank.F));
 	}
-	case 0x6e: {
-		m_regbank.L = LD(compose(m_regbank.H, m_regbank.L), memory);
-		break;
+	else if constexpr(x == 0 and z == 5) {
+		write8<y>(bank, memory, DEC(read8<y>(bank, memory), bank.F));
 	}
-	case 0x6f: {
-		m_regbank.L = LD(m_regbank.A);
-		break;
+	else if constexpr(x == 0 and z == 6) {
+		write8<y>(bank, memory, LD(imm8));
 	}
-	case 0x70: {
-		memory.write(compose(m_regbank.H, m_regbank.L), LD(m_regbank.B));
-		break;
+	else if constexpr(opcode == 0x07) {
+		bank.A = RLCA(bank.A, bank.F);
 	}
-	case 0x71: {
-		memory.write(compose(m_regbank.H, m_regbank.L), LD(m_regbank.C));
-		break;
+	else if constexpr(opcode == 0x0F) {
+		bank.A = RRCA(bank.A, bank.F);
 	}
-	case 0x72: {
-		memory.write(compose(m_regbank.H, m_regbank.L), LD(m_regbank.D));
-		break;
+	else if constexpr(opcode == 0x17) {
+		bank.A = RLA(bank.A, bank.F);
 	}
-	case 0x73: {
-		memory.write(compose(m_regbank.H, m_regbank.L), LD(m_regbank.E));
-		break;
+	else if constexpr(opcode == 0x1F) {
+		bank.A = RRA(bank.A, bank.F);
 	}
-	case 0x74: {
-		memory.write(compose(m_regbank.H, m_regbank.L), LD(m_regbank.H));
-		break;
+	else if constexpr(opcode == 0x27) {
+		bank.A = DAA(bank.A, bank.F);
 	}
-	case 0x75: {
-		memory.write(compose(m_regbank.H, m_regbank.L), LD(m_regbank.L));
-		break;
+	else if constexpr(opcode == 0x2F) {
+		bank.A = CPL(bank.A, bank.F);
 	}
-	case 0x76: {
-		const Register16 HL = compose(m_regbank.H, m_regbank.L);
-		memory.write(HL, LD(HL, memory));
-		break;
+	else if constexpr(opcode == 0x37) {
+		SCF(bank.F);
 	}
-	case 0x77: {
-		m_regbank.B = LD(m_regbank.A);
-		break;
+	else if constexpr(opcode == 0x3F) {
+		CCF(bank.F);
 	}
-	case 0x78: {
-		m_regbank.A = LD(m_regbank.B);
-		break;
+	/*************************** x = 1 *********************************/
+	else if constexpr(opcode == 0x76) {
+		// the CPU sleeps from the next cycle, see run() and run_cycles()
+		m_halted = not memory.interrupts().requested();
 	}
-	case 0x79: {
-		m_regbank.A = LD(m_regbank.C);
-		break;
+	else if constexpr(x == 1) {
+		write8<y>(bank, memory, LD(read8<z>(bank, memory)));
 	}
-	case 0x7a: {
-		m_regbank.A = LD(m_regbank.D);
-		break;
+	/*************************** x = 2 *********************************/
+	else if constexpr(x == 2) {
+		alu<y>(bank, read8<z>(bank, memory));
 	}
-	case 0x7b: {
-		m_regbank.A = LD(m_regbank.E);
-		break;
+	/*************************** x = 3 *********************************/
+	else if constexpr(z == 0 and y < 4) {
+		return RET<cc>(bank.PC, bank.SP, memory, bank.F);
 	}
-	case 0x7c: {
-		m_regbank.A = LD(m_regbank.H);
-		break;
+	else if constexpr(opcode == 0xE0) {
+		memory.write(compose(static_cast<Imm8>(0xFF), imm8), LD(bank.A));
 	}
-	case 0x7d: {
-		m_regbank.A = LD(m_regbank.L);
-		break;
+	else if constexpr(opcode == 0xE8) {
+		bank.SP = ADD_SP(bank.SP, imm8, bank.F);
 	}
-	case 0x7e: {
-		m_regbank.A = LD(compose(m_regbank.H, m_regbank.L), memory);
-		break;
+	else if constexpr(opcode == 0xF0) {
+		bank.A = LDH(imm8, memory);
 	}
-	case 0x7f: {
-		m_regbank.A = LD(m_regbank.A);
-		break;
+	else if constexpr(opcode == 0xF8) {
+		write16<2>(bank, ADD_SP(bank.SP, imm8, bank.F));
 	}
-	case 0x80: {
-		m_regbank.A = ADD(m_regbank.A, m_regbank.B, m_regbank.F);
-		break;
+	else if constexpr(z == 1 and q == 0) {
+		write16<p, true>(bank, compose(POP(bank.SP, memory)));
 	}
-	case 0x81: {
-		m_regbank.A = ADD(m_regbank.A, m_regbank.C, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xC9) {
+		RET(bank.PC, bank.SP, memory);
 	}
-	case 0x82: {
-		m_regbank.A = ADD(m_regbank.A, m_regbank.D, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xD9) {
+		RETI(bank.PC, bank.SP, memory);
 	}
-	case 0x83: {
-		m_regbank.A = ADD(m_regbank.A, m_regbank.E, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xE9) {
+		JP(bank.PC, read16<2>(bank));
 	}
-	case 0x84: {
-		m_regbank.A = ADD(m_regbank.A, m_regbank.H, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xF9) {
+		bank.SP = LD(read16<2>(bank));
 	}
-	case 0x85: {
-		m_regbank.A = ADD(m_regbank.A, m_regbank.L, m_regbank.F);
-		break;
+	else if constexpr(z == 2 and y < 4) {
+		return JP<cc>(bank.PC, imm, bank.F);
 	}
-	case 0x86: {
-		m_regbank.A =
-		    ADD(m_regbank.A, memory.read(compose(m_regbank.H, m_regbank.L)), m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xE2) {
+		memory.write(compose(static_cast<Imm8>(0xFF), bank.C), LD(bank.A));
 	}
-	case 0x87: {
-		m_regbank.A = ADD(m_regbank.A, m_regbank.A, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xEA) {
+		memory.write(imm, LD(bank.A));
 	}
-	case 0x88: {
-		m_regbank.A = ADC(m_regbank.A, m_regbank.B, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xF2) {
+		bank.A = LDH(bank.C, memory);
 	}
-	case 0x89: {
-		m_regbank.A = ADC(m_regbank.A, m_regbank.C, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xFA) {
+		bank.A = LD(imm, memory);
 	}
-	case 0x8a: {
-		m_regbank.A = ADC(m_regbank.A, m_regbank.D, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xC3) {
+		JP(bank.PC, imm);
 	}
-	case 0x8b: {
-		m_regbank.A = ADC(m_regbank.A, m_regbank.E, m_regbank.F);
-		break;
+	else if constexpr(opcode == 0xCB) {
+		// only reached by a Micro_op decoded by hand, see Block_cache::decode_op
+		return (this->*m_extended_handlers[imm8])(memory, imm);
 	}
-	case 0x8c: {
-		m_regbank.A = ADC(m_regbank.A, m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0x8d: {
-		m_regbank.A = ADC(m_regbank.A, m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0x8e: {
-		m_regbank.A =
-		    ADC(m_regbank.A, memory.read(compose(m_regbank.H, m_regbank.L)), m_regbank.F);
-		break;
-	}
-	case 0x8f: {
-		m_regbank.A = ADC(m_regbank.A, m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x90: {
-		m_regbank.A = SUB(m_regbank.A, m_regbank.B, m_regbank.F);
-		break;
-	}
-	case 0x91: {
-		m_regbank.A = SUB(m_regbank.A, m_regbank.C, m_regbank.F);
-		break;
-	}
-	case 0x92: {
-		m_regbank.A = SUB(m_regbank.A, m_regbank.D, m_regbank.F);
-		break;
-	}
-	case 0x93: {
-		m_regbank.A = SUB(m_regbank.A, m_regbank.E, m_regbank.F);
-		break;
-	}
-	case 0x94: {
-		m_regbank.A = SUB(m_regbank.A, m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0x95: {
-		m_regbank.A = SUB(m_regbank.A, m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0x96: {
-		m_regbank.A =
-		    SUB(m_regbank.A, memory.read(compose(m_regbank.H, m_regbank.L)), m_regbank.F);
-		break;
-	}
-	case 0x97: {
-		m_regbank.A = SUB(m_regbank.A, m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0x98: {
-		m_regbank.A = SBC(m_regbank.A, m_regbank.B, m_regbank.F);
-		break;
-	}
-	case 0x99: {
-		m_regbank.A = SBC(m_regbank.A, m_regbank.C, m_regbank.F);
-		break;
-	}
-	case 0x9a: {
-		m_regbank.A = SBC(m_regbank.A, m_regbank.D, m_regbank.F);
-		break;
-	}
-	case 0x9b: {
-		m_regbank.A = SBC(m_regbank.A, m_regbank.E, m_regbank.F);
-		break;
-	}
-	case 0x9c: {
-		m_regbank.A = SBC(m_regbank.A, m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0x9d: {
-		m_regbank.A = SBC(m_regbank.A, m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0x9e: {
-		m_regbank.A =
-		    SBC(m_regbank.A, memory.read(compose(m_regbank.H, m_regbank.L)), m_regbank.F);
-		break;
-	}
-	case 0x9f: {
-		m_regbank.A = SBC(m_regbank.A, m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0xa0: {
-		m_regbank.A = AND(m_regbank.A, m_regbank.B, m_regbank.F);
-		break;
-	}
-	case 0xa1: {
-		m_regbank.A = AND(m_regbank.A, m_regbank.C, m_regbank.F);
-		break;
-	}
-	case 0xa2: {
-		m_regbank.A = AND(m_regbank.A, m_regbank.D, m_regbank.F);
-		break;
-	}
-	case 0xa3: {
-		m_regbank.A = AND(m_regbank.A, m_regbank.E, m_regbank.F);
-		break;
-	}
-	case 0xa4: {
-		m_regbank.A = AND(m_regbank.A, m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0xa5: {
-		m_regbank.A = AND(m_regbank.A, m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0xa6: {
-		m_regbank.A =
-		    AND(m_regbank.A, memory.read(compose(m_regbank.H, m_regbank.L)), m_regbank.F);
-		break;
-	}
-	case 0xa7: {
-		m_regbank.A = AND(m_regbank.A, m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0xa8: {
-		m_regbank.A = XOR(m_regbank.A, m_regbank.B, m_regbank.F);
-		break;
-	}
-	case 0xa9: {
-		m_regbank.A = XOR(m_regbank.A, m_regbank.C, m_regbank.F);
-		break;
-	}
-	case 0xaa: {
-		m_regbank.A = XOR(m_regbank.A, m_regbank.D, m_regbank.F);
-		break;
-	}
-	case 0xab: {
-		m_regbank.A = XOR(m_regbank.A, m_regbank.E, m_regbank.F);
-		break;
-	}
-	case 0xac: {
-		m_regbank.A = XOR(m_regbank.A, m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0xad: {
-		m_regbank.A = XOR(m_regbank.A, m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0xae: {
-		m_regbank.A =
-		    XOR(m_regbank.A, memory.read(compose(m_regbank.H, m_regbank.L)), m_regbank.F);
-		break;
-	}
-	case 0xaf: {
-		m_regbank.A = XOR(m_regbank.A, m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0xb0: {
-		m_regbank.A = OR(m_regbank.A, m_regbank.B, m_regbank.F);
-		break;
-	}
-	case 0xb1: {
-		m_regbank.A = OR(m_regbank.A, m_regbank.C, m_regbank.F);
-		break;
-	}
-	case 0xb2: {
-		m_regbank.A = OR(m_regbank.A, m_regbank.D, m_regbank.F);
-		break;
-	}
-	case 0xb3: {
-		m_regbank.A = OR(m_regbank.A, m_regbank.E, m_regbank.F);
-		break;
-	}
-	case 0xb4: {
-		m_regbank.A = OR(m_regbank.A, m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0xb5: {
-		m_regbank.A = OR(m_regbank.A, m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0xb6: {
-		m_regbank.A =
-		    OR(m_regbank.A, memory.read(compose(m_regbank.H, m_regbank.L)), m_regbank.F);
-		break;
-	}
-	case 0xb7: {
-		m_regbank.A = OR(m_regbank.A, m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0xb8: {
-		CP(m_regbank.A, m_regbank.B, m_regbank.F);
-		break;
-	}
-	case 0xb9: {
-		CP(m_regbank.A, m_regbank.C, m_regbank.F);
-		break;
-	}
-	case 0xba: {
-		CP(m_regbank.A, m_regbank.D, m_regbank.F);
-		break;
-	}
-	case 0xbb: {
-		CP(m_regbank.A, m_regbank.E, m_regbank.F);
-		break;
-	}
-	case 0xbc: {
-		CP(m_regbank.A, m_regbank.H, m_regbank.F);
-		break;
-	}
-	case 0xbd: {
-		CP(m_regbank.A, m_regbank.L, m_regbank.F);
-		break;
-	}
-	case 0xbe: {
-		CP(m_regbank.A, compose(m_regbank.H, m_regbank.L), m_regbank.F);
-		break;
-	}
-	case 0xbf: {
-		CP(m_regbank.A, m_regbank.A, m_regbank.F);
-		break;
-	}
-	case 0xc0: {
-		RET<NZ>(m_regbank.PC, m_regbank.SP, memory, m_regbank.F);
-		break;
-	}
-	case 0xc1: {
-		tie(m_regbank.B, m_regbank.C) = POP(m_regbank.SP, memory);
-		break;
-	}
-	case 0xc2: {
-		JP<NZ>(m_regbank.PC, co_await fetch_imm16(memory), m_regbank.F);
-		break;
-	}
-	case 0xc3: {
-		JP(m_regbank.PC, co_await fetch_imm16(memory));
-		break;
-	}
-	case 0xc4: {
-		CALL<NZ>(m_regbank.PC, m_regbank.SP, co_await fetch_imm16(memory), memory,
-		         m_regbank.F);
-		break;
-	}
-	case 0xc5: {
-		PUSH(m_regbank.SP, memory, compose(m_regbank.B, m_regbank.C));
-		break;
-	}
-	case 0xc6: {
-		m_regbank.A = ADD(m_regbank.A, co_await fetch_imm16(memory), m_regbank.F);
-		break;
-	}
-	case 0xc7: {
-		RST(m_regbank.PC, m_regbank.SP, 0x00, memory);
-		break;
-	}
-	case 0xc8: {
-		RET<Z>(m_regbank.PC, m_regbank.SP, memory, m_regbank.F);
-		break;
-	}
-	case 0xc9: {
-		RET(m_regbank.PC, m_regbank.SP, memory);
-		break;
-	}
-	case 0xca: {
-		JP<Z>(m_regbank.PC, co_await fetch_imm16(memory), m_regbank.F);
-		break;
-	}
-	case 0xcb: {
-		extended_set(opcode, memory);
-		break;
-	}
-	case 0xcc: {
-		CALL<Z>(m_regbank.PC, m_regbank.SP, co_await fetch_imm16(memory), memory,
-		        m_regbank.F);
-		break;
-	}
-	case 0xcd: {
-		CALL(m_regbank.PC, m_regbank.SP, co_await fetch_imm16(memory), memory);
-		break;
-	}
-	case 0xce: {
-		m_regbank.A = ADC(m_regbank.A, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0xcf: {
-		RST(m_regbank.PC, m_regbank.SP, 0x08, memory);
-		break;
-	}
-	case 0xd0: {
-		RET<NC>(m_regbank.PC, m_regbank.SP, memory, m_regbank.F);
-		break;
-	}
-	case 0xd1: {
-		tie(m_regbank.D, m_regbank.E) = POP(m_regbank.SP, memory);
-		break;
-	}
-	case 0xd2: {
-		JP<NC>(m_regbank.PC, co_await fetch_imm16(memory), m_regbank.F);
-		break;
-	}
-	case 0xd3: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xd4: {
-		CALL<NC>(m_regbank.PC, m_regbank.SP, co_await fetch_imm16(memory), memory,
-		         m_regbank.F);
-		break;
-	}
-	case 0xd5: {
-		PUSH(m_regbank.SP, memory, compose(m_regbank.D, m_regbank.E));
-		break;
-	}
-	case 0xd6: {
-		m_regbank.A = SUB(m_regbank.A, co_await fetch_imm16(memory), m_regbank.F);
-		break;
-	}
-	case 0xd7: {
-		RST(m_regbank.PC, m_regbank.SP, 0x10, memory);
-		break;
-	}
-	case 0xd8: {
-		RET<C>(m_regbank.PC, m_regbank.SP, memory, m_regbank.F);
-		break;
-	}
-	case 0xd9: {
-		RETI(m_regbank.PC, m_regbank.SP, memory);
-		break;
-	}
-	case 0xda: {
-		JP<C>(m_regbank.PC, co_await fetch_imm16(memory), m_regbank.F);
-		break;
-	}
-	case 0xdb: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xdc: {
-		CALL<C>(m_regbank.PC, m_regbank.SP, co_await fetch_imm8(memory), memory,
-		        m_regbank.F);
-		break;
-	}
-	case 0xdd: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xde: {
-		m_regbank.A = SBC(m_regbank.A, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0xdf: {
-		RST(m_regbank.PC, m_regbank.SP, 0x18, memory);
-		break;
-	}
-	case 0xe0: {
-		const uint16_t addr =
-		    compose(static_cast<uint8_t>(0xFF), co_await fetch_imm8(memory));
-		memory.write(addr, LD(m_regbank.A));
-		break;
-	}
-	case 0xe1: {
-		tie(m_regbank.H, m_regbank.L) = POP(m_regbank.SP, memory);
-		break;
-	}
-	case 0xe2: {
-		const uint16_t addr = compose(static_cast<uint8_t>(0xFF), m_regbank.C);
-		memory.write(addr, LD(m_regbank.A));
-		break;
-	}
-	case 0xe3: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xe4: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xe5: {
-		PUSH(m_regbank.SP, memory, compose(m_regbank.H, m_regbank.L));
-		break;
-	}
-	case 0xe6: {
-		m_regbank.A = AND(m_regbank.A, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0xe7: {
-		RST(m_regbank.PC, m_regbank.SP, 0x20, memory);
-		break;
-	}
-	case 0xe8: {
-		m_regbank.A = ADD(m_regbank.SP, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0xe9: {
-		JP<Z>(m_regbank.PC, memory.read(compose(m_regbank.H, m_regbank.L)), m_regbank.F);
-		break;
-	}
-	case 0xea: {
-		memory.write(co_await fetch_imm16(memory), LD(m_regbank.A));
-		break;
-	}
-	case 0xeb: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xec: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xed: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xee: {
-		m_regbank.A = XOR(m_regbank.A, co_await fetch_imm8(memory), m_regbank.F);
-		break;
-	}
-	case 0xef: {
-		RST(m_regbank.PC, m_regbank.SP, 0x28, memory);
-		break;
-	}
-	case 0xf0: {
-		m_regbank.A = LDH(co_await fetch_imm8(memory), memory);
-		break;
-	}
-	case 0xf1: {
-		tie(m_regbank.A, m_regbank.F) = POP(m_regbank.SP, memory);
-		break;
-	}
-	case 0xf2: {
-
-		m_regbank.A = LDH(m_regbank.C, memory);
-		break;
-	}
-	case 0xf3: {
+	else if constexpr(opcode == 0xF3) {
 		DI(memory);
-		break;
-	}
-	case 0xf4: {
-		Unhandle_Instruction();
-		break;
-	}
-	case 0xf5: {
-		PUSH(m_regbank.SP, memory, compose(m_regbank.A, m_regbank.F.read()));
-		break;
-	}
-	case 0xf6: {
-		m_regbank.A = OR(m_regbank.A, co_await fetch_imm8(memory), m_regbank.F);
-		break;
 	}
-	case 0xf7: {
-		RST(m_regbank.PC, m_regbank.SP, 0x30, memory);
-		break;
+	else if constexpr(opcode == 0xFB) {
+		EI(memory);
 	}
-	case 0xf8: {
-		tie(m_regbank.H, m_regbank.L) = LD(m_regbank.SP, co_await fetch_imm8(memory));
-		break;
+	else if constexpr(z == 4 and y < 4) {
+		return CALL<cc>(bank.PC, bank.SP, imm, memory, bank.F);
 	}
-	case 0xf9: {
-		m_regbank.SP = LD(compose(m_regbank.H, m_regbank.L));
-		break;
+	else if constexpr(z == 5 and q == 0) {
+		PUSH(bank.SP, memory, read16<p, true>(bank));
 	}
-	case 0xfa: {
-		// TODO fix the flag
-		m_regbank.A = LD(co_await fetch_imm16(memory), memory);
-		break;
+	else if constexpr(opcode == 0xCD) {
+		CALL(bank.PC, bank.SP, imm, memory);
 	}
-	case 0xfb: {
-		EI(memory);
-		break;
+	else if constexpr(z == 6) {
+		alu<y>(bank, imm8);
 	}
-	case 0xfc: {
-		Unhandle_Instruction();
-		break;
+	else if constexpr(z == 7) {
+		RST(bank.PC, bank.SP, y * 8, memory);
 	}
-	case 0xfd: {
+	else {
+		// D3 DB DD E3 E4 EB EC ED F4 FC FD
 		Unhandle_Instruction();
-		break;
-	}
-	case 0xfe: {
-		CP(m_regbank.A, co_await fetch_imm8(memory), m_regbank.F);
-		break;
 	}
-	case 0xff: {
-		RST(m_regbank.PC, m_regbank.SP, 0x38, memory);
-		break;
+	return false;
+}
+
+// 0xCB prefix, same bit fields: x selects shift/BIT/RES/SET, y the shift or the bit
+template <typename MBC>
+template <std::uint8_t opcode>
+auto SM83<MBC>::extended(Memory<MBC> &memory, std::uint16_t) noexcept -> bool
+{
+	constexpr std::uint8_t x = opcode >> 6;
+	constexpr std::uint8_t y = (opcode >> 3) & 0b111;
+	constexpr std::uint8_t z = opcode & 0b111;
+	auto &bank = m_regbank;
+	const Register8 value = read8<z>(bank, memory);
+
+	if constexpr(x == 0) write8<z>(bank, memory, shift<y>(value, bank.F));
+	else if constexpr(x == 1) BIT(y, value, bank.F);
+	else if constexpr(x == 2) write8<z>(bank, memory, RES(y, value));
+	else write8<z>(bank, memory, SET(y, value));
+	return false;
+}
+
+template <typename MBC>
+const std::array<typename SM83<MBC>::Handler, 256> SM83<MBC>::m_handlers =
+    SM83::make_handlers(std::make_index_sequence<256>{});
+template <typename MBC>
+const std::array<typename SM83<MBC>::Handler, 256> SM83<MBC>::m_extended_handlers =
+    SM83::make_extended_handlers(std::make_index_sequence<256>{});
+
+template <typename MBC>
+auto SM83<MBC>::apply(const Instruction &instruction, Memory<MBC> &memory) noexcept
+    -> bool
+{
+	m_regbank.PC += instruction.length;
+	return (this->*instruction.handler)(memory, instruction.operand);
+}
+
+template <typename MBC>
+auto SM83<MBC>::step(Memory<MBC> &memory) noexcept -> unsigned
+{
+	const auto begin = m_cycles;
+	if(m_halted) [[unlikely]] {
+		if(halted(memory)) {
+			++m_cycles;
+			++m_idle_cycles;
+			return 1;
+		}
+		// the interrupt which ended HALT comes before the next instruction
+		if(poll_interrupt(memory)) return m_cycles - begin;
+	}
+	const auto instruction = m_cache.decode_op(m_regbank.PC, memory);
+	m_cycles += (apply(instruction, memory)) ? instruction.cycles_taken
+	                                         : instruction.cycles;
+	poll_interrupt(memory);
+	return m_cycles - begin;
+}
+
+template <typename MBC>
+auto SM83<MBC>::run_block(Basic_block<Handler> &block, Memory<MBC> &memory,
+                          std::uint64_t end) -> void
+{
+	if(auto code = native(block); code != nullptr) {
+		m_regbank.F = m_regbank.F.read();
+		Dynarec::State state{&m_regbank,
+		                     &m_cycles,
+		                     end,
+		                     memory.view(),
+		                     this,
+		                     &memory,
+		                     &SM83::call_handler,
+		                     &SM83::read_memory,
+		                     &SM83::write_memory};
+		m_exit = m_dynarec.run(state, code);
+		poll_interrupt(memory);
+		return;
+	}
+	const auto mapping = memory.mapping_version();
+	for(const auto &instruction : block.ops) {
+		m_cycles += (apply(instruction, memory)) ? instruction.cycles_taken
+		                                         : instruction.cycles;
+		if(poll_interrupt(memory) or m_cache.stale(memory) or
+		   memory.mapping_version() != mapping) {
+			break;
+		}
 	}
+}
+
+template <typename MBC>
+auto SM83<MBC>::idle_state(const Memory<MBC> &memory) const noexcept -> Idle_state
+{
+	const auto &bank = m_regbank;
+	const auto &interrupts = memory.interrupts();
+	return {bank.AF(),       bank.BC,         bank.DE,
+	        bank.HL,         bank.SP,         memory.write_count(),
+	        interrupts.IE(), interrupts.IF(), interrupts.master()};
+}
+
+template <typename MBC>
+auto SM83<MBC>::run_cycles(Memory<MBC> &memory, std::uint64_t cycles) -> std::uint64_t
+{
+	// the last instruction may overshoot the budget
+	const auto begin = m_cycles;
+	const auto end = begin + cycles;
+	while(m_cycles < end) {
+		if(m_halted) [[unlikely]] {
+			// nothing runs along the CPU in this mode, only the caller can
+			// request an interrupt: sleep until the end of the budget
+			if(halted(memory)) {
+				m_idle_cycles += end - m_cycles;
+				m_cycles = end;
+				break;
+			}
+			poll_interrupt(memory);
+			continue;
+		}
+		auto &block = m_cache.lookup(m_regbank.PC, memory);
+		link(block, memory);
+		if(not block.self_loop) {
+			run_block(block, memory, end);
+			continue;
+		}
+		const auto state = idle_state(memory);
+		const auto start = m_cycles;
+		run_block(block, memory, end);
+		// an iteration which only read the memory and left every register as
+		// it was will be repeated until an event: nothing but the CPU runs
+		// here, the next one is the end of the budget
+		if(m_regbank.PC == block.begin and idle_state(memory) == state) {
+			const auto period = m_cycles - start;
+			const auto skipped = (end - m_cycles + period - 1) / period * period;
+			m_cycles += skipped;
+			m_idle_cycles += skipped;
+		}
 	}
-	co_return;
+	return m_cycles - begin;
 }
+
+template class SM83<Simple_MBC>;
+template class SM83<MBC1>;
+template class SM83<MBC3>;
+template class SM83<MBC5>;
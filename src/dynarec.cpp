@@ -0,0 +1,773 @@
+#include "dynarec.hpp"
+#include "opcode_table.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <sys/mman.h>
+
+using namespace ISA;
+
+auto Dynarec::is_native(std::uint8_t opcode) noexcept -> bool
+{
+	const std::uint8_t x = opcode >> 6;
+	const std::uint8_t y = (opcode >> 3) & 0b111;
+	const std::uint8_t z = opcode & 0b111;
+	// NOP, JR e8, JR cc,e8, JP a16, JP cc,a16
+	if(opcode == 0x00 or opcode == 0x18 or opcode == 0xC3) return true;
+	if((x == 0 and z == 0 and y >= 4) or (x == 3 and z == 2 and y < 4)) return true;
+	// LD rr,d16 and INC/DEC rr
+	if(x == 0 and ((z == 1 and (y & 0b1) == 0) or z == 3)) return true;
+	// LD (rr),A and LD A,(rr) with BC DE HL+ HL-
+	if(x == 0 and z == 2) return true;
+	// INC/DEC r, (HL) is left to the interpreter
+	if(x == 0 and (z == 4 or z == 5) and y != 6) return true;
+	// LD r,d8 and LD (HL),d8
+	if(x == 0 and z == 6) return true;
+	// CPL SCF CCF
+	if(opcode == 0x2F or opcode == 0x37 or opcode == 0x3F) return true;
+	// LD r,r' LD r,(HL) LD (HL),r but HALT
+	if(x == 1) return opcode != 0x76;
+	// arithmetic on A with a register, (HL) or d8
+	if(x == 2 or (x == 3 and z == 6)) return true;
+	// LD (a16),A and LD A,(a16)
+	return opcode == 0xEA or opcode == 0xFA;
+}
+
+#if defined(__x86_64__)
+namespace {
+enum Host : std::uint8_t {
+	RAX,
+	RCX,
+	RDX,
+	RBX,
+	RSP,
+	RBP,
+	RSI,
+	RDI,
+	R8,
+	R9,
+	R10,
+	R11,
+	R12,
+	R13,
+	R14,
+	R15
+};
+// host register of an operand, see the SM83 encoding B C D E H L (HL) A.
+// rbx holds the State, rbp the flag table, esi F and rdi the M-cycles; rax rcx
+// and rdx are scratch
+constexpr std::array<std::uint8_t, 8> host_reg{R9, R10, R11, R12, R13, R14, 0, R8};
+constexpr std::uint8_t host_SP = R15;
+constexpr std::uint8_t host_F = RSI;
+constexpr std::uint8_t host_cycles = RDI;
+
+// F from the flags LAHF loads in AH: ZF (bit 6) is Z, AF (bit 4) is H and
+// CF (bit 0) is C, N is known from the operation
+constexpr auto flag_table = [] {
+	std::array<std::uint8_t, 256> table{};
+	for(std::size_t ah = 0; ah < table.size(); ++ah) {
+		table[ah] = ((ah & 0x40) ? 0x80 : 0) | ((ah & 0x10) ? 0x20 : 0) |
+		            ((ah & 0x01) ? 0x10 : 0);
+	}
+	return table;
+}();
+
+enum Size : std::uint8_t { Byte, Word, Dword, Qword };
+// a register, or [base + disp]
+struct Rm {
+	std::uint8_t reg;
+	bool memory = false;
+	std::int8_t disp = 0;
+};
+constexpr auto mem(std::uint8_t base, std::size_t disp) noexcept -> Rm
+{
+	return {base, true, static_cast<std::int8_t>(disp)};
+}
+// jcc rel32, the second byte after 0x0F
+enum Condition : std::uint8_t { Below = 0x82, Above_equal, Zero, Not_zero };
+
+class Emitter {
+	std::vector<std::uint8_t> m_code;
+	// where the code is copied, for the rel32 towards the stubs
+	const std::uint8_t *m_base;
+
+  public:
+	explicit Emitter(const std::uint8_t *base) : m_base(base) {}
+	auto code() const noexcept -> const std::vector<std::uint8_t> & { return m_code; }
+	auto base() const noexcept -> const std::uint8_t * { return m_base; }
+	auto byte(std::initializer_list<std::uint8_t> bytes) -> void
+	{
+		m_code.insert(std::end(m_code), bytes);
+	}
+	auto imm16(std::uint16_t value) -> void
+	{
+		byte({std::uint8_t(value), std::uint8_t(value >> 8)});
+	}
+	auto imm32(std::uint32_t value) -> void
+	{
+		imm16(value);
+		imm16(value >> 16);
+	}
+	auto imm64(std::uint64_t value) -> void
+	{
+		imm32(value);
+		imm32(value >> 32);
+	}
+	// [66] [REX] opcode ModRM [SIB] [disp8], reg is an opcode extension
+	// when digit is set
+	auto op(Size size, std::initializer_list<std::uint8_t> opcode, std::uint8_t reg,
+	        Rm rm, bool digit = false) -> void
+	{
+		if(size == Word) byte({0x66});
+		const std::uint8_t rex =
+		    0x40 | ((size == Qword) << 3) | ((reg >> 3) << 2) | (rm.reg >> 3);
+		// without REX, 4 to 7 are AH CH DH BH instead of SPL BPL SIL DIL
+		const auto high = [](std::uint8_t r) { return r >= 4 and r < 8; };
+		const bool low_byte = size == Byte and ((not digit and high(reg)) or
+		                                        (not rm.memory and high(rm.reg)));
+		if(rex != 0x40 or low_byte) byte({rex});
+		byte(opcode);
+		const std::uint8_t modrm = ((reg & 7) << 3) | (rm.reg & 7);
+		if(not rm.memory) {
+			byte({std::uint8_t(0xC0 | modrm)});
+			return;
+		}
+		byte({std::uint8_t(0x40 | modrm)});
+		if((rm.reg & 7) == RSP) byte({0x24});
+		byte({std::uint8_t(rm.disp)});
+	}
+	auto ext(Size size, std::initializer_list<std::uint8_t> opcode, std::uint8_t digit,
+	         Rm rm) -> void
+	{
+		op(size, opcode, digit, rm, true);
+	}
+	// mov r64, imm64
+	auto mov64(std::uint8_t reg, std::uint64_t value) -> void
+	{
+		byte({std::uint8_t(0x48 | (reg >> 3)), std::uint8_t(0xB8 | (reg & 7))});
+		imm64(value);
+	}
+	// mov r32, imm32
+	auto mov32(std::uint8_t reg, std::uint32_t value) -> void
+	{
+		byte({std::uint8_t(0xB8 | reg)});
+		imm32(value);
+	}
+	auto rel32(const std::uint8_t *target) -> void
+	{
+		const auto next = m_base + m_code.size() + 4;
+		imm32(static_cast<std::uint32_t>(target - next));
+	}
+	auto jmp(const std::uint8_t *target) -> void
+	{
+		byte({0xE9});
+		rel32(target);
+	}
+	// jcc to an absolute address
+	auto jump(Condition condition, const std::uint8_t *target) -> void
+	{
+		byte({0x0F, condition});
+		rel32(target);
+	}
+	auto call(const std::uint8_t *target) -> void
+	{
+		byte({0xE8});
+		rel32(target);
+	}
+	// forward jcc, return the label to bind
+	auto jump(Condition condition) -> std::size_t
+	{
+		byte({0x0F, condition});
+		imm32(0);
+		return m_code.size();
+	}
+	auto bind(std::size_t label) -> void
+	{
+		const auto rel = static_cast<std::uint32_t>(m_code.size() - label);
+		std::memcpy(&m_code[label - 4], &rel, sizeof(rel));
+	}
+};
+
+// displacement of the registers inside Register_bank
+struct Layout {
+	std::array<std::uint8_t, 8> reg;
+	std::uint8_t F;
+	std::uint8_t SP;
+	std::uint8_t PC;
+	Layout()
+	{
+		Register_bank bank{};
+		const auto base = reinterpret_cast<const std::uint8_t *>(&bank);
+		auto disp = [base](const auto &field) {
+			const auto addr = reinterpret_cast<const std::uint8_t *>(&field);
+			return static_cast<std::uint8_t>(addr - base);
+		};
+		reg = {disp(bank.B), disp(bank.C), disp(bank.D), disp(bank.E),
+		       disp(bank.H), disp(bank.L), 0,            disp(bank.A)};
+		F = disp(bank.F);
+		SP = disp(bank.SP);
+		PC = disp(bank.PC);
+	}
+};
+static_assert(sizeof(Register_bank) < 128, "registers must be reachable with a disp8");
+static_assert(sizeof(Dynarec::State) < 128, "the state must be reachable with a disp8");
+// the native code reads and writes the materialized flags as a byte
+static_assert(std::is_standard_layout_v<Flag_register>);
+static_assert(sizeof(Memory_page) == 16 and offsetof(Memory_page, flags) == 8);
+
+using State = Dynarec::State;
+constexpr auto bank_ptr = mem(RBX, offsetof(State, bank));
+constexpr auto cycles_ptr = mem(RBX, offsetof(State, cycles));
+
+// the registers from the Register_bank to the host and back, rdx is clobbered
+auto flush(Emitter &emit, const Layout &layout) -> void
+{
+	emit.op(Qword, {0x8B}, RDX, bank_ptr);
+	for(const std::uint8_t idx : {0, 1, 2, 3, 4, 5, 7}) {
+		emit.op(Byte, {0x88}, host_reg[idx], mem(RDX, layout.reg[idx]));
+	}
+	emit.op(Byte, {0x88}, host_F, mem(RDX, layout.F));
+	emit.op(Word, {0x89}, host_SP, mem(RDX, layout.SP));
+	emit.op(Qword, {0x8B}, RDX, cycles_ptr);
+	emit.op(Qword, {0x89}, host_cycles, mem(RDX, 0));
+}
+auto reload(Emitter &emit, const Layout &layout) -> void
+{
+	emit.op(Qword, {0x8B}, RDX, bank_ptr);
+	for(const std::uint8_t idx : {0, 1, 2, 3, 4, 5, 7}) {
+		emit.op(Byte, {0x8A}, host_reg[idx], mem(RDX, layout.reg[idx]));
+	}
+	emit.op(Byte, {0x0F, 0xB6}, host_F, mem(RDX, layout.F));
+	emit.op(Word, {0x8B}, host_SP, mem(RDX, layout.SP));
+	emit.op(Qword, {0x8B}, RDX, cycles_ptr);
+	emit.op(Qword, {0x8B}, host_cycles, mem(RDX, 0));
+}
+
+// the flags an instruction reads and the ones it sets: F is only computed
+// when read later in the block, anything which may leave the native code
+// reads all of them
+struct Flag_use {
+	std::uint8_t reads;
+	std::uint8_t writes;
+};
+auto flag_use(const Dynarec::Op &op) noexcept -> Flag_use
+{
+	constexpr std::uint8_t all = 0xF0;
+	const std::uint8_t x = op.opcode >> 6;
+	const std::uint8_t y = (op.opcode >> 3) & 0b111;
+	const std::uint8_t z = op.opcode & 0b111;
+	if(not Dynarec::is_native(op.opcode) or
+	   (op.properties & (Changes_flow | Writes_memory))) {
+		return {all, 0};
+	}
+	if(x == 2 or (x == 3 and z == 6)) {
+		return {static_cast<std::uint8_t>((y == 1 or y == 3) ? 0x10 : 0), all};
+	}
+	if(x == 0 and (z == 4 or z == 5)) return {0, 0xE0};
+	// CPL SCF CCF
+	if(op.opcode == 0x2F) return {0, 0x60};
+	if(op.opcode == 0x37) return {0, 0x70};
+	if(op.opcode == 0x3F) return {0x10, 0x70};
+	return {0, 0};
+}
+
+// ADC or SBC on a register or an immediate: nothing clobbers the host carry
+// between the previous instruction and this one
+constexpr auto carry_in(std::uint8_t opcode) noexcept -> bool
+{
+	const std::uint8_t y = (opcode >> 3) & 0b111;
+	const bool reg = (opcode >> 6) == 2 and (opcode & 0b111) != 6;
+	const bool imm = (opcode >> 6) == 3 and (opcode & 0b111) == 6;
+	return (reg or imm) and (y == 1 or y == 3);
+}
+
+struct Stubs {
+	const std::uint8_t *leave;
+	const std::uint8_t *read;
+	const std::uint8_t *write;
+};
+
+class Translator {
+	Emitter &m_emit;
+	const Layout &m_layout;
+	const Stubs &m_stubs;
+	const std::uint16_t m_begin;
+	std::span<Dynarec::Link, 2> m_links;
+	// a block looping on itself is only chained when the CPU does not need to
+	// see its iterations, see Dynarec
+	bool m_chain_self = false;
+	// M-cycles of the instructions translated since the counter was updated
+	unsigned m_pending = 0;
+	// flags read after the instruction being translated, see Flag_use
+	std::uint8_t m_live = 0xF0;
+	// the next instruction, if any
+	const Dynarec::Op *m_next = nullptr;
+	// C is the host carry rather than bit 4 of esi
+	bool m_host_carry = false;
+
+	auto sync() -> void
+	{
+		if(m_pending != 0) {
+			m_emit.ext(Qword, {0x81}, 0, {host_cycles});
+			m_emit.imm32(m_pending);
+		}
+		m_pending = 0;
+	}
+	// leave towards target through link, nullptr when it must not be chained
+	auto exit(Dynarec::Link *link, std::uint16_t target) -> void
+	{
+		sync();
+		if(target == m_begin) {
+			link = nullptr;
+			// the mapping cannot have changed without leaving the block
+			if(m_chain_self) {
+				m_emit.op(Qword, {0x3B}, host_cycles, mem(RBX, offsetof(State, end)));
+				m_emit.jump(Below, m_emit.base());
+			}
+		}
+		if(link == nullptr) {
+			m_emit.byte({0x31, 0xC0});
+			m_emit.mov32(RCX, target);
+			m_emit.jmp(m_stubs.leave);
+			return;
+		}
+		link->target = target;
+		// jump to the linked code when the budget is not spent and the bank
+		// mapped there is still the one it was translated for
+		m_emit.mov64(RAX, reinterpret_cast<std::uintptr_t>(link));
+		m_emit.op(Qword, {0x3B}, host_cycles, mem(RBX, offsetof(State, end)));
+		const auto spent = m_emit.jump(Above_equal);
+		m_emit.op(Qword, {0x8B}, RDX, mem(RAX, offsetof(Dynarec::Link, code)));
+		m_emit.byte({0x48, 0x85, 0xD2});
+		const auto unlinked = m_emit.jump(Zero);
+		m_emit.op(Qword, {0x8B}, RCX, mem(RBX, offsetof(State, view.mapping_version)));
+		m_emit.op(Dword, {0x8B}, RCX, mem(RCX, 0));
+		m_emit.op(Dword, {0x3B}, RCX, mem(RAX, offsetof(Dynarec::Link, mapping)));
+		const auto switched = m_emit.jump(Not_zero);
+		m_emit.byte({0xFF, 0xE2});
+		m_emit.bind(spent);
+		m_emit.bind(unlinked);
+		m_emit.bind(switched);
+		m_emit.mov32(RCX, target);
+		m_emit.jmp(m_stubs.leave);
+	}
+	// leave to the PC the interpreter has set
+	auto exit_dynamic() -> void
+	{
+		sync();
+		m_emit.op(Qword, {0x8B}, RDX, bank_ptr);
+		m_emit.op(Dword, {0x0F, 0xB7}, RCX, mem(RDX, m_layout.PC));
+		m_emit.byte({0x31, 0xC0});
+		m_emit.jmp(m_stubs.leave);
+	}
+	// F from the host flags of the last operation
+	auto flags(std::uint8_t mask, std::uint8_t set) -> void
+	{
+		// lahf ; movzx ecx, ah ; movzx esi, byte [rbp + rcx]
+		m_emit.byte({0x9F, 0x0F, 0xB6, 0xCC, 0x0F, 0xB6, 0x74, 0x0D, 0x00});
+		if(mask != 0xB0) {
+			m_emit.ext(Dword, {0x83}, 4, {host_F});
+			m_emit.byte({mask});
+		}
+		if(set != 0) {
+			m_emit.ext(Dword, {0x83}, 1, {host_F});
+			m_emit.byte({set});
+		}
+	}
+	// the address in a pair (BC DE HL) to eax
+	auto address(std::uint8_t pair) -> void
+	{
+		m_emit.op(Byte, {0x0F, 0xB6}, RAX, {host_reg[2 * pair]});
+		m_emit.byte({0xC1, 0xE0, 0x08});
+		m_emit.op(Byte, {0x88}, host_reg[2 * pair + 1], {RAX});
+	}
+	// the page of the address in eax to rdx
+	auto page() -> void
+	{
+		m_emit.byte({0x0F, 0xB6, 0xD4, 0xC1, 0xE2, 0x04});
+		m_emit.op(Qword, {0x03}, RDX, mem(RBX, offsetof(State, view.pages)));
+	}
+	// the byte at eax to ecx
+	auto read() -> void
+	{
+		sync();
+		page();
+		m_emit.ext(Byte, {0xF6}, 0, mem(RDX, offsetof(Memory_page, flags)));
+		m_emit.byte({Memory_page::Slow_read});
+		const auto slow = m_emit.jump(Not_zero);
+		// mov rdx, [rdx] ; movzx eax, al ; movzx ecx, byte [rdx + rax]
+		m_emit.op(Qword, {0x8B}, RDX, mem(RDX, 0));
+		m_emit.byte({0x0F, 0xB6, 0xC0, 0x0F, 0xB6, 0x0C, 0x02});
+		m_emit.byte({0xEB, 0x05});
+		m_emit.bind(slow);
+		m_emit.call(m_stubs.read);
+	}
+	// cl to the byte at eax, the block ends after a slow write
+	auto write(const Dynarec::Op &op) -> void
+	{
+		sync();
+		page();
+		m_emit.ext(Byte, {0xF6}, 0, mem(RDX, offsetof(Memory_page, flags)));
+		m_emit.byte({Memory_page::Slow_write});
+		const auto fast = m_emit.jump(Zero);
+		m_emit.call(m_stubs.write);
+		m_pending = op.cycles;
+		exit(nullptr, op.next_pc);
+		m_emit.bind(fast);
+		// mov rdx, [rdx] ; movzx eax, al ; mov [rdx + rax], cl
+		m_emit.op(Qword, {0x8B}, RDX, mem(RDX, 0));
+		m_emit.byte({0x0F, 0xB6, 0xC0, 0x88, 0x0C, 0x02});
+		// inc dword [write_count]
+		m_emit.op(Qword, {0x8B}, RDX, mem(RBX, offsetof(State, view.write_count)));
+		m_emit.ext(Dword, {0xFF}, 0, mem(RDX, 0));
+	}
+	// 16 bits increment of a pair: BC DE HL SP
+	auto step(std::uint8_t pair, bool increment) -> void
+	{
+		if(pair == 3) {
+			m_emit.ext(Word, {0xFF}, (increment) ? 0 : 1, {host_SP});
+			return;
+		}
+		// add/sub lo, 1 ; adc/sbb hi, 0
+		m_emit.ext(Byte, {0x80}, (increment) ? 0 : 5, {host_reg[2 * pair + 1]});
+		m_emit.byte({1});
+		m_emit.ext(Byte, {0x80}, (increment) ? 2 : 3, {host_reg[2 * pair]});
+		m_emit.byte({0});
+	}
+	// A = A op src, op in the SM83 encoding ADD ADC SUB SBC AND XOR OR CP
+	auto arithmetic(std::uint8_t op, std::uint8_t src) -> void
+	{
+		static constexpr std::array<std::uint8_t, 8> opcode{0x00, 0x10, 0x28, 0x18,
+		                                                    0x20, 0x30, 0x08, 0x38};
+		// bt esi, 4 : the carry of F in, x86 then gives H and C as the SM83
+		if((op == 1 or op == 3) and not m_host_carry) {
+			m_emit.byte({0x0F, 0xBA, 0xE6, 0x04});
+		}
+		m_emit.op(Byte, {opcode[op]}, src, {host_reg[7]});
+		m_host_carry = false;
+		if(m_live == 0) return;
+		// only the carry is read, by the next instruction
+		if(m_live == 0x10 and m_next != nullptr and carry_in(m_next->opcode)) {
+			m_host_carry = true;
+			return;
+		}
+		switch(op) {
+		case 0:
+		case 1:
+			flags(0xB0, 0);
+			break;
+		case 4:
+			flags(0x80, 0x20);
+			break;
+		case 5:
+		case 6:
+			flags(0x80, 0);
+			break;
+		default:
+			flags(0xB0, 0x40);
+		}
+	}
+	// INC/DEC r leave the carry as is
+	auto inc_dec(std::uint8_t reg, bool increment) -> void
+	{
+		if((m_live & 0xE0) == 0) {
+			m_emit.ext(Byte, {0xFE}, (increment) ? 0 : 1, {reg});
+			return;
+		}
+		// mov edx, esi ; and edx, 0x10
+		m_emit.byte({0x89, 0xF2, 0x83, 0xE2, 0x10});
+		m_emit.ext(Byte, {0xFE}, (increment) ? 0 : 1, {reg});
+		flags(0xA0, (increment) ? 0 : 0x40);
+		// or esi, edx
+		m_emit.byte({0x09, 0xD6});
+	}
+	// Jcc: the block ends on both sides
+	auto branch(const Dynarec::Op &op, std::uint16_t target, std::uint8_t condition)
+	    -> void
+	{
+		sync();
+		// test sil, Z or C ; NZ and NC are not taken when the flag is set
+		m_emit.ext(Byte, {0xF6}, 0, {host_F});
+		m_emit.byte({std::uint8_t((condition & 0b10) ? 0x10 : 0x80)});
+		const auto not_taken = m_emit.jump((condition & 0b1) ? Zero : Not_zero);
+		m_pending = op.cycles_taken;
+		exit(&m_links[0], target);
+		m_emit.bind(not_taken);
+		m_pending = op.cycles;
+		exit(&m_links[1], op.next_pc);
+	}
+	// return true when the block has ended
+	auto native(const Dynarec::Op &op) -> bool
+	{
+		const std::uint8_t x = op.opcode >> 6;
+		const std::uint8_t y = (op.opcode >> 3) & 0b111;
+		const std::uint8_t z = op.opcode & 0b111;
+		const std::uint8_t p = y >> 1;
+		const auto relative = static_cast<std::uint16_t>(
+		    op.next_pc + static_cast<Imm8_s>(static_cast<Imm8>(op.operand)));
+		// the accesses to memory are timed from the start of the instruction
+		if(op.opcode == 0x18 or op.opcode == 0xC3) {
+			m_pending += op.cycles;
+			exit(&m_links[0], (op.opcode == 0xC3) ? op.operand : relative);
+			return true;
+		}
+		if(x == 0 and z == 0 and y >= 4) {
+			branch(op, relative, y & 0b11);
+			return true;
+		}
+		if(x == 3 and z == 2 and y < 4) {
+			branch(op, op.operand, y);
+			return true;
+		}
+		if(x == 0 and z == 1) {
+			if(p == 3) {
+				m_emit.ext(Word, {0xC7}, 0, {host_SP});
+				m_emit.imm16(op.operand);
+			}
+			else {
+				m_emit.ext(Byte, {0xC6}, 0, {host_reg[2 * p]});
+				m_emit.byte({std::uint8_t(op.operand >> 8)});
+				m_emit.ext(Byte, {0xC6}, 0, {host_reg[2 * p + 1]});
+				m_emit.byte({std::uint8_t(op.operand)});
+			}
+		}
+		if(x == 0 and z == 3) step(p, (y & 0b1) == 0);
+		// LD (BC),A LD A,(BC) LD (DE),A LD A,(DE) and the HL+ HL- forms
+		if(x == 0 and z == 2) {
+			address(std::min<std::uint8_t>(p, 2));
+			// before a slow write ends the block
+			if(p >= 2) step(2, p == 2);
+			if(y & 0b1) {
+				read();
+				m_emit.op(Byte, {0x88}, RCX, {host_reg[7]});
+			}
+			else {
+				m_emit.op(Byte, {0x88}, host_reg[7], {RCX});
+				write(op);
+			}
+		}
+		if(x == 0 and (z == 4 or z == 5)) inc_dec(host_reg[y], z == 4);
+		if(x == 0 and z == 6) {
+			m_emit.mov32(RCX, op.operand & 0xFF);
+			if(y == 6) {
+				address(2);
+				write(op);
+			}
+			else {
+				m_emit.op(Byte, {0x88}, RCX, {host_reg[y]});
+			}
+		}
+		// CPL SCF CCF
+		if(op.opcode == 0x2F) {
+			m_emit.ext(Byte, {0xF6}, 2, {host_reg[7]});
+			m_emit.byte({0x83, 0xCE, 0x60});
+		}
+		if(op.opcode == 0x37) m_emit.byte({0x83, 0xE6, 0x80, 0x83, 0xCE, 0x10});
+		if(op.opcode == 0x3F) m_emit.byte({0x83, 0xE6, 0x90, 0x83, 0xF6, 0x10});
+		if(x == 1 and z == 6) {
+			address(2);
+			read();
+			m_emit.op(Byte, {0x88}, RCX, {host_reg[y]});
+		}
+		else if(x == 1 and y == 6) {
+			m_emit.op(Byte, {0x88}, host_reg[z], {RCX});
+			address(2);
+			write(op);
+		}
+		else if(x == 1) {
+			m_emit.op(Byte, {0x88}, host_reg[z], {host_reg[y]});
+		}
+		if(x == 2 and z == 6) {
+			address(2);
+			read();
+			arithmetic(y, RCX);
+		}
+		else if(x == 2) {
+			arithmetic(y, host_reg[z]);
+		}
+		if(x == 3 and z == 6) {
+			m_emit.mov32(RCX, op.operand & 0xFF);
+			arithmetic(y, RCX);
+		}
+		if(op.opcode == 0xEA or op.opcode == 0xFA) {
+			m_emit.mov32(RAX, op.operand);
+			if(op.opcode == 0xFA) {
+				read();
+				m_emit.op(Byte, {0x88}, RCX, {host_reg[7]});
+			}
+			else {
+				m_emit.op(Byte, {0x88}, host_reg[7], {RCX});
+				write(op);
+			}
+		}
+		m_pending += op.cycles;
+		return false;
+	}
+	// return true when the block has ended
+	auto thunk(const Dynarec::Op &op) -> bool
+	{
+		sync();
+		// the interpreter expects the PC past the instruction
+		m_emit.op(Qword, {0x8B}, RDX, bank_ptr);
+		m_emit.ext(Word, {0xC7}, 0, mem(RDX, m_layout.PC));
+		m_emit.imm16(op.next_pc);
+		flush(m_emit, m_layout);
+		m_emit.op(Qword, {0x8B}, RDI, mem(RBX, offsetof(State, cpu)));
+		m_emit.op(Qword, {0x8B}, RSI, mem(RBX, offsetof(State, memory)));
+		m_emit.mov64(RDX, reinterpret_cast<std::uintptr_t>(op.context));
+		m_emit.ext(Qword, {0xFF}, 2, mem(RBX, offsetof(State, thunk)));
+		reload(m_emit, m_layout);
+		if(op.cycles != op.cycles_taken) {
+			// test al, al ; jz +7 ; add rdi, taken - cycles
+			m_emit.byte({0x84, 0xC0, 0x74, 0x07});
+			m_emit.ext(Qword, {0x81}, 0, {host_cycles});
+			m_emit.imm32(op.cycles_taken - op.cycles);
+		}
+		m_pending = op.cycles;
+		if(op.properties & Changes_flow) {
+			exit_dynamic();
+			return true;
+		}
+		// a store may have switched a bank, EI enables the interrupts
+		if((op.properties & Writes_memory) or op.opcode == 0xFB) {
+			exit(nullptr, op.next_pc);
+			return true;
+		}
+		return false;
+	}
+
+  public:
+	Translator(Emitter &emit, const Layout &layout, const Stubs &stubs,
+	           std::uint16_t begin, std::span<Dynarec::Link, 2> links)
+	    : m_emit(emit), m_layout(layout), m_stubs(stubs), m_begin(begin), m_links(links)
+	{
+	}
+	auto translate(std::span<const Dynarec::Op> block) -> void
+	{
+		// an iteration without effect on the registers is an idle loop the
+		// CPU skips, unless it reads memory which may change
+		const auto jump = [](const auto &op) {
+			return op.opcode == 0x00 or (op.properties & Changes_flow);
+		};
+		const auto reads = [](const auto &op) { return op.properties & Reads_memory; };
+		m_chain_self = std::none_of(block.begin(), block.end(), reads) and
+		               not std::all_of(block.begin(), block.end(), jump);
+		// F is stored back on exit
+		std::vector<std::uint8_t> live(block.size());
+		std::uint8_t after = 0xF0;
+		for(std::size_t i = block.size(); i-- > 0;) {
+			live[i] = after;
+			const auto use = flag_use(block[i]);
+			after = (after & ~use.writes) | use.reads;
+		}
+		for(std::size_t i = 0; i < block.size(); ++i) {
+			const auto &op = block[i];
+			m_live = live[i];
+			m_next = (i + 1 < block.size()) ? &block[i + 1] : nullptr;
+			const bool ended = (Dynarec::is_native(op.opcode)) ? native(op) : thunk(op);
+			if(ended) return;
+		}
+		exit(&m_links[1], block.back().next_pc);
+	}
+};
+
+const Layout layout;
+} // namespace
+
+Dynarec::~Dynarec()
+{
+	if(m_code != nullptr) munmap(m_code, Code_size);
+}
+
+auto Dynarec::install(std::span<const std::uint8_t> code) -> const std::uint8_t *
+{
+	if(m_used + code.size() > Code_size) return nullptr;
+	// W^X: the buffer is only writable while copying the new code
+	if(mprotect(m_code, Code_size, PROT_READ | PROT_WRITE) != 0) return nullptr;
+	std::uint8_t *entry = m_code + m_used;
+	std::memcpy(entry, code.data(), code.size());
+	m_used += (code.size() + 15) & ~std::size_t{15};
+	if(mprotect(m_code, Code_size, PROT_READ | PROT_EXEC) != 0) {
+		std::terminate();
+	}
+	return entry;
+}
+
+auto Dynarec::allocate() -> bool
+{
+	void *code = mmap(nullptr, Code_size, PROT_READ | PROT_EXEC,
+	                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(code == MAP_FAILED) return false;
+	m_code = static_cast<std::uint8_t *>(code);
+
+	// leave: rax the Link to return, ecx the PC
+	Emitter leave{m_code + m_used};
+	leave.op(Qword, {0x8B}, RDX, bank_ptr);
+	leave.op(Word, {0x89}, RCX, mem(RDX, layout.PC));
+	flush(leave, layout);
+	// add rsp, 8 ; pop r15 r14 r13 r12 rbp rbx ; ret
+	leave.byte({0x48, 0x83, 0xC4, 0x08, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C,
+	            0x5D, 0x5B, 0xC3});
+	m_leave = install(leave.code());
+
+	// enter(State *, Native): the stack stays aligned on 16 bytes in the blocks
+	Emitter enter{m_code + m_used};
+	// push rbx rbp r12 r13 r14 r15 ; sub rsp, 8 ; mov rbx, rdi
+	enter.byte({0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57, 0x48, 0x83,
+	            0xEC, 0x08, 0x48, 0x89, 0xFB});
+	enter.mov64(RBP, reinterpret_cast<std::uintptr_t>(flag_table.data()));
+	// mov rax, rsi
+	enter.byte({0x48, 0x89, 0xF0});
+	reload(enter, layout);
+	// jmp rax
+	enter.byte({0xFF, 0xE0});
+	m_enter = install(enter.code());
+
+	// read and write: the address in eax, the value in ecx, called from a
+	// block, whose registers are flushed for the slow path of Memory
+	for(const auto call : {offsetof(State, read), offsetof(State, write)}) {
+		Emitter slow{m_code + m_used};
+		flush(slow, layout);
+		// mov rdi, [rbx + memory] ; mov esi, eax ; movzx edx, cl ; sub rsp, 8
+		slow.op(Qword, {0x8B}, RDI, mem(RBX, offsetof(State, memory)));
+		slow.byte({0x89, 0xC6, 0x0F, 0xB6, 0xD1, 0x48, 0x83, 0xEC, 0x08});
+		slow.ext(Qword, {0xFF}, 2, mem(RBX, call));
+		// add rsp, 8 ; movzx ecx, al
+		slow.byte({0x48, 0x83, 0xC4, 0x08, 0x0F, 0xB6, 0xC8});
+		reload(slow, layout);
+		slow.byte({0xC3});
+		const auto stub = install(slow.code());
+		if(call == offsetof(State, read)) {
+			m_read = stub;
+		}
+		else {
+			m_write = stub;
+		}
+	}
+	return m_leave and m_enter and m_read and m_write;
+}
+
+auto Dynarec::compile(std::span<const Op> block, std::uint16_t begin,
+                      std::span<Link, 2> links) -> Native
+{
+	if(block.empty()) return nullptr;
+	if(m_code == nullptr and not allocate()) return nullptr;
+	Emitter emit{m_code + m_used};
+	const Stubs stubs{m_leave, m_read, m_write};
+	Translator{emit, layout, stubs, begin, links}.translate(block);
+	return install(emit.code());
+}
+
+auto Dynarec::run(State &state, Native code) const noexcept -> Link *
+{
+	using Enter = auto (*)(State *, Native) noexcept -> Link *;
+	return reinterpret_cast<Enter>(m_enter)(&state, code);
+}
+#else
+Dynarec::~Dynarec() {}
+auto Dynarec::compile(std::span<const Op>, std::uint16_t, std::span<Link, 2>) -> Native
+{
+	return nullptr;
+}
+auto Dynarec::run(State &, Native) const noexcept -> Link * { return nullptr; }
+#endif
@@ -1,9 +1,71 @@
 #include "Gameboy.hpp"
 
-auto main() -> int
+#include <string>
+
+namespace {
+auto usage() -> int
+{
+	std::cerr << "usage: emulator [--headless] [--instruction-accurate] [--cycles N]\n"
+	             "                [--frames N] [--break ADDR] [--magic ADDR]\n"
+	             "                [--populate] [--huge-pages] [ROM]\n";
+	return 1;
+}
+} // namespace
+
+auto main(int argc, char *argv[]) -> int
 {
 	const std::vector<std::uint8_t> program{0xAF, 0x0A, 0xAF, 0xaf, 0x10};
-	Gameboy gb{program};
-	gb.run();
-	return 0;
+	std::optional<std::string_view> path;
+	Rom_hints hints;
+	bool headless = false;
+	auto mode = Execution_mode::Cycle_accurate;
+	Stop_condition stop;
+	try {
+		for(int idx = 1; idx < argc; ++idx) {
+			const std::string_view arg = argv[idx];
+			// numbers may be given in hexadecimal with 0x
+			auto value = [&]() -> std::uint64_t {
+				if(++idx == argc) throw std::invalid_argument("missing value");
+				return std::stoull(argv[idx], nullptr, 0);
+			};
+			auto address = [&]() -> std::uint16_t {
+				const auto addr = value();
+				if(addr > 0xFFFF) throw std::out_of_range("not an address");
+				return addr;
+			};
+			if(arg == "--headless") headless = true;
+			else if(arg == "--instruction-accurate") {
+				mode = Execution_mode::Instruction_accurate;
+			}
+			else if(arg == "--cycles") stop.cycles = value();
+			else if(arg == "--frames") stop.frames = value();
+			else if(arg == "--break") stop.breakpoint = address();
+			else if(arg == "--magic") stop.magic_address = address();
+			else if(arg == "--populate") hints.populate = true;
+			else if(arg == "--huge-pages") hints.huge_pages = true;
+			else if(not arg.starts_with("--") and not path) path = arg;
+			else return usage();
+		}
+	}
+	catch(const std::logic_error &) {
+		return usage();
+	}
+
+	// without a stop condition the paced run never returns
+	auto play = [&](auto &gb) {
+		const auto report = (headless) ? gb.run_headless(stop) : gb.run(stop);
+		report.dump(std::cout);
+		return 0;
+	};
+	try {
+		if(not path) return load_cartridge(program, mode, play);
+		// the battery backed RAM is kept next to the ROM
+		const auto save = std::filesystem::path{*path}.replace_extension(".sav");
+		return load_cartridge(Rom_image::map(*path, hints), mode, play, save);
+	}
+	// the files, or an unsupported cartridge
+	catch(const std::exception &error) {
+		std::cerr << error.what() << '\n';
+		return 1;
+	}
 }
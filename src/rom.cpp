@@ -0,0 +1,78 @@
+#include "rom.hpp"
+
+#include <bit>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+Rom_image::Rom_image(std::vector<std::uint8_t> program) : m_copy(std::move(program))
+{
+	m_copy.resize(padded_size(m_copy.size()), 0x00);
+	m_data = m_copy.data();
+	m_size = m_copy.size();
+}
+
+auto Rom_image::padded_size(std::size_t size) noexcept -> std::size_t
+{
+	return std::max(Min_size, std::bit_ceil(size));
+}
+
+auto Rom_image::map(const std::filesystem::path &path, Rom_hints hints) -> Rom_image
+{
+	auto fail = [&path](int error) {
+		throw std::system_error(error, std::generic_category(), path.string());
+	};
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) fail(errno);
+	struct stat info {};
+	int error = (fstat(fd, &info) < 0) ? errno : 0;
+	if(error == 0 and info.st_size == 0) error = EINVAL;
+	const auto size = static_cast<std::size_t>(info.st_size);
+	const int flags = MAP_PRIVATE | ((hints.populate) ? MAP_POPULATE : 0);
+	void *data = MAP_FAILED;
+	if(error == 0) {
+		data = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+		if(data == MAP_FAILED) error = errno;
+	}
+	// the mapping keeps its own reference on the file
+	close(fd);
+	if(error != 0) fail(error);
+
+	Rom_image rom;
+	if(size != padded_size(size)) {
+		// an incomplete bank, reading past the end of the file would fault
+		const auto *begin = static_cast<const std::uint8_t *>(data);
+		rom = Rom_image{std::vector<std::uint8_t>(begin, begin + size)};
+		munmap(data, size);
+		return rom;
+	}
+	if(hints.huge_pages) madvise(data, size, MADV_HUGEPAGE);
+	rom.m_data = static_cast<std::uint8_t *>(data);
+	rom.m_size = size;
+	rom.m_mapped = true;
+	return rom;
+}
+
+Rom_image::Rom_image(Rom_image &&other) noexcept
+    : m_copy(std::move(other.m_copy)), m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_mapped(std::exchange(other.m_mapped, false))
+{
+}
+
+auto Rom_image::operator=(Rom_image &&other) noexcept -> Rom_image &
+{
+	std::swap(m_copy, other.m_copy);
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_mapped, other.m_mapped);
+	return *this;
+}
+
+Rom_image::~Rom_image()
+{
+	if(m_mapped) munmap(m_data, m_size);
+}
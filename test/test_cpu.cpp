@@ -2,14 +2,23 @@
 
 #include "Clock.hpp"
 #include "Coroutine.hpp"
+#include "Gameboy.hpp"
 #include "ISA.hpp"
 #include "bit_manipulation.hpp"
+#include "block_cache.hpp"
 #include "cpu.hpp"
+#include "dynarec.hpp"
+#include "frame_pool.hpp"
 #include "include_std.hpp"
 #include "memory.hpp"
+#include "opcode_table.hpp"
 #include "units.hpp"
 
+#include <filesystem>
+#include <fstream>
 #include <limits>
+#include <numeric>
+#include <thread>
 
 using namespace ISA;
 
@@ -44,6 +53,85 @@ TEST_CASE("FLAG Register behaviour", "[Flag]")
 		F.clear_substract();
 		REQUIRE(not F.substract());
 	}
+	SECTION("Lazy evaluation")
+	{
+		F = 0xF0;
+		// Z N H are replaced by the ones of the last operation, not the carry
+		INC(Register8{0x0F}, F);
+		REQUIRE(F.read() == 0x30);
+		DEC(Register8{0x01}, F);
+		REQUIRE(F.read() == 0xD0);
+		// the pending operation is folded before a single flag is modified
+		F.clear_zero();
+		REQUIRE(F.read() == 0x50);
+		CP(Register8{0x10}, Register8{0x21}, F);
+		REQUIRE(F.read() == 0x70);
+		F = 0x80;
+		REQUIRE(F.read() == 0x80);
+	}
+	SECTION("Known values")
+	{
+		// {Z N H C} after A op value, the carry-in is set for ADC and SBC
+		SUB(Register8{0x10}, Register8{0x01}, F);
+		REQUIRE(F.read() == 0x60);
+		SUB(Register8{0x00}, Register8{0x01}, F);
+		REQUIRE(F.read() == 0x70);
+		SUB(Register8{0x3E}, Register8{0x3E}, F);
+		REQUIRE(F.read() == 0xC0);
+		F.set_carry();
+		REQUIRE(SBC(Register8{0x3B}, Register8{0x2A}, F) == 0x10);
+		REQUIRE(F.read() == 0x40);
+		F.set_carry();
+		REQUIRE(SBC(Register8{0x10}, Register8{0x0F}, F) == 0x00);
+		REQUIRE(F.read() == 0xE0);
+		F.set_carry();
+		REQUIRE(SBC(Register8{0x00}, Register8{0xFF}, F) == 0x00);
+		REQUIRE(F.read() == 0xF0);
+		F.set_carry();
+		REQUIRE(ADC(Register8{0xE1}, Register8{0x0F}, F) == 0xF1);
+		REQUIRE(F.read() == 0x20);
+		F.set_carry();
+		REQUIRE(ADC(Register8{0xE1}, Register8{0x1E}, F) == 0x00);
+		REQUIRE(F.read() == 0xB0);
+		F.clear_carry();
+		REQUIRE(ADC(Register8{0x08}, Register8{0x07}, F) == 0x0F);
+		REQUIRE(F.read() == 0x00);
+		CP(Register8{0x3C}, Register8{0x2F}, F);
+		REQUIRE(F.read() == 0x60);
+		CP(Register8{0x3C}, Register8{0x40}, F);
+		REQUIRE(F.read() == 0x50);
+		CP(Register8{0x3C}, Register8{0x3C}, F);
+		REQUIRE(F.read() == 0xC0);
+	}
+	SECTION("Memory operand")
+	{
+		std::vector<std::uint8_t> program(32_kB, 0x00);
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		memory.write(0xC000, 0x10);
+		REQUIRE(DEC(Register16{0xC000}, F, memory) == 0x0F);
+		REQUIRE(F.read() == 0x60);
+		memory.write(0xC000, 0x0F);
+		REQUIRE(INC(Register16{0xC000}, F, memory) == 0x10);
+		REQUIRE(F.read() == 0x20);
+	}
+}
+
+TEST_CASE("Register pairs", "[Register]")
+{
+	Register_bank bank{};
+	bank.B = 0x12;
+	bank.C = 0x34;
+	REQUIRE(bank.BC == 0x1234);
+	bank.HL = 0xC0FF;
+	REQUIRE(bank.H == 0xC0);
+	REQUIRE(bank.L == 0xFF);
+	Inc_HL{}(bank);
+	REQUIRE(bank.HL == 0xC100);
+	Dec_HL{}(bank);
+	REQUIRE(bank.L == 0xFF);
+	bank.set_AF(0xA5FF);
+	REQUIRE(bank.A == 0xA5);
+	REQUIRE(bank.AF() == 0xA5F0);
 }
 
 TEST_CASE("ARTIHMETIC_INSTRUCTION", "[Arithmetic]")
@@ -107,7 +195,7 @@ TEST_CASE("ARTIHMETIC_INSTRUCTION", "[Arithmetic]")
             WHEN("SUB F.carry overflow")
             {
                 F.reset_flag();
-                const Register8 A = 255;
+                const Register8 A = 0;
                 const Register8 B = 1;
                 SUB(A, B, F);
                 THEN("F.carry flag is set") { REQUIRE(F.carry()); }
@@ -115,7 +203,7 @@ TEST_CASE("ARTIHMETIC_INSTRUCTION", "[Arithmetic]")
             WHEN("SUB Half F.carry overflow")
             {
                 F.reset_flag();
-                const Register8 A = 0b1111;
+                const Register8 A = 0b1'0000;
                 const Register8 B = 0b1;
                 SUB(A, B, F);
                 THEN("Half F.carry flag is set") { REQUIRE(F.half_carry()); }
@@ -194,7 +282,7 @@ TEST_CASE("ARTIHMETIC_INSTRUCTION", "[Arithmetic]")
             WHEN("SUB F.carry overflow")
             {
                 F.reset_flag();
-                const Register8 A = 255;
+                const Register8 A = 0;
                 const Register8 B = 1;
                 SBC(A, B, F);
                 THEN("F.carry flag is set") { REQUIRE(F.carry()); }
@@ -202,7 +290,7 @@ TEST_CASE("ARTIHMETIC_INSTRUCTION", "[Arithmetic]")
             WHEN("SUB Half F.carry overflow")
             {
                 F.reset_flag();
-                const Register8 A = 0b1111;
+                const Register8 A = 0b1'0000;
                 const Register8 B = 0b1;
                 SBC(A, B, F);
                 THEN("Half F.carry flag is set") { REQUIRE(F.half_carry()); }
@@ -640,6 +728,1043 @@ TEST_CASE("ARTIHMETIC_INSTRUCTION", "[Arithmetic]")
         }
     }
 }
+TEST_CASE("Opcode table", "[Decode]")
+{
+	SECTION("Immediate operand")
+	{
+		// d16 and a16
+		for(const std::uint8_t op : {0x01, 0x11, 0x21, 0x31, 0x08, 0xC2, 0xC3, 0xC4, 0xCA,
+		                             0xCC, 0xCD, 0xD2, 0xD4, 0xDA, 0xDC, 0xEA, 0xFA}) {
+			REQUIRE(Opcode_table[op].length == 3);
+		}
+		// d8, a8 and e8
+		for(const std::uint8_t op : {0x06, 0x0E, 0x16, 0x1E, 0x26, 0x2E, 0x36, 0x3E, 0xC6,
+		                             0xCE, 0xD6, 0xDE, 0xE6, 0xEE, 0xF6, 0xFE, 0xE0, 0xF0,
+		                             0x18, 0x20, 0x28, 0x30, 0x38, 0xE8, 0xF8, 0xCB}) {
+			REQUIRE(Opcode_table[op].length == 2);
+		}
+	}
+	SECTION("Conditional branch timing")
+	{
+		REQUIRE(Opcode_table[0x20].cycles == 2);
+		REQUIRE(Opcode_table[0x20].cycles_taken == 3);
+		REQUIRE(Opcode_table[0xC2].cycles_taken == 4);
+		REQUIRE(Opcode_table[0xC4].cycles_taken == 6);
+		REQUIRE(Opcode_table[0xC0].cycles_taken == 5);
+		REQUIRE(not Opcode_table[0xC3].is_conditional());
+	}
+	SECTION("Flag effects")
+	{
+		REQUIRE(Opcode_table[0x80].flags == "Z0HC");
+		REQUIRE(Opcode_table[0x04].flags == "Z0H-");
+		REQUIRE(not Opcode_table[0x41].affects_flags());
+	}
+}
+TEST_CASE("Basic block cache", "[Decode]")
+{
+	// LD B,0x12; LD HL,0xC000; INC B; JR -3; NOP
+	const std::vector<std::uint8_t> program{0x06, 0x12, 0x21, 0x00, 0xC0,
+	                                        0x04, 0x18, 0xFD, 0x00};
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+	std::array<int, 256> handlers{}, extended{};
+	std::iota(std::begin(handlers), std::end(handlers), 0);
+	std::iota(std::begin(extended), std::end(extended), 0x100);
+	Block_cache<int> cache{handlers, extended};
+
+	const auto &block = cache.lookup(0x0, memory);
+	REQUIRE(block.ops.size() == 4);
+	REQUIRE(block.end == 0x8);
+	REQUIRE(block.ops[0].handler == 0x06);
+	REQUIRE(block.ops[0].operand == 0x12);
+	REQUIRE(block.ops[1].operand == 0xC000);
+	REQUIRE(block.ops[3].cycles_taken == 3);
+	// decoded only once
+	REQUIRE(&cache.lookup(0x0, memory) == &block);
+	REQUIRE(cache.size() == 1);
+
+	SECTION("0xCB prefix")
+	{
+		// BIT 7,(HL) and SET 0,B
+		const std::vector<std::uint8_t> program{0xCB, 0x7E, 0xCB, 0xC0};
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		const auto bit = cache.decode_op(0x0, memory);
+		REQUIRE(bit.handler == 0x17E);
+		REQUIRE(bit.length == 2);
+		REQUIRE(bit.cycles == 3);
+		REQUIRE(cache.decode_op(0x2, memory).cycles == 2);
+	}
+	SECTION("Not across two regions")
+	{
+		// NOP; NOP; LD B,d8 with its operand at 0x4000
+		std::vector<std::uint8_t> program(32_kB, 0x00);
+		program[0x3FFF] = 0x06;
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		REQUIRE(cache.lookup(0x3FFD, memory).end == 0x3FFF);
+		const auto &straddling = cache.lookup(0x3FFF, memory);
+		REQUIRE(straddling.ops.size() == 1);
+		REQUIRE(straddling.end == 0x4001);
+		REQUIRE(cache.size() == 2);
+	}
+	SECTION("Flow and memory properties")
+	{
+		REQUIRE(Opcode_properties[0x18] == Changes_flow);
+		REQUIRE(Opcode_properties[0xCD] == (Changes_flow | Writes_memory));
+		REQUIRE(Opcode_properties[0xC9] == (Changes_flow | Reads_memory));
+		REQUIRE(Opcode_properties[0x77] == Writes_memory);
+		REQUIRE(Opcode_properties[0x34] == (Reads_memory | Writes_memory));
+		REQUIRE(Opcode_properties[0x86] == Reads_memory);
+		REQUIRE(Opcode_properties[0xF0] == Reads_memory);
+		REQUIRE(Opcode_properties[0xE9] == Changes_flow);
+		REQUIRE(Opcode_properties[0x80] == 0);
+		REQUIRE(Extended_properties[0x7E] == Reads_memory);
+		REQUIRE(Extended_properties[0xC6] == (Reads_memory | Writes_memory));
+	}
+	WHEN("Code in RAM is rewritten")
+	{
+		cache.lookup(0xC000, memory);
+		REQUIRE(cache.size() == 2);
+		memory.write(0xC010, 0x3C);
+		REQUIRE(cache.stale(memory));
+		THEN("Only the blocks in RAM are dropped")
+		{
+			cache.lookup(0x0, memory);
+			REQUIRE(cache.size() == 1);
+			REQUIRE(not cache.stale(memory));
+		}
+	}
+}
+TEST_CASE("Instruction accurate mode", "[Execution]")
+{
+	// LD B,3; DEC B; JR NZ,-3; LD HL,0xC000; LD (HL),0x5A; JR -2
+	const std::vector<std::uint8_t> program{0x06, 0x03, 0x05, 0x20, 0xFD, 0x21,
+	                                        0x00, 0xC0, 0x36, 0x5A, 0x18, 0xFE};
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	SM83<Simple_MBC> cpu{clock, Execution_mode::Instruction_accurate};
+
+	SECTION("Step")
+	{
+		REQUIRE(cpu.step(memory) == 2);
+		REQUIRE(cpu.registers().B == 3);
+		cpu.step(memory);
+		// taken branch
+		REQUIRE(cpu.step(memory) == 3);
+		REQUIRE(cpu.registers().PC == 0x02);
+		while(cpu.registers().PC != 0x0A) {
+			cpu.step(memory);
+		}
+		REQUIRE(cpu.cycles() == 19);
+		REQUIRE(cpu.registers().B == 0);
+		REQUIRE(memory.read(0xC000) == 0x5A);
+	}
+	SECTION("Run a budget of cycles")
+	{
+		const auto cycles = cpu.run_cycles(memory, 100);
+		REQUIRE(cycles >= 100);
+		REQUIRE(cycles < 103);
+		REQUIRE(cpu.cycles() == cycles);
+		REQUIRE(cpu.registers().PC == 0x0A);
+		REQUIRE(memory.read(0xC000) == 0x5A);
+	}
+	SECTION("Same result with the dynarec")
+	{
+		cpu.set_dynarec(true);
+		REQUIRE(cpu.dynarec() == Dynarec::supported());
+		cpu.run_cycles(memory, 1000);
+		REQUIRE(cpu.registers().PC == 0x0A);
+		REQUIRE(cpu.registers().H == 0xC0);
+		REQUIRE(memory.read(0xC000) == 0x5A);
+	}
+}
+TEST_CASE("Bank switch", "[Execution]")
+{
+	std::vector<std::uint8_t> program(64_kB, 0x00);
+	const auto mode =
+	    GENERATE(Execution_mode::Cycle_accurate, Execution_mode::Instruction_accurate);
+	const bool dynarec = GENERATE(false, true);
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	SM83<MBC1> cpu{clock, mode};
+	if(mode == Execution_mode::Instruction_accurate) cpu.set_dynarec(dynarec);
+	auto &bank = cpu.registers();
+	auto run = [&](Memory<MBC1> &memory) {
+		if(mode == Execution_mode::Instruction_accurate) {
+			cpu.run_cycles(memory, 1000);
+			return;
+		}
+		cpu.run(memory);
+		timeline.advance(1000);
+	};
+
+	SECTION("A write to the controller ends the block")
+	{
+		// LD SP,0xFFFE; LD A,1; LD (0x2000),A; CALL 0x4000; JR -10
+		const std::vector<std::uint8_t> code{0x31, 0xFE, 0xFF, 0x3E, 0x01, 0xEA, 0x00,
+		                                     0x20, 0xCD, 0x00, 0x40, 0x18, 0xF6};
+		std::copy(code.begin(), code.end(), program.begin());
+		// bank 1: LD A,2; LD (0x2000),A; LD B,0x11; RET
+		const std::vector<std::uint8_t> first{0x3E, 0x02, 0xEA, 0x00,
+		                                      0x20, 0x06, 0x11, 0xC9};
+		std::copy(first.begin(), first.end(), &program[0x4000]);
+		// bank 2, after the write: LD B,0x22; RET
+		const std::vector<std::uint8_t> second{0x06, 0x22, 0xC9};
+		std::copy(second.begin(), second.end(), &program[0x8005]);
+		Memory memory(MBC1_tag{}, program, 8_kB);
+		run(memory);
+		// hot enough for the dynarec, which leaves the block alone
+		REQUIRE(bank.B == 0x22);
+	}
+	SECTION("An instruction across two regions")
+	{
+		// LD SP,0xFFFE; CALL 0x3FFF; LD C,B; LD A,2; LD (0x2000),A; CALL 0x3FFF;
+		// JR -2
+		const std::vector<std::uint8_t> code{0x31, 0xFE, 0xFF, 0xCD, 0xFF, 0x3F,
+		                                     0x48, 0x3E, 0x02, 0xEA, 0x00, 0x20,
+		                                     0xCD, 0xFF, 0x3F, 0x18, 0xFE};
+		std::copy(code.begin(), code.end(), program.begin());
+		// LD B,d8 with its operand in the switchable bank, then RET
+		program[0x3FFF] = 0x06;
+		program[0x4000] = 0x11;
+		program[0x4001] = 0xC9;
+		program[0x8000] = 0x22;
+		program[0x8001] = 0xC9;
+		Memory memory(MBC1_tag{}, program, 8_kB);
+		run(memory);
+		REQUIRE(bank.C == 0x11);
+		REQUIRE(bank.B == 0x22);
+	}
+}
+TEST_CASE("Idle loop", "[Execution]")
+{
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	SM83<Simple_MBC> cpu{clock, Execution_mode::Instruction_accurate};
+
+	SECTION("Polling a location is skipped")
+	{
+		// LD HL,0xC000; LD A,(HL); CP 0x90; JR NZ,-5
+		const std::vector<std::uint8_t> program{0x21, 0x00, 0xC0, 0x7E,
+		                                        0xFE, 0x90, 0x20, 0xFB};
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		const auto cycles = cpu.run_cycles(memory, 1'000'000);
+		// LD A,(HL) CP d8 JR taken
+		REQUIRE((cycles - 3) % 7 == 0);
+		REQUIRE(cycles - 1'000'000 < 7);
+		REQUIRE(cpu.idle_cycles() > 999'900);
+		REQUIRE(cpu.registers().PC == 0x3);
+	}
+	SECTION("A counting loop is not")
+	{
+		// LD B,0xFF; DEC B; JR NZ,-3; LD (HL),B; JR -2
+		const std::vector<std::uint8_t> program{0x06, 0xFF, 0x05, 0x20,
+		                                        0xFD, 0x70, 0x18, 0xFE};
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		cpu.registers().HL = 0xC000;
+		memory.write(0xC000, 0x42);
+		cpu.run_cycles(memory, 2000);
+		REQUIRE(cpu.registers().B == 0);
+		REQUIRE(memory.read(0xC000) == 0);
+		// only the last loop is idle
+		REQUIRE(cpu.idle_cycles() < 2000 - 0xFF * 4);
+	}
+	SECTION("A change of IME is not idle")
+	{
+		// EI; JR -3
+		const std::vector<std::uint8_t> program{0xFB, 0x18, 0xFD};
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		cpu.run_cycles(memory, 1000);
+		// the first iteration sets IME, the second one is the first idle
+		REQUIRE(memory.interrupts().master());
+		REQUIRE(cpu.idle_cycles() <= 1000 - 2 * 4);
+		REQUIRE(cpu.idle_cycles() > 1000 - 3 * 4);
+	}
+	SECTION("Cycle accurate polling sleeps until another domain")
+	{
+		// LD HL,0xC000; LD A,(HL); CP 0x90; JR NZ,-5; JR -2
+		const std::vector<std::uint8_t> program{0x21, 0x00, 0xC0, 0x7E, 0xFE,
+		                                        0x90, 0x20, 0xFB, 0x18, 0xFE};
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		SM83<Simple_MBC> cpu{clock};
+		Clock_domain device_clock{timeline};
+		auto device = [](const Clock_domain &clock, Memory<Simple_MBC> &memory,
+		                 Timeline::Cycle &written) -> Dummy_coro {
+			co_await clock.cycles(500'000);
+			memory.write(0xC000, 0x90);
+			written = clock.timeline().now();
+		};
+		Timeline::Cycle written = 0;
+		cpu.run(memory);
+		device(device_clock, memory, written);
+		timeline.advance_to(400'000);
+		REQUIRE(cpu.registers().PC < 0x08);
+		REQUIRE(cpu.idle_cycles() > 399'900);
+		timeline.advance_to(1'000'000);
+		REQUIRE(written == 500'000);
+		REQUIRE(cpu.registers().PC == 0x08);
+		// then JR -2 forever
+		REQUIRE(cpu.idle_cycles() > 999'900);
+	}
+}
+TEST_CASE("Interrupts", "[Interrupt]")
+{
+	SECTION("Priority")
+	{
+		Interrupt_controller interrupts;
+		interrupts.raise(Interrupt_controller::Joypad);
+		interrupts.raise(Interrupt_controller::Timer);
+		REQUIRE(not interrupts.pending());
+		interrupts.write_IE(0x1F);
+		interrupts.set_master(true);
+		REQUIRE(interrupts.pending());
+		REQUIRE(interrupts.acknowledge() == 0x50);
+		REQUIRE(not interrupts.master());
+		interrupts.set_master(true);
+		REQUIRE(interrupts.acknowledge() == 0x60);
+		REQUIRE(interrupts.IF() == 0);
+	}
+	SECTION("Dispatch")
+	{
+		// LD SP,0xFFFE; LD A,0x05; LDH (0xFF),A; EI; NOP
+		const std::vector<std::uint8_t> program{0x31, 0xFE, 0xFF, 0x3E, 0x05,
+		                                        0xE0, 0xFF, 0xFB, 0x00};
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		Timeline timeline;
+		Clock_domain clock{timeline};
+		SM83<Simple_MBC> cpu{clock, Execution_mode::Instruction_accurate};
+		for(int i = 0; i < 4; ++i) {
+			cpu.step(memory);
+		}
+		REQUIRE(memory.interrupts().IE() == 0x05);
+		memory.request_interrupt(Interrupt_controller::Serial);
+		memory.request_interrupt(Interrupt_controller::Timer);
+		REQUIRE(memory.read(Interrupt_controller::IF_address) == 0x0C);
+		// NOP then the timer interrupt, serial is not enabled
+		REQUIRE(cpu.step(memory) == 1 + Interrupt_controller::Dispatch_cycles);
+		REQUIRE(cpu.registers().PC == 0x50);
+		REQUIRE(cpu.registers().SP == 0xFFFC);
+		REQUIRE(memory.read(0xFFFC) == 0x09);
+		REQUIRE(memory.interrupts().IF() == 0x08);
+		// a game polling IF sees the serviced line cleared
+		REQUIRE(memory.read(Interrupt_controller::IF_address) == 0x08);
+		REQUIRE(not memory.interrupts().master());
+	}
+	SECTION("IF keeps the lines only")
+	{
+		const std::vector<std::uint8_t> program{0x00};
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		memory.write(Interrupt_controller::IF_address, 0xE4);
+		REQUIRE(memory.interrupts().IF() == 0x04);
+		REQUIRE(memory.read(Interrupt_controller::IF_address) == 0x04);
+	}
+}
+
+TEST_CASE("HALT", "[Interrupt]")
+{
+	// LD SP,0xFFFE; LD A,0x04; LDH (0xFF),A; EI; HALT; LD B,0x42; JR -2
+	// 0x50: INC C; RETI
+	std::vector<std::uint8_t> program{0x31, 0xFE, 0xFF, 0x3E, 0x04, 0xE0, 0xFF,
+	                                  0xFB, 0x76, 0x06, 0x42, 0x18, 0xFE};
+	program.resize(0x52);
+	program[0x50] = 0x0C;
+	program[0x51] = 0xD9;
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	const auto mode =
+	    GENERATE(Execution_mode::Cycle_accurate, Execution_mode::Instruction_accurate);
+	SM83<Simple_MBC> cpu{clock, mode};
+	auto &bank = cpu.registers();
+	auto run = [&](std::uint64_t cycles) {
+		if(mode == Execution_mode::Instruction_accurate) cpu.run_cycles(memory, cycles);
+		else timeline.advance(cycles);
+	};
+	if(mode == Execution_mode::Cycle_accurate) cpu.run(memory);
+
+	run(10'000);
+	REQUIRE(bank.PC == 0x09);
+	// asleep, not running HALT again and again
+	REQUIRE(cpu.idle_cycles() > 9'900);
+	REQUIRE(bank.C == 0);
+	SECTION("Woken by an interrupt")
+	{
+		memory.request_interrupt(Interrupt_controller::Timer);
+		run(100);
+		REQUIRE(bank.C == 1);
+		REQUIRE(bank.B == 0x42);
+		REQUIRE(bank.PC == 0x0B);
+	}
+	SECTION("Without IME the interrupt is not serviced")
+	{
+		memory.interrupts().set_master(false);
+		memory.request_interrupt(Interrupt_controller::Timer);
+		run(100);
+		REQUIRE(bank.C == 0);
+		REQUIRE(bank.B == 0x42);
+	}
+	SECTION("A disabled interrupt does not wake the CPU")
+	{
+		memory.request_interrupt(Interrupt_controller::Serial);
+		run(100);
+		REQUIRE(bank.PC == 0x09);
+	}
+}
+
+TEST_CASE("Extended opcodes", "[Execution]")
+{
+	// LD HL,0xC000; LD (HL),0x81; SET 1,(HL); BIT 7,(HL); RLC (HL); SWAP (HL);
+	// LD B,(HL); RES 0,B; SRL B; BIT 0,B
+	const std::vector<std::uint8_t> program{0x21, 0x00, 0xC0, 0x36, 0x81, 0xCB, 0xCE,
+	                                        0xCB, 0x7E, 0xCB, 0x06, 0xCB, 0x36, 0x46,
+	                                        0xCB, 0x80, 0xCB, 0x38, 0xCB, 0x40};
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	SM83<Simple_MBC> cpu{clock, Execution_mode::Instruction_accurate};
+	auto &bank = cpu.registers();
+
+	cpu.step(memory);
+	cpu.step(memory);
+	REQUIRE(cpu.step(memory) == 4);
+	REQUIRE(memory.read(0xC000) == 0x83);
+	REQUIRE(cpu.step(memory) == 3);
+	REQUIRE(not bank.F.zero());
+	REQUIRE(bank.F.half_carry());
+	REQUIRE(cpu.step(memory) == 4);
+	REQUIRE(memory.read(0xC000) == 0x07);
+	REQUIRE(bank.F.carry());
+	cpu.step(memory);
+	REQUIRE(memory.read(0xC000) == 0x70);
+	cpu.step(memory);
+	REQUIRE(cpu.step(memory) == 2);
+	REQUIRE(bank.B == 0x70);
+	cpu.step(memory);
+	REQUIRE(bank.B == 0x38);
+	cpu.step(memory);
+	REQUIRE(bank.F.zero());
+	REQUIRE(bank.PC == program.size());
+}
+TEST_CASE("Accumulator rotations", "[Execution]")
+{
+	// XOR A; RLCA; RRCA; RRA; LD A,0x80; RLA
+	const std::vector<std::uint8_t> program{0xAF, 0x07, 0x0F, 0x1F, 0x3E, 0x80, 0x17};
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	SM83<Simple_MBC> cpu{clock, Execution_mode::Instruction_accurate};
+	auto &bank = cpu.registers();
+
+	cpu.step(memory);
+	REQUIRE(bank.F.zero());
+	// A is 0 but Z is cleared, as in the opcode table
+	for(int i = 0; i < 3; ++i) {
+		cpu.step(memory);
+		REQUIRE(bank.A == 0);
+		REQUIRE(bank.F.read() == 0x00);
+	}
+	cpu.step(memory);
+	cpu.step(memory);
+	REQUIRE(bank.A == 0);
+	REQUIRE(bank.F.read() == 0x10);
+}
+TEST_CASE("Coroutine frame pool", "[Coroutine]")
+{
+	Frame_pool pool;
+	Frame_pool::Scope scope{pool};
+	auto leaf = [](int value) -> task<int> { co_return value + 1; };
+	auto chain = [&leaf](int value) -> task<int> { co_return co_await leaf(value); };
+	auto run = [&chain](int &result) -> Dummy_coro { result = co_await chain(41); };
+
+	int result = 0;
+	run(result);
+	REQUIRE(result == 42);
+	const auto warm = pool.heap_allocations();
+	REQUIRE(warm > 0);
+	for(int i = 0; i < 1000; ++i) {
+		run(result);
+	}
+	// every frame is recycled
+	REQUIRE(pool.heap_allocations() == warm);
+	REQUIRE(Frame_pool::current().heap_allocations() == warm);
+
+#ifdef __OPTIMIZE__
+	// GCC only turns the transfer into a tail call from -O2, see the Makefile
+	SECTION("Symmetric transfer")
+	{
+		// each task completes synchronously, resuming the loop by a nested call
+		// would overflow the stack
+		auto loop = [&leaf](int &result) -> Dummy_coro {
+			for(int i = 0; i < 1'000'000; ++i) {
+				result = co_await leaf(i);
+			}
+		};
+		loop(result);
+		REQUIRE(result == 1'000'000);
+	}
+#endif
+}
+
+TEST_CASE("Task exceptions", "[Coroutine]")
+{
+	Frame_pool pool;
+	Frame_pool::Scope scope{pool};
+	using enum Exceptions;
+	static_assert(not noexcept(std::declval<task<int> &>().await_resume()));
+	static_assert(noexcept(std::declval<task<int, Terminate> &>().await_resume()));
+	static_assert(noexcept(std::declval<task<void, Terminate> &>().await_resume()));
+
+	SECTION("Rethrown to the caller")
+	{
+		auto leaf = [](int value) -> task<int> {
+			if(value < 0) throw std::out_of_range("negative");
+			co_return value;
+		};
+		bool thrown = false;
+		auto run = [&](int value) -> Dummy_coro {
+			try {
+				co_await leaf(value);
+			}
+			catch(const std::out_of_range &) {
+				thrown = true;
+			}
+		};
+		run(1);
+		REQUIRE(not thrown);
+		run(-1);
+		REQUIRE(thrown);
+	}
+	SECTION("Noexcept")
+	{
+		auto leaf = [](int value) noexcept -> task<int, Terminate> {
+			co_return value + 1;
+		};
+		auto chain = [&leaf](int value) noexcept -> task<int, Terminate> {
+			co_return co_await leaf(value);
+		};
+		auto side = [](int &value) noexcept -> task<void, Terminate> {
+			++value;
+			co_return;
+		};
+		int result = 0;
+		auto run = [&](int &result) -> Dummy_coro {
+			result = co_await chain(40);
+			co_await side(result);
+		};
+		run(result);
+		REQUIRE(result == 42);
+		const auto warm = pool.heap_allocations();
+		for(int i = 0; i < 1000; ++i) {
+			run(result);
+		}
+		REQUIRE(pool.heap_allocations() == warm);
+	}
+}
+
+TEST_CASE("Clock cycles awaitable", "[Clock]")
+{
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	int step = 0;
+	auto wait = [&clock](int &step) -> Dummy_coro {
+		// nothing to wait, no suspension
+		co_await clock.cycles(0);
+		step = 1;
+		co_await clock.cycles(3);
+		step = 2;
+	};
+	wait(step);
+	REQUIRE(step == 1);
+	timeline.advance(1);
+	timeline.advance(1);
+	REQUIRE(step == 1);
+	timeline.advance(1);
+	REQUIRE(step == 2);
+	REQUIRE(timeline.pending() == 0);
+}
+
+TEST_CASE("Timeline", "[Clock]")
+{
+	Frame_pool pool;
+	Frame_pool::Scope scope{pool};
+	Timeline timeline;
+
+	SECTION("Events are resumed in time order")
+	{
+		Clock_domain fast{timeline}, slow{timeline, 4};
+		std::vector<int> trace;
+		auto tick = [](const Clock_domain &clock, int id, std::vector<int> &trace)
+		    -> Dummy_coro {
+			for(int i = 0; i < 3; ++i) {
+				co_await clock.cycles(1);
+				trace.push_back(id);
+			}
+		};
+		tick(slow, 2, trace);
+		tick(fast, 1, trace);
+		REQUIRE(timeline.next() == 1);
+		timeline.advance_to(8);
+		// at cycle 4 the slow domain was scheduled first
+		REQUIRE(trace == std::vector<int>{1, 1, 1, 2, 2});
+		REQUIRE(timeline.now() == 8);
+		REQUIRE(timeline.next() == 12);
+		// nothing due, the time still moves
+		timeline.advance(3);
+		REQUIRE(timeline.now() == 11);
+		REQUIRE(trace.size() == 5);
+		timeline.advance(1);
+		REQUIRE(trace.size() == 6);
+		REQUIRE(timeline.next() == Timeline::Never);
+	}
+	SECTION("Events beyond the wheel")
+	{
+		Clock_domain clock{timeline};
+		std::vector<int> trace;
+		auto wait = [](const Clock_domain &clock, int cycles, int id,
+		               std::vector<int> &trace) -> Dummy_coro {
+			co_await clock.cycles(cycles);
+			trace.push_back(id);
+		};
+		constexpr int far = Timeline::Slots + 100;
+		wait(clock, far, 1, trace);
+		wait(clock, 3 * Timeline::Slots, 2, trace);
+		timeline.advance(200);
+		// due at the same cycle, scheduled after the first one
+		wait(clock, far - 200, 3, trace);
+		wait(clock, 10, 4, trace);
+		REQUIRE(timeline.pending() == 4);
+		REQUIRE(timeline.next() == 210);
+		timeline.advance_to(far);
+		REQUIRE(trace == std::vector<int>{4, 1, 3});
+		timeline.advance_to(3 * Timeline::Slots);
+		REQUIRE(trace.back() == 2);
+		REQUIRE(timeline.pending() == 0);
+	}
+	SECTION("Cycle accurate CPU")
+	{
+		// LD B,3; DEC B; JR NZ,-3; LD HL,0xC000; LD (HL),0x5A; JR -2
+		const std::vector<std::uint8_t> program{0x06, 0x03, 0x05, 0x20, 0xFD, 0x21,
+		                                        0x00, 0xC0, 0x36, 0x5A, 0x18, 0xFE};
+		Memory memory(Simple_MBC_tag{}, program, 4_kB);
+		Clock_domain clock{timeline};
+		SM83<Simple_MBC> cpu{clock};
+		cpu.run(memory);
+		// effects are visible at the end of the instruction
+		timeline.advance_to(1);
+		REQUIRE(cpu.registers().PC == 0);
+		timeline.advance_to(2);
+		REQUIRE(cpu.registers().B == 3);
+		// same timing as the Instruction_accurate mode
+		timeline.advance_to(18);
+		REQUIRE(cpu.registers().PC != 0x0A);
+		timeline.advance_to(19);
+		REQUIRE(cpu.registers().PC == 0x0A);
+		REQUIRE(cpu.registers().B == 0);
+		timeline.advance(1000);
+		REQUIRE(memory.read(0xC000) == 0x5A);
+	}
+}
+
+TEST_CASE("Master clock", "[Clock]")
+{
+	Frame_pool pool;
+	Frame_pool::Scope scope{pool};
+	Master_clock clock;
+	auto &timeline = clock.timeline();
+	auto count = [](const Clock_domain &domain, std::uint64_t &ticks) -> Dummy_coro {
+		while(1) {
+			co_await domain.cycles(1);
+			++ticks;
+		}
+	};
+	std::uint64_t cpu = 0, ppu = 0, timer = 0, apu = 0;
+	count(clock.cpu(), cpu);
+	count(clock.ppu(), ppu);
+	count(clock.timer(), timer);
+	count(clock.apu(), apu);
+
+	// one second
+	timeline.advance(Master_clock::Frequency);
+	REQUIRE(cpu == 1'048'576);
+	REQUIRE(ppu == 4'194'304);
+	REQUIRE(timer == 262'144);
+	REQUIRE(apu == 512);
+
+	SECTION("Double speed")
+	{
+		clock.set_speed(Master_clock::Speed::Double);
+		REQUIRE(clock.cpu().divider() == Master_clock::CPU_divider / 2);
+		timeline.advance(Master_clock::Frequency);
+		// the cycle in progress ends at normal speed
+		REQUIRE(cpu == 3 * 1'048'576 - 1);
+		REQUIRE(ppu == 2 * 4'194'304);
+		REQUIRE(timer == 3 * 262'144 - 1);
+		REQUIRE(apu == 2 * 512);
+	}
+	SECTION("Phase locked")
+	{
+		auto edge = [](const Clock_domain &domain, Timeline::Cycle &when) -> Dummy_coro {
+			co_await domain.cycles(1);
+			when = domain.timeline().now();
+		};
+		// in between two CPU edges, the cycle starts on the next one
+		timeline.advance(3);
+		Timeline::Cycle when = 0;
+		edge(clock.cpu(), when);
+		timeline.advance(2 * Master_clock::CPU_divider);
+		REQUIRE(when == Master_clock::Frequency + 2 * Master_clock::CPU_divider);
+	}
+}
+
+TEST_CASE("Frame pacer", "[Clock]")
+{
+	using namespace std::chrono_literals;
+	Frame_pacer pacer{2ms};
+
+	SECTION("On time")
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		for(int i = 0; i < 10; ++i) {
+			pacer.wait();
+		}
+		// the deadlines are absolute
+		REQUIRE(std::chrono::steady_clock::now() - begin >= 20ms);
+		REQUIRE(pacer.stats().frames == 10);
+		REQUIRE(pacer.stats().sleeps + pacer.stats().late == 10);
+		REQUIRE(pacer.stats().jitter_max >= pacer.stats().jitter_mean());
+		REQUIRE(pacer.stats().lag_max >= pacer.stats().lag);
+	}
+	SECTION("Behind")
+	{
+		pacer.wait();
+		std::this_thread::sleep_for(20ms);
+		pacer.wait();
+		REQUIRE(pacer.stats().late >= 1);
+		REQUIRE(pacer.stats().dropped >= Frame_pacer::Max_catch_up);
+		// the second deadline was 4ms after the start
+		REQUIRE(pacer.stats().lag >= 16ms);
+		REQUIRE(pacer.stats().lag_max == pacer.stats().lag);
+		// the deadlines moved forward, the next frame is on time
+		pacer.wait();
+		REQUIRE(pacer.stats().lag < pacer.stats().lag_max);
+	}
+}
+
+TEST_CASE("Dynarec", "[Dynarec]")
+{
+	if constexpr(not Dynarec::supported()) return;
+	SECTION("Never cycle accurate")
+	{
+		Timeline timeline;
+		Clock_domain clock{timeline};
+		SM83<Simple_MBC> cpu{clock};
+		REQUIRE_THROWS_AS(cpu.set_dynarec(true), std::logic_error);
+		REQUIRE(not cpu.dynarec());
+		REQUIRE_NOTHROW(cpu.set_dynarec(false));
+	}
+	// 64kB behind the page table, the slow paths stand for the controller and
+	// see the M-cycles as they were before the instruction
+	struct Fake_memory {
+		std::vector<std::uint8_t> bytes = std::vector<std::uint8_t>(64_kB, 0x00);
+		std::array<Memory_page, 256> pages{};
+		std::uint32_t write_count = 0;
+		std::uint32_t mapping = 0;
+		const std::uint64_t *cycles = nullptr;
+		std::vector<std::uint64_t> seen;
+		std::vector<std::pair<std::uint16_t, std::uint8_t>> slow_writes;
+	} memory;
+	for(std::size_t idx = 0; idx < memory.pages.size(); ++idx) {
+		memory.pages[idx] = {&memory.bytes[idx << 8], 0};
+	}
+	auto read = [](void *fake, std::uint16_t addr) noexcept -> std::uint8_t {
+		auto &self = *static_cast<Fake_memory *>(fake);
+		self.seen.push_back(*self.cycles);
+		return addr >> 8;
+	};
+	auto write = [](void *fake, std::uint16_t addr, std::uint8_t value) noexcept {
+		auto &self = *static_cast<Fake_memory *>(fake);
+		self.seen.push_back(*self.cycles);
+		self.slow_writes.emplace_back(addr, value);
+	};
+	Dynarec dynarec;
+	Register_bank regbank{};
+	std::uint64_t cycles = 0;
+	memory.cycles = &cycles;
+	// the thunk stands for the interpreter: it can see and alter the registers
+	struct Context {
+		Register_bank &regbank;
+		const std::uint64_t &cycles;
+		std::uint16_t pc = 0;
+		std::uint64_t seen = 0;
+	} context{regbank, cycles};
+	auto thunk = [](void *, void *, const void *ctx) noexcept -> bool {
+		auto &self = *static_cast<Context *>(const_cast<void *>(ctx));
+		self.pc = self.regbank.PC;
+		self.seen = self.cycles;
+		self.regbank.A += self.regbank.C;
+		return true;
+	};
+	Dynarec::State state{&regbank,
+	                     &cycles,
+	                     1'000,
+	                     {memory.pages.data(), &memory.write_count, &memory.mapping},
+	                     nullptr,
+	                     &memory,
+	                     thunk,
+	                     read,
+	                     write};
+	// as the CPU describes an instruction
+	auto op = [](std::uint8_t opcode, std::uint16_t operand, std::uint16_t next_pc,
+	             const void *ctx = nullptr) -> Dynarec::Op {
+		const auto &info = Opcode_table[opcode];
+		return {opcode,      operand,           next_pc, info.cycles,
+		        info.cycles_taken, Opcode_properties[opcode], ctx};
+	};
+	std::array<Dynarec::Link, 2> links{};
+
+	SECTION("Straight line code")
+	{
+		// LD B,0x12; LD C,B; INC BC; LD SP,0xFFFE; DEC SP; LD A,0x01; LD H,A
+		const std::vector<Dynarec::Op> block{
+		    op(0x06, 0x12, 0x102), op(0x48, 0x00, 0x103), op(0x03, 0x00, 0x104),
+		    op(0x31, 0xFFFE, 0x107), op(0x3B, 0x00, 0x108), op(0x3E, 0x01, 0x10A),
+		    op(0x67, 0x00, 0x10B)};
+		auto native = dynarec.compile(block, 0x100, links);
+		REQUIRE(native != nullptr);
+		// the next block is not translated yet
+		REQUIRE(dynarec.run(state, native) == &links[1]);
+		REQUIRE(links[1].target == 0x10B);
+		REQUIRE(regbank.B == 0x12);
+		REQUIRE(regbank.C == 0x13);
+		REQUIRE(regbank.SP == 0xFFFD);
+		REQUIRE(regbank.H == 0x01);
+		REQUIRE(regbank.PC == 0x10B);
+		REQUIRE(cycles == 13);
+	}
+	SECTION("Carry between the halves of a pair")
+	{
+		// LD DE,0x00FF; INC DE; LD HL,0x0100; DEC HL; JP 0x150
+		const std::vector<Dynarec::Op> block{
+		    op(0x11, 0x00FF, 0x103), op(0x13, 0x00, 0x104), op(0x21, 0x0100, 0x107),
+		    op(0x2B, 0x00, 0x108), op(0xC3, 0x0150, 0x10B)};
+		auto native = dynarec.compile(block, 0x100, links);
+		REQUIRE(dynarec.run(state, native) == &links[0]);
+		REQUIRE(regbank.D == 0x01);
+		REQUIRE(regbank.E == 0x00);
+		REQUIRE(regbank.H == 0x00);
+		REQUIRE(regbank.L == 0xFF);
+		REQUIRE(regbank.PC == 0x150);
+	}
+	SECTION("Interpreter fallback")
+	{
+		// LD C,0x05; RLCA (thunk); LD B,A; RLCA (thunk)
+		const std::vector<Dynarec::Op> block{
+		    op(0x0E, 0x05, 0x102), op(0x07, 0x00, 0x103, &context),
+		    op(0x47, 0x00, 0x104), op(0x07, 0x00, 0x105, &context)};
+		regbank.A = 0x01;
+		auto native = dynarec.compile(block, 0x100, links);
+		dynarec.run(state, native);
+		REQUIRE(regbank.B == 0x06);
+		REQUIRE(regbank.A == 0x0B);
+		REQUIRE(context.pc == 0x105);
+		REQUIRE(regbank.PC == 0x105);
+		// the M-cycles are counted per instruction
+		REQUIRE(context.seen == 4);
+		REQUIRE(cycles == 5);
+	}
+	SECTION("Taken conditional thunk")
+	{
+		// RET NZ, the next PC is the one of the interpreter
+		const std::vector<Dynarec::Op> block{op(0xC0, 0x00, 0x101, &context)};
+		auto native = dynarec.compile(block, 0x100, links);
+		REQUIRE(dynarec.run(state, native) == nullptr);
+		REQUIRE(regbank.PC == 0x101);
+		REQUIRE(cycles == Opcode_table[0xC0].cycles_taken);
+	}
+	SECTION("Flags as the interpreter computes them")
+	{
+		auto reference = [](std::uint8_t y, Register8 lhs, Register8 rhs,
+		                    Flag_register &F) -> Register8 {
+			switch(y) {
+			case 0:
+				return ADD(lhs, rhs, F);
+			case 1:
+				return ADC(lhs, rhs, F);
+			case 2:
+				return SUB(lhs, rhs, F);
+			case 3:
+				return SBC(lhs, rhs, F);
+			case 4:
+				return AND(lhs, rhs, F);
+			case 5:
+				return XOR(lhs, rhs, F);
+			case 6:
+				return OR(lhs, rhs, F);
+			}
+			CP(lhs, rhs, F);
+			return lhs;
+		};
+		std::size_t mismatches = 0;
+		// ADD ADC SUB SBC AND XOR OR CP A,B then INC B and DEC B
+		for(std::uint8_t y = 0; y < 10; ++y) {
+			const std::uint8_t opcode = (y < 8) ? 0x80 | (y << 3) : 0x04 + y - 8;
+			const std::vector<Dynarec::Op> block{op(opcode, 0x00, 0x101)};
+			auto native = dynarec.compile(block, 0x100, links);
+			for(unsigned lhs = 0; lhs < 256; ++lhs) {
+				for(unsigned rhs = 0; rhs < 256; ++rhs) {
+					for(const std::uint8_t flags : {0x00, 0x10, 0xE0, 0xF0}) {
+						regbank.A = lhs;
+						regbank.B = rhs;
+						regbank.F = flags;
+						dynarec.run(state, native);
+						Flag_register F = flags;
+						Register8 A = lhs, B = rhs;
+						if(y < 8) A = reference(y, lhs, rhs, F);
+						if(y == 8) B = INC(B, F);
+						if(y == 9) B = DEC(B, F);
+						mismatches += regbank.A != A or regbank.B != B or
+						              regbank.F.read() != F.read();
+					}
+				}
+			}
+		}
+		REQUIRE(mismatches == 0);
+	}
+	SECTION("Memory through the page table")
+	{
+		memory.pages[0xD0].flags = Memory_page::Slow_read;
+		memory.pages[0xFF].flags = Memory_page::Slow_write;
+		memory.bytes[0xC001] = 0x17;
+		// LD HL,0xC000; LD (HL),0x42; LD A,(HL+); LD B,(HL); LD A,(0xD012);
+		// LD DE,0xFF80; LD (DE),A; LD C,A
+		const std::vector<Dynarec::Op> block{
+		    op(0x21, 0xC000, 0x103), op(0x36, 0x42, 0x105),   op(0x2A, 0x00, 0x106),
+		    op(0x46, 0x00, 0x107),   op(0xFA, 0xD012, 0x10A), op(0x11, 0xFF80, 0x10D),
+		    op(0x12, 0x00, 0x10E),   op(0x4F, 0x00, 0x10F)};
+		auto native = dynarec.compile(block, 0x100, links);
+		// the block stops after the slow write, which may switch a bank
+		REQUIRE(dynarec.run(state, native) == nullptr);
+		REQUIRE(regbank.PC == 0x10E);
+		REQUIRE(regbank.C == 0x00);
+		REQUIRE(memory.bytes[0xC000] == 0x42);
+		REQUIRE(regbank.HL == 0xC001);
+		REQUIRE(regbank.B == 0x17);
+		REQUIRE(regbank.A == 0xD0);
+		// the slow path counts its own writes
+		REQUIRE(memory.write_count == 1);
+		REQUIRE(memory.slow_writes ==
+		        std::vector<std::pair<std::uint16_t, std::uint8_t>>{{0xFF80, 0xD0}});
+		REQUIRE(memory.seen == std::vector<std::uint64_t>{10, 17});
+		REQUIRE(cycles == 19);
+	}
+	SECTION("Chained blocks")
+	{
+		// 0x200: INC B; JP 0x300 and 0x300: INC C; JP 0x200
+		std::array<Dynarec::Link, 2> other{};
+		auto first = dynarec.compile(std::vector{op(0x04, 0x00, 0x201),
+		                                         op(0xC3, 0x0300, 0x204)},
+		                             0x200, links);
+		auto second = dynarec.compile(std::vector{op(0x0C, 0x00, 0x301),
+		                                          op(0xC3, 0x0200, 0x304)},
+		                              0x300, other);
+		REQUIRE(dynarec.run(state, first) == &links[0]);
+		REQUIRE(links[0].target == 0x300);
+		// as the CPU links them once it has looked the target up
+		links[0] = {second, memory.mapping, 0x300};
+		other[0] = {first, memory.mapping, 0x200};
+		auto exit = dynarec.run(state, second);
+		REQUIRE((exit == &links[0] or exit == &other[0]));
+		REQUIRE(regbank.PC == exit->target);
+		// the budget is checked at the end of each block
+		REQUIRE(cycles >= state.end);
+		REQUIRE(cycles < state.end + 5);
+		REQUIRE(regbank.B + regbank.C == cycles / 5);
+
+		// a bank was switched since the link was made
+		state.end = cycles + 1'000;
+		++memory.mapping;
+		REQUIRE(dynarec.run(state, first) == &links[0]);
+		REQUIRE(regbank.PC == 0x300);
+	}
+	SECTION("Self loops")
+	{
+		// LD A,(HL); JR -3 polls the memory, the CPU must see each iteration
+		const std::vector<Dynarec::Op> polling{op(0x7E, 0x00, 0x101),
+		                                       op(0x18, 0xFD, 0x103)};
+		REQUIRE(dynarec.run(state, dynarec.compile(polling, 0x100, links)) == nullptr);
+		REQUIRE(cycles == 5);
+		// INC B; JR -3 counts, until the end of the budget
+		const std::vector<Dynarec::Op> counting{op(0x04, 0x00, 0x201),
+		                                        op(0x18, 0xFD, 0x203)};
+		REQUIRE(dynarec.run(state, dynarec.compile(counting, 0x200, links)) == nullptr);
+		REQUIRE(cycles >= state.end);
+		REQUIRE(cycles < state.end + 4);
+		REQUIRE(regbank.B == (cycles - 5) / 4);
+		REQUIRE(regbank.PC == 0x200);
+	}
+}
+TEST_CASE("Dynarec against the interpreter", "[Dynarec]")
+{
+	if constexpr(not Dynarec::supported()) return;
+	// random loads, stores and arithmetic looped over until B reaches 0:
+	// however the native code splits it, both runs must end alike
+	const auto seed = GENERATE(range(1, 33));
+	std::mt19937 random(seed);
+	// B counts the iterations and the control flow is the loop's
+	auto allowed = [](std::uint8_t opcode) {
+		const auto name = Opcode_table[opcode].mnemonic;
+		if(Opcode_properties[opcode] & Changes_flow) return false;
+		for(const auto prefix : {"PUSH", "POP", "EI", "DI", "HALT", "STOP", "ILLEGAL",
+		                         "PREFIX", "LD B", "INC B", "DEC B"}) {
+			if(name.starts_with(prefix)) return false;
+		}
+		return true;
+	};
+	// LD SP,0xDFF0; LD HL,0xC100; LD DE,0xC200; LD A,0x5A; LD B,40
+	std::vector<std::uint8_t> program{0x31, 0xF0, 0xDF, 0x21, 0x00, 0xC1, 0x11,
+	                                  0x00, 0xC2, 0x3E, 0x5A, 0x06, 0x28};
+	const auto body = program.size();
+	while(program.size() < body + 64) {
+		const std::uint8_t opcode = random();
+		if(not allowed(opcode)) continue;
+		program.push_back(opcode);
+		for(std::size_t i = 1; i < Opcode_table[opcode].length; ++i) {
+			program.push_back(random());
+		}
+	}
+	// DEC B; JR NZ,body; JR -2
+	program.insert(program.end(), {0x05, 0x20});
+	program.push_back(static_cast<std::uint8_t>(body - program.size() - 1));
+	const std::uint16_t end = program.size();
+	program.insert(program.end(), {0x18, 0xFE});
+	program.resize(32_kB, 0x00);
+
+	Timeline timeline;
+	Clock_domain clock{timeline};
+	SM83<Simple_MBC> interpreter{clock, Execution_mode::Instruction_accurate};
+	SM83<Simple_MBC> dynarec{clock, Execution_mode::Instruction_accurate};
+	dynarec.set_dynarec(true);
+	Memory expected(Simple_MBC_tag{}, program, 4_kB);
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+	interpreter.run_cycles(expected, 100'000);
+	dynarec.run_cycles(memory, 100'000);
+
+	const auto &lhs = interpreter.registers();
+	const auto &rhs = dynarec.registers();
+	INFO("seed " << seed);
+	REQUIRE(lhs.PC == end);
+	REQUIRE(rhs.PC == lhs.PC);
+	REQUIRE(rhs.AF() == lhs.AF());
+	REQUIRE(rhs.BC == lhs.BC);
+	REQUIRE(rhs.DE == lhs.DE);
+	REQUIRE(rhs.HL == lhs.HL);
+	REQUIRE(rhs.SP == lhs.SP);
+	REQUIRE(dynarec.cycles() == interpreter.cycles());
+	std::size_t differences = 0;
+	for(std::uint32_t addr = IROM1_ul; addr <= 0xFFFF; ++addr) {
+		differences += memory.read(addr) != expected.read(addr);
+	}
+	REQUIRE(differences == 0);
+}
 //TEST_CASE("LOAD_INSTRUCTION", "[LOAD]")
 //{
 //    auto prog = std::vector<std::uint8_t>(32_kB, 0xFF);
@@ -820,3 +1945,179 @@ TEST_CASE("ARTIHMETIC_INSTRUCTION", "[Arithmetic]")
 //        }
 //    }
 //}
+
+TEST_CASE("Headless run", "[Gameboy]")
+{
+	// LD HL,0xC000; INC (HL); JR -3
+	const std::vector<std::uint8_t> program{0x21, 0x00, 0xC0, 0x34, 0x18, 0xFD};
+	using enum Run_report::Reason;
+	const auto mode =
+	    GENERATE(Execution_mode::Cycle_accurate, Execution_mode::Instruction_accurate);
+	Gameboy<Simple_MBC> gb{program, mode};
+
+	SECTION("Cycle count")
+	{
+		const auto report = gb.run_headless({.cycles = 1000});
+		REQUIRE(report.reason == Cycles);
+		REQUIRE(report.cycles >= 1000);
+		// the last block may overshoot
+		REQUIRE(report.cycles < 1009);
+	}
+	SECTION("Frame count")
+	{
+		const auto report = gb.run_headless({.frames = 2});
+		REQUIRE(report.reason == Frames);
+		REQUIRE(report.frames() == 2);
+		REQUIRE(report.frame_heap_allocations <= 1);
+	}
+	SECTION("Breakpoint")
+	{
+		const auto report = gb.run_headless({.cycles = 1000, .breakpoint = 0x0004});
+		REQUIRE(report.reason == Breakpoint);
+		REQUIRE(report.cycles == 6);
+		// the next run goes past it
+		REQUIRE(gb.run_headless({.breakpoint = 0x0004}).cycles == 6);
+	}
+	SECTION("Magic write")
+	{
+		const auto report = gb.run_headless({.frames = 1, .magic_address = 0xC000});
+		REQUIRE(report.reason == Magic_write);
+		REQUIRE(report.cycles == 6);
+	}
+}
+
+TEST_CASE("Paced run", "[Gameboy]")
+{
+	using namespace std::chrono_literals;
+	const std::vector<std::uint8_t> program{0x18, 0xFE};
+	const auto mode =
+	    GENERATE(Execution_mode::Cycle_accurate, Execution_mode::Instruction_accurate);
+	Gameboy<Simple_MBC> gb{program, mode};
+
+	const auto report = gb.run({.frames = 2});
+	REQUIRE(report.reason == Run_report::Reason::Frames);
+	REQUIRE(report.frames() == 2);
+	REQUIRE(report.elapsed >= 2 * Gameboy<Simple_MBC>::Frame_period);
+	REQUIRE(report.pacing);
+	REQUIRE(report.pacing->frames == 2);
+	REQUIRE(report.pacing->lag_max >= report.pacing->lag);
+	REQUIRE(not gb.run_headless({.frames = 1}).pacing);
+
+	std::ostringstream out;
+	report.dump(out);
+	REQUIRE(out.str().find("Lag ") != std::string::npos);
+}
+
+TEST_CASE("Cartridge type", "[Gameboy]")
+{
+	using enum Run_report::Reason;
+	const auto mode =
+	    GENERATE(Execution_mode::Cycle_accurate, Execution_mode::Instruction_accurate);
+
+	SECTION("No header")
+	{
+		const std::vector<std::uint8_t> program{0x18, 0xFE};
+		REQUIRE(load_cartridge(program, mode, [](auto &gb) {
+			return std::is_same_v<decltype(gb), Gameboy<Simple_MBC> &>;
+		}));
+	}
+	SECTION("MBC1")
+	{
+		// LD A,2; LD (0x2000),A; LD A,(0x4000); CP 0x22; JR NZ,-2; LD (0xC000),A
+		std::vector<std::uint8_t> program{0x3E, 0x02, 0xEA, 0x00, 0x20, 0xFA, 0x00,
+		                                  0x40, 0xFE, 0x22, 0x20, 0xFE, 0xEA, 0x00,
+		                                  0xC0, 0x18, 0xFE};
+		program.resize(64_kB);
+		program[0x0147] = 0x01;
+		std::fill(&program[0x4000], &program[0x8000], 0x11);
+		std::fill(&program[0x8000], &program[0xC000], 0x22);
+		const auto report = load_cartridge(program, mode, [](auto &gb) {
+			REQUIRE(std::is_same_v<decltype(gb), Gameboy<MBC1> &>);
+			return gb.run_headless({.cycles = 1000, .magic_address = 0xC000});
+		});
+		REQUIRE(report.reason == Magic_write);
+	}
+	SECTION("MBC3 clock")
+	{
+		// LD A,0x0A; LD (0x0000),A; LD A,0x08; LD (0x4000),A; then latch the clock
+		// until it reads 2 seconds: XOR A; LD (0x6000),A; INC A; LD (0x6000),A;
+		// LD A,(0xA000); CP 2; JR NZ,-15; LD (0xC000),A
+		std::vector<std::uint8_t> program{
+		    0x3E, 0x0A, 0xEA, 0x00, 0x00, 0x3E, 0x08, 0xEA, 0x00, 0x40, 0xAF, 0xEA,
+		    0x00, 0x60, 0x3C, 0xEA, 0x00, 0x60, 0xFA, 0x00, 0xA0, 0xFE, 0x02, 0x20,
+		    0xF1, 0xEA, 0x00, 0xC0, 0x18, 0xFE};
+		program.resize(32_kB);
+		program[0x0147] = 0x10;
+		const auto report = load_cartridge(program, mode, [](auto &gb) {
+			REQUIRE(std::is_same_v<decltype(gb), Gameboy<MBC3> &>);
+			return gb.run_headless({.cycles = 3'000'000, .magic_address = 0xC000});
+		});
+		REQUIRE(report.reason == Magic_write);
+		REQUIRE(report.cycles >= 2 * Real_time_clock::Cycles_per_second);
+		REQUIRE(report.cycles < 2 * Real_time_clock::Cycles_per_second + 100);
+	}
+	SECTION("MBC5")
+	{
+		// LD A,2; LD (0x2000),A; LD A,(0x4000); CP 0x22; JR NZ,-2; LD (0xC000),A
+		std::vector<std::uint8_t> program{0x3E, 0x02, 0xEA, 0x00, 0x20, 0xFA, 0x00,
+		                                  0x40, 0xFE, 0x22, 0x20, 0xFE, 0xEA, 0x00,
+		                                  0xC0, 0x18, 0xFE};
+		program.resize(64_kB);
+		program[0x0147] = 0x19;
+		std::fill(&program[0x8000], &program[0xC000], 0x22);
+		const auto report = load_cartridge(program, mode, [](auto &gb) {
+			REQUIRE(std::is_same_v<decltype(gb), Gameboy<MBC5> &>);
+			return gb.run_headless({.cycles = 1000, .magic_address = 0xC000});
+		});
+		REQUIRE(report.reason == Magic_write);
+	}
+	SECTION("Battery")
+	{
+		// LD A,0x0A; LD (0x0000),A; LD (0xA000),A; JR -2
+		std::vector<std::uint8_t> program{0x3E, 0x0A, 0xEA, 0x00, 0x00,
+		                                  0xEA, 0x00, 0xA0, 0x18, 0xFE};
+		program.resize(32_kB);
+		program[0x0147] = 0x03;
+		program[0x0149] = 0x02;
+		const auto save = std::filesystem::temp_directory_path() / "emulator_test.sav";
+		std::filesystem::remove(save);
+		const auto report = load_cartridge(
+		    program, mode, [](auto &gb) { return gb.run_headless({.cycles = 100}); },
+		    save);
+		// the write to 0x0000 is not a magic write
+		REQUIRE(report.reason == Cycles);
+		std::ifstream file{save, std::ios::binary};
+		REQUIRE(file.get() == 0x0A);
+		REQUIRE(std::filesystem::file_size(save) == 8_kB);
+		std::filesystem::remove(save);
+
+		// 2kB of RAM
+		program[0x0149] = 0x01;
+		load_cartridge(
+		    program, mode, [](auto &gb) { return gb.run_headless({.cycles = 100}); },
+		    save);
+		REQUIRE(std::filesystem::file_size(save) == 2_kB);
+		std::filesystem::remove(save);
+	}
+	SECTION("Battery without RAM")
+	{
+		// MBC3+TIMER+BATTERY keeps only the clock: LD A,0x0A; LD (0x0000),A; JR -2
+		std::vector<std::uint8_t> program{0x3E, 0x0A, 0xEA, 0x00, 0x00, 0x18, 0xFE};
+		program.resize(32_kB);
+		program[0x0147] = 0x0F;
+		const auto save = std::filesystem::temp_directory_path() / "emulator_test.sav";
+		std::filesystem::remove(save);
+		const auto report = load_cartridge(
+		    program, mode, [](auto &gb) { return gb.run_headless({.cycles = 100}); },
+		    save);
+		REQUIRE(report.reason == Cycles);
+		REQUIRE(not std::filesystem::exists(save));
+	}
+	SECTION("Unsupported")
+	{
+		std::vector<std::uint8_t> program(32_kB, 0x00);
+		program[0x0147] = 0xFC;
+		REQUIRE_THROWS_AS(load_cartridge(program, mode, [](auto &) { return 0; }),
+		                  std::invalid_argument);
+	}
+}
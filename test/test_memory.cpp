@@ -2,6 +2,8 @@
 #include "catch.hpp"
 #include "memory.hpp"
 #include "units.hpp"
+#include <filesystem>
+#include <fstream>
 #include <iterator>
 
 TEST_CASE("Memory controller test", "[MBC TEST]")
@@ -179,11 +181,170 @@ TEST_CASE("Memory controller test", "[MBC TEST]")
 	}
 	SECTION("MBC3 controller")
 	{
-		// TODO
+		std::vector<std::uint8_t> rom(2_MB, 0xFF);
+		std::fill(&rom[0x4000], &rom[0x8000], 0x01);
+		std::fill(&rom[0x1FC000], &rom[0x200000], 0x7F);
+		std::vector<std::uint8_t> address_space(64_kB, 0x00);
+		std::vector<std::uint8_t> ram(32_kB, 0x00);
+		auto mbc = MBC3(rom, address_space, ram);
+
+		SECTION("Requires more memory than possible")
+		{
+			std::vector<std::uint8_t> big(4_MB, 0x00);
+			CHECK_THROWS(MBC3(big, address_space, ram));
+			std::vector<std::uint8_t> big_ram(64_kB, 0x00);
+			CHECK_THROWS(MBC3(rom, address_space, big_ram));
+		}
+		SECTION("ROM banks")
+		{
+			mbc.write(0x2000, 0x7F);
+			REQUIRE(mbc.read(0x4000) == 0x7F);
+			REQUIRE(mbc.bank(0x4000) == 0x7F);
+			mbc.write(0x2000, 0x00);
+			REQUIRE(mbc.read(0x4000) == 0x01);
+		}
+		SECTION("RAM banks")
+		{
+			REQUIRE(mbc.read(0xA000) == 0xFF);
+			mbc.write(0x0000, 0x0A);
+			mbc.write(0xA000, 0xA5);
+			mbc.write(0x4000, 0x03);
+			REQUIRE(mbc.read(0xA000) == 0x00);
+			mbc.write(0x4000, 0x00);
+			REQUIRE(mbc.read(0xA000) == 0xA5);
+			REQUIRE(ram[0] == 0xA5);
+		}
+		SECTION("Real time clock")
+		{
+			std::uint64_t now = 0;
+			mbc.set_clock({[](const void *cycles) noexcept {
+				               return *static_cast<const std::uint64_t *>(cycles);
+			               },
+			               &now});
+			auto latch = [&mbc] {
+				mbc.write(0x6000, 0x00);
+				mbc.write(0x6000, 0x01);
+			};
+			auto rtc = [&mbc](std::uint8_t reg) {
+				mbc.write(0x4000, reg);
+				return mbc.read(0xA000);
+			};
+			constexpr auto second = Real_time_clock::Cycles_per_second;
+			mbc.write(0x0000, 0x0A);
+			now = (((1 * 24 + 2) * 60 + 3) * 60 + 4) * second;
+			REQUIRE(rtc(0x08) == 0);
+			latch();
+			REQUIRE(rtc(0x08) == 4);
+			REQUIRE(rtc(0x09) == 3);
+			REQUIRE(rtc(0x0A) == 2);
+			REQUIRE(rtc(0x0B) == 1);
+			REQUIRE(rtc(0x0C) == 0);
+
+			// halted the clock keeps its time
+			mbc.write(0x4000, 0x0C);
+			mbc.write(0xA000, 0x40);
+			now += 10 * second;
+			latch();
+			REQUIRE(rtc(0x08) == 4);
+			mbc.write(0x4000, 0x0C);
+			mbc.write(0xA000, 0x00);
+			now += 10 * second;
+			latch();
+			REQUIRE(rtc(0x08) == 14);
+
+			// the day counter overflows after 511 days
+			mbc.write(0x4000, 0x0B);
+			mbc.write(0xA000, 0xFF);
+			mbc.write(0x4000, 0x0C);
+			mbc.write(0xA000, 0x01);
+			now += 24 * 60 * 60 * second;
+			latch();
+			REQUIRE(rtc(0x0B) == 0);
+			REQUIRE(rtc(0x0C) == 0x80);
+
+			// the seconds carry over to the minutes
+			mbc.write(0x4000, 0x08);
+			mbc.write(0xA000, 59);
+			now += second;
+			latch();
+			REQUIRE(rtc(0x08) == 0);
+			REQUIRE(rtc(0x09) == 4);
+
+			// out of range, each register wraps on its own
+			mbc.write(0x4000, 0x08);
+			mbc.write(0xA000, 62);
+			mbc.write(0x4000, 0x09);
+			mbc.write(0xA000, 63);
+			mbc.write(0x4000, 0x0A);
+			mbc.write(0xA000, 31);
+			now += 2 * second;
+			latch();
+			REQUIRE(rtc(0x08) == 0);
+			REQUIRE(rtc(0x09) == 63);
+			REQUIRE(rtc(0x0A) == 31);
+			REQUIRE(rtc(0x0B) == 0);
+			now += 60 * second;
+			latch();
+			REQUIRE(rtc(0x08) == 0);
+			REQUIRE(rtc(0x09) == 0);
+			REQUIRE(rtc(0x0A) == 31);
+			now += 60 * 60 * second;
+			latch();
+			REQUIRE(rtc(0x09) == 0);
+			REQUIRE(rtc(0x0A) == 0);
+			REQUIRE(rtc(0x0B) == 0);
+		}
 	}
 	SECTION("MBC5 controller")
 	{
-		// TODO
+		std::vector<std::uint8_t> rom(8_MB, 0xFF);
+		std::fill(&rom[0x0000], &rom[0x4000], 0xCA);
+		std::fill(&rom[0x400000], &rom[0x404000], 0x3C);
+		std::fill(&rom[0x7FC000], &rom[0x800000], 0x5A);
+		std::vector<std::uint8_t> address_space(64_kB, 0x00);
+		std::vector<std::uint8_t> ram(128_kB, 0x00);
+		auto mbc = MBC5(rom, address_space, ram);
+
+		SECTION("Requires more memory than possible")
+		{
+			std::vector<std::uint8_t> big_ram(256_kB, 0x00);
+			CHECK_THROWS(MBC5(rom, address_space, big_ram));
+		}
+		SECTION("9 bits ROM banks")
+		{
+			REQUIRE(mbc.read(0x4000) == 0xFF);
+			mbc.write(0x2000, 0xFF);
+			mbc.write(0x3000, 0x01);
+			REQUIRE(mbc.read(0x4000) == 0x5A);
+			REQUIRE(mbc.bank(0x4000) == 0x1FF);
+			mbc.write(0x2000, 0x00);
+			REQUIRE(mbc.read(0x4000) == 0x3C);
+			// bank 0 can be mapped in ROM1
+			mbc.write(0x3000, 0x00);
+			REQUIRE(mbc.read(0x7FFF) == 0xCA);
+		}
+		SECTION("16 RAM banks")
+		{
+			mbc.write(0x0000, 0x0A);
+			for(std::uint8_t bank = 0; bank < 16; ++bank) {
+				mbc.write(0x4000, bank);
+				mbc.write(0xBFFF, bank);
+			}
+			for(std::uint8_t bank = 0; bank < 16; ++bank) {
+				REQUIRE(ram[bank * 8_kB + 0x1FFF] == bank);
+			}
+			// only 0x0A enables the RAM
+			mbc.write(0x0000, 0x1A);
+			REQUIRE(mbc.read(0xBFFF) == 0xFF);
+		}
+		SECTION("Pages follow the banks")
+		{
+			Memory memory(MBC5_tag{}, rom, 8_kB);
+			memory.write(0x2000, 0xFF);
+			memory.write(0x3000, 0x01);
+			REQUIRE(memory.read(0x4000) == 0x5A);
+			REQUIRE((memory.page(0x40).flags & Memory_page::Slow_read) == 0);
+		}
 	}
 	SECTION("Common MBC test")
 	{
@@ -192,3 +353,210 @@ TEST_CASE("Memory controller test", "[MBC TEST]")
 }
 
 TEST_CASE("Other part of memory", "[MEMORY TEST]") {}
+
+TEST_CASE("Page table", "[MEMORY TEST]")
+{
+	std::vector<std::uint8_t> program(0x200, 0xCA);
+	Memory memory(Simple_MBC_tag{}, program, 4_kB);
+
+	SECTION("Work RAM is a plain store")
+	{
+		REQUIRE(memory.page(0xC1).flags == 0);
+		memory.write(0xC123, 0x42);
+		REQUIRE(memory.read(0xC123) == 0x42);
+		REQUIRE(memory.page(0xC1).data[0x23] == 0x42);
+		REQUIRE(memory.write_count() == 1);
+	}
+	SECTION("ROM is read only")
+	{
+		REQUIRE(memory.page(0x01).flags == Memory_page::Slow_write);
+		memory.write(0x0100, 0x42);
+		REQUIRE(memory.read(0x0100) == 0xCA);
+		REQUIRE(memory.write_count() == 1);
+	}
+	SECTION("Code pages bump the version")
+	{
+		memory.mark_code(0xC000, 0xC010);
+		REQUIRE(memory.page(0xC0).flags == Memory_page::Slow_write);
+		memory.write(0xC100, 0x01);
+		REQUIRE(memory.code_version() == 0);
+		memory.write(0xC008, 0x01);
+		REQUIRE(memory.code_version() == 1);
+		REQUIRE(memory.read(0xC008) == 0x01);
+		memory.unmark_code();
+		REQUIRE(memory.page(0xC0).flags == 0);
+	}
+	SECTION("Watched page")
+	{
+		memory.watch(0xD080);
+		memory.write(0xD07F, 0x01);
+		REQUIRE(not memory.watch_hit());
+		memory.write(0xD080, 0x01);
+		REQUIRE(memory.watch_hit());
+		memory.watch(Memory<Simple_MBC>::No_watch);
+		REQUIRE(memory.page(0xD0).flags == 0);
+	}
+	SECTION("IE and IF are forwarded")
+	{
+		memory.write(Interrupt_controller::IE_address, 0x05);
+		memory.write(Interrupt_controller::IF_address, 0x04);
+		REQUIRE(memory.interrupts().IE() == 0x05);
+		REQUIRE(memory.interrupts().IF() == 0x04);
+		REQUIRE(memory.read(Interrupt_controller::IE_address) == 0x05);
+	}
+	SECTION("MBC1 pages follow the registers")
+	{
+		std::vector<std::uint8_t> tmp(64_kB + 512_kB + 32_kB, 0x00);
+		std::fill(&tmp[0x4000], &tmp[0x8000], 0x11);
+		std::fill(&tmp[0x8000], &tmp[0xC000], 0x22);
+		auto mbc = MBC1(tmp.begin(), tmp.end(), 512_kB, 32_kB);
+		REQUIRE(mbc.map(0x40).data[0] == 0x11);
+		REQUIRE(mbc.map(0x40).flags == Memory_page::Slow_write);
+		mbc.write(0x2000, 0x02);
+		REQUIRE(mbc.map(0x40).data[0] == 0x22);
+		const auto ram = Memory_page::Slow_read | Memory_page::Slow_write;
+		REQUIRE(mbc.map(0xA0).flags == ram);
+		mbc.write(0x0000, 0x0A);
+		REQUIRE(mbc.map(0xA0).flags == 0);
+		REQUIRE(mbc.map(0xC0).flags == 0);
+	}
+}
+
+TEST_CASE("ROM image", "[MEMORY TEST]")
+{
+	const auto path = std::filesystem::temp_directory_path() / "emulator_rom_test.gb";
+	auto save = [&path](std::size_t size) {
+		std::vector<std::uint8_t> rom(size);
+		for(std::size_t i = 0; i < size; ++i) {
+			rom[i] = i / 16_kB;
+		}
+		std::ofstream file{path, std::ios::binary | std::ios::trunc};
+		file.write(reinterpret_cast<const char *>(rom.data()), rom.size());
+	};
+
+	SECTION("Program in memory")
+	{
+		const Rom_image rom{std::vector<std::uint8_t>{0x3E, 0x01}};
+		REQUIRE(not rom.mapped());
+		REQUIRE(rom.size() == 32_kB);
+		REQUIRE(rom[1] == 0x01);
+		REQUIRE(rom[0x7FFF] == 0x00);
+	}
+	SECTION("Mapped file")
+	{
+		save(128_kB);
+		const auto hints = GENERATE(Rom_hints{}, Rom_hints{true, true});
+		const auto rom = Rom_image::map(path, hints);
+		REQUIRE(rom.mapped());
+		REQUIRE(rom.size() == 128_kB);
+		REQUIRE(rom[0x1C000] == 7);
+	}
+	SECTION("Incomplete bank")
+	{
+		save(40'000);
+		const auto rom = Rom_image::map(path);
+		REQUIRE(not rom.mapped());
+		REQUIRE(rom.size() == 64_kB);
+		REQUIRE(rom[0x8000] == 2);
+		REQUIRE(rom[0xFFFF] == 0);
+	}
+	SECTION("Missing file")
+	{
+		std::filesystem::remove(path);
+		REQUIRE_THROWS_AS(Rom_image::map(path), std::system_error);
+	}
+	SECTION("Banks of a mapped ROM")
+	{
+		save(128_kB);
+		Memory memory(MBC1_tag{}, Rom_image::map(path), 8_kB);
+		REQUIRE(memory.read(0x0000) == 0);
+		REQUIRE(memory.read(0x4000) == 1);
+		memory.write(0x2000, 0x05);
+		REQUIRE(memory.read(0x4000) == 5);
+		// bank numbers wrap around the ROM size
+		memory.write(0x2000, 0x0B);
+		REQUIRE(memory.read(0x7FFF) == 3);
+	}
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Battery RAM", "[MEMORY TEST]")
+{
+	const auto path = std::filesystem::temp_directory_path() / "emulator_ram_test.sav";
+	std::filesystem::remove(path);
+	std::vector<std::uint8_t> rom(64_kB, 0x00);
+
+	SECTION("Without a battery")
+	{
+		Cartridge_ram ram{8_kB};
+		REQUIRE(not ram.persistent());
+		REQUIRE(ram.size() == 8_kB);
+		REQUIRE(std::ranges::all_of(ram.bytes(), [](auto elt) { return elt == 0; }));
+	}
+	SECTION("Save file")
+	{
+		{
+			auto ram = Cartridge_ram::map(path, 8_kB);
+			REQUIRE(ram.persistent());
+			ram.bytes()[0x10] = 0x42;
+			ram.flush();
+		}
+		REQUIRE(std::filesystem::file_size(path) == 8_kB);
+		// a bigger RAM keeps the saved banks
+		auto ram = Cartridge_ram::map(path, 32_kB);
+		REQUIRE(std::filesystem::file_size(path) == 32_kB);
+		REQUIRE(ram.bytes()[0x10] == 0x42);
+		REQUIRE(ram.bytes()[0x7FFF] == 0x00);
+	}
+	SECTION("Banks are the save file")
+	{
+		{
+			Memory<MBC1> memory(rom, Cartridge_ram::map(path, 32_kB));
+			memory.write(0x0000, 0x0A);
+			memory.write(0xA000, 0x42);
+			// bank 1
+			memory.write(0x6000, 0x01);
+			memory.write(0x4000, 0x01);
+			memory.write(0xA000, 0x17);
+			// the gate is closed
+			memory.write(0x0000, 0x00);
+			memory.write(0xA001, 0x17);
+		}
+		std::ifstream file{path, std::ios::binary};
+		std::vector<char> saved(32_kB);
+		file.read(saved.data(), saved.size());
+		REQUIRE(saved[0x0000] == 0x42);
+		REQUIRE(saved[0x2000] == 0x17);
+		REQUIRE(saved[0x2001] == 0x00);
+		Memory<MBC1> memory(rom, Cartridge_ram::map(path, 32_kB));
+		memory.write(0x0000, 0x0A);
+		REQUIRE(memory.read(0xA000) == 0x42);
+	}
+	SECTION("2kB mirrored")
+	{
+		auto mirrored = [](auto &memory) {
+			memory.write(0x0000, 0x0A);
+			memory.write(0xA000, 0x42);
+			memory.write(0xBFFF, 0x17);
+			REQUIRE(memory.read(0xA800) == 0x42);
+			REQUIRE(memory.read(0xB800) == 0x42);
+			REQUIRE(memory.read(0xA7FF) == 0x17);
+		};
+		{
+			Memory<MBC1> memory(rom, Cartridge_ram::map(path, 2_kB));
+			mirrored(memory);
+		}
+		REQUIRE(std::filesystem::file_size(path) == 2_kB);
+		std::ifstream file{path, std::ios::binary};
+		std::vector<char> saved(2_kB);
+		file.read(saved.data(), saved.size());
+		REQUIRE(saved[0x000] == 0x42);
+		REQUIRE(saved[0x7FF] == 0x17);
+
+		Memory<MBC3> mbc3(rom, Cartridge_ram{2_kB});
+		mirrored(mbc3);
+		Memory<MBC5> mbc5(rom, Cartridge_ram{2_kB});
+		mirrored(mbc5);
+	}
+	std::filesystem::remove(path);
+}